@@ -1,7 +1,7 @@
 workspace "aquacppminer"
 	location "prj"
 
-	configurations { "Debug", "Rel", "RelAVX", "RelAVX2" }
+	configurations { "Debug", "Rel", "RelAVX", "RelAVX2", "RelProfile" }
 	platforms { "x64", "win32", "linux32" }
 
 	-- depending on LUA version, unpack is different
@@ -69,6 +69,10 @@ workspace "aquacppminer"
 		targetsuffix "_avx"
 	filter {"configurations:RelAVX2"}
 		targetsuffix "_avx2"
+	-- per phase hash profiler (see src/profiler.h)
+	filter {"configurations:RelProfile"}
+		targetsuffix "_prof"
+		defines { "AQUA_PROFILE=1" }
 	filter { "configurations:RelAVX", "system:windows" }
 		buildoptions { "/arch:AVX" }
 	filter { "configurations:RelAVX", "system:linux or macosx" }
@@ -169,7 +173,7 @@ workspace "aquacppminer"
 
 		filter { "system:linux" }
  			linkoptions { 
-				"-lgmp -lpthread -lcrypto", 
+				"-lgmp -lpthread -lcrypto -lrt", 
 				"`curl-config --libs`" 
 			}
 		filter { "system:macosx" }
@@ -179,3 +183,162 @@ workspace "aquacppminer"
                                 "/usr/local/opt/gmp/lib/libgmp.a",
 				 "-lcurl -lpthread -lz"
 			}
+
+	-- reference reader of the shared memory stats (--shm-stats)
+	project "aquastat"
+		kind "ConsoleApp"
+		language "C++"
+		location "prj"
+
+		files {
+			"src/tools/aquastat/*.cpp",
+			"src/shmStatsLayout.h"
+		}
+
+		if (cppdialect ~= nil) then
+			cppdialect "C++11"
+		end
+
+		filter { "system:linux" }
+			linkoptions { "-lpthread -lrt" }
+		filter {}
+
+	-- local pool / node with fault injection for end to end tests (src/tools/mockpool)
+	project "aquacppminer_mockpool"
+		kind "ConsoleApp"
+		language "C++"
+		location "prj"
+
+		files {
+			"src/tools/mockpool/*.cpp",
+			"src/httpServer.*",
+			"src/log.*",
+			"src/argon2ref.*",
+			"src/hex_encode_utils.*"
+		}
+
+		if (cppdialect ~= nil) then
+			cppdialect "C++11"
+		end
+
+		filter { "system:windows", "configurations:Debug" }
+			links { "mpir", "Ws2_32" }
+		filter { "system:windows", "configurations:Rel*" }
+			links { "mpir", "Ws2_32" }
+		filter { "system:linux" }
+			linkoptions { "-lgmp -lpthread" }
+		filter { "system:macosx" }
+			linkoptions { "/usr/local/opt/gmp/lib/libgmp.a", "-lpthread" }
+		filter {}
+
+	-- microbenchmarks of the hot path primitives, with JSON baselines (src/tools/microbench)
+	project "aquacppminer_bench"
+		kind "ConsoleApp"
+		language "C++"
+		location "prj"
+
+		files {
+			"src/tools/microbench/*.cpp",
+			"src/*.h",
+			"src/*.cpp",
+			"blake2/sse/*.h",
+			"blake2/sse/blake2b.c",
+			"phc-winner-argon2/src/blake2/*.*",
+			"phc-winner-argon2/src/argon2.*",
+			"phc-winner-argon2/src/core.*",
+			"phc-winner-argon2/src/encoding.*",
+			"phc-winner-argon2/src/opt.*",
+			"phc-winner-argon2/src/thread.*",
+			"phc-winner-argon2/include/argon2.h"
+		}
+		removefiles { "src/main.cpp" }
+
+		filter { "system:windows" }
+			files {
+				"src/windows/*.h",
+				"src/windows/*.cpp",
+			}
+			flags { "StaticRuntime" }
+		filter {}
+
+		if (cppdialect ~= nil) then
+			cppdialect "C++11"
+		end
+
+		filter { "system:windows", "configurations:Debug" }
+			links { "libcryptoMT", "mpir", "libcurl_a_debug", "crypt32", "Ws2_32", "Wldap32", "Normaliz" }
+		filter { "system:windows", "configurations:Rel*" }
+			links { "libcryptoMT", "mpir", "libcurl_a", "crypt32", "Ws2_32", "Wldap32", "Normaliz" }
+
+		filter { "system:linux", "platforms:linux32" }
+			buildoptions {"-msse3"}
+
+		filter { "system:linux" }
+			linkoptions {
+				"-lgmp -lpthread -lcrypto -lrt",
+				"`curl-config --libs`"
+			}
+		filter { "system:macosx" }
+			linkoptions {
+				"/usr/local/opt/openssl/lib/libcrypto.a",
+				"/usr/local/opt/openssl/lib/libssl.a",
+				"/usr/local/opt/gmp/lib/libgmp.a",
+				"-lcurl -lpthread -lz"
+			}
+		filter {}
+
+	-- known answer & differential tests of the hash kernels, one binary per ISA config (src/tools/hashtest)
+	project "aquacppminer_test"
+		kind "ConsoleApp"
+		language "C++"
+		location "prj"
+
+		files {
+			"src/tools/hashtest/*.cpp",
+			"src/*.h",
+			"src/*.cpp",
+			"blake2/sse/*.h",
+			"blake2/sse/blake2b.c",
+			"phc-winner-argon2/src/blake2/*.*",
+			"phc-winner-argon2/src/argon2.*",
+			"phc-winner-argon2/src/core.*",
+			"phc-winner-argon2/src/encoding.*",
+			"phc-winner-argon2/src/opt.*",
+			"phc-winner-argon2/src/thread.*",
+			"phc-winner-argon2/include/argon2.h"
+		}
+		removefiles { "src/main.cpp" }
+
+		filter { "system:windows" }
+			files {
+				"src/windows/*.h",
+				"src/windows/*.cpp",
+			}
+			flags { "StaticRuntime" }
+		filter {}
+
+		if (cppdialect ~= nil) then
+			cppdialect "C++11"
+		end
+
+		filter { "system:windows", "configurations:Debug" }
+			links { "libcryptoMT", "mpir", "libcurl_a_debug", "crypt32", "Ws2_32", "Wldap32", "Normaliz" }
+		filter { "system:windows", "configurations:Rel*" }
+			links { "libcryptoMT", "mpir", "libcurl_a", "crypt32", "Ws2_32", "Wldap32", "Normaliz" }
+
+		filter { "system:linux", "platforms:linux32" }
+			buildoptions {"-msse3"}
+
+		filter { "system:linux" }
+			linkoptions {
+				"-lgmp -lpthread -lcrypto -lrt",
+				"`curl-config --libs`"
+			}
+		filter { "system:macosx" }
+			linkoptions {
+				"/usr/local/opt/openssl/lib/libcrypto.a",
+				"/usr/local/opt/openssl/lib/libssl.a",
+				"/usr/local/opt/gmp/lib/libgmp.a",
+				"-lcurl -lpthread -lz"
+			}
+		filter {}
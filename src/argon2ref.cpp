@@ -0,0 +1,298 @@
+#include "argon2ref.h"
+
+#include <vector>
+#include <algorithm>
+#include <string.h>
+
+// ---- blake2b (RFC 7693), unkeyed, one shot
+
+static const uint64_t BLAKE2B_IV[8] = {
+	0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+	0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+static const uint8_t BLAKE2B_SIGMA[12][16] = {
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+	{ 14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3 },
+	{ 11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4 },
+	{ 7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8 },
+	{ 9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13 },
+	{ 2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9 },
+	{ 12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11 },
+	{ 13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10 },
+	{ 6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5 },
+	{ 10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0 },
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+	{ 14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3 }
+};
+
+static inline uint64_t rotr64(uint64_t x, unsigned n) {
+	return (x >> n) | (x << (64 - n));
+}
+
+static inline uint64_t load64(const uint8_t* p) {
+	uint64_t v = 0;
+	for (int i = 7; i >= 0; i--) {
+		v = (v << 8) | p[i];
+	}
+	return v;
+}
+
+static inline void store64(uint8_t* p, uint64_t v) {
+	for (int i = 0; i < 8; i++) {
+		p[i] = (uint8_t)(v >> (8 * i));
+	}
+}
+
+static inline void store32(uint8_t* p, uint32_t v) {
+	for (int i = 0; i < 4; i++) {
+		p[i] = (uint8_t)(v >> (8 * i));
+	}
+}
+
+static void blake2bCompress(uint64_t h[8], const uint8_t block[128], uint64_t counter, bool last) {
+	uint64_t m[16], v[16];
+	for (int i = 0; i < 16; i++) {
+		m[i] = load64(block + 8 * i);
+	}
+	for (int i = 0; i < 8; i++) {
+		v[i] = h[i];
+		v[i + 8] = BLAKE2B_IV[i];
+	}
+	v[12] ^= counter;
+	if (last) {
+		v[14] = ~v[14];
+	}
+#define B2B_G(r, i, a, b, c, d) \
+	a = a + b + m[BLAKE2B_SIGMA[r][2 * i]]; d = rotr64(d ^ a, 32); c = c + d; b = rotr64(b ^ c, 24); \
+	a = a + b + m[BLAKE2B_SIGMA[r][2 * i + 1]]; d = rotr64(d ^ a, 16); c = c + d; b = rotr64(b ^ c, 63);
+	for (int r = 0; r < 12; r++) {
+		B2B_G(r, 0, v[0], v[4], v[8], v[12]);
+		B2B_G(r, 1, v[1], v[5], v[9], v[13]);
+		B2B_G(r, 2, v[2], v[6], v[10], v[14]);
+		B2B_G(r, 3, v[3], v[7], v[11], v[15]);
+		B2B_G(r, 4, v[0], v[5], v[10], v[15]);
+		B2B_G(r, 5, v[1], v[6], v[11], v[12]);
+		B2B_G(r, 6, v[2], v[7], v[8], v[13]);
+		B2B_G(r, 7, v[3], v[4], v[9], v[14]);
+	}
+#undef B2B_G
+	for (int i = 0; i < 8; i++) {
+		h[i] ^= v[i] ^ v[i + 8];
+	}
+}
+
+// outLen 1..64
+static void blake2b(uint8_t* out, size_t outLen, const uint8_t* in, size_t inLen) {
+	uint64_t h[8];
+	memcpy(h, BLAKE2B_IV, sizeof(h));
+	h[0] ^= 0x01010000ULL ^ (uint64_t)outLen;
+	uint8_t block[128];
+	uint64_t counter = 0;
+	while (inLen > 128) {
+		counter += 128;
+		blake2bCompress(h, in, counter, false);
+		in += 128;
+		inLen -= 128;
+	}
+	memset(block, 0, sizeof(block));
+	memcpy(block, in, inLen);
+	counter += inLen;
+	blake2bCompress(h, block, counter, true);
+	uint8_t full[64];
+	for (int i = 0; i < 8; i++) {
+		store64(full + 8 * i, h[i]);
+	}
+	memcpy(out, full, outLen);
+}
+
+// ---- argon2id
+
+const uint32_t ARGON2REF_BLOCK_WORDS = 128;
+const uint32_t ARGON2REF_SYNC_POINTS = 4;
+const uint32_t ARGON2REF_VERSION = 0x13;
+const uint32_t ARGON2REF_TYPE_ID = 2;
+
+struct RefBlock {
+	uint64_t v[ARGON2REF_BLOCK_WORDS];
+};
+
+// H': variable length hash built from blake2b
+static void blake2bLong(uint8_t* out, size_t outLen, const uint8_t* in, size_t inLen) {
+	std::vector<uint8_t> buf(4 + inLen);
+	store32(buf.data(), (uint32_t)outLen);
+	memcpy(buf.data() + 4, in, inLen);
+	if (outLen <= 64) {
+		blake2b(out, outLen, buf.data(), buf.size());
+		return;
+	}
+	uint8_t v[64];
+	blake2b(v, 64, buf.data(), buf.size());
+	memcpy(out, v, 32);
+	out += 32;
+	size_t remaining = outLen - 32;
+	while (remaining > 64) {
+		blake2b(v, 64, v, 64);
+		memcpy(out, v, 32);
+		out += 32;
+		remaining -= 32;
+	}
+	blake2b(v, remaining, v, 64);
+	memcpy(out, v, remaining);
+}
+
+static inline uint64_t fBlaMka(uint64_t x, uint64_t y) {
+	return x + y + 2 * (x & 0xFFFFFFFFULL) * (y & 0xFFFFFFFFULL);
+}
+
+static inline void gb(uint64_t& a, uint64_t& b, uint64_t& c, uint64_t& d) {
+	a = fBlaMka(a, b); d = rotr64(d ^ a, 32);
+	c = fBlaMka(c, d); b = rotr64(b ^ c, 24);
+	a = fBlaMka(a, b); d = rotr64(d ^ a, 16);
+	c = fBlaMka(c, d); b = rotr64(b ^ c, 63);
+}
+
+static void permute(uint64_t* v[16]) {
+	gb(*v[0], *v[4], *v[8], *v[12]);
+	gb(*v[1], *v[5], *v[9], *v[13]);
+	gb(*v[2], *v[6], *v[10], *v[14]);
+	gb(*v[3], *v[7], *v[11], *v[15]);
+	gb(*v[0], *v[5], *v[10], *v[15]);
+	gb(*v[1], *v[6], *v[11], *v[12]);
+	gb(*v[2], *v[7], *v[8], *v[13]);
+	gb(*v[3], *v[4], *v[9], *v[14]);
+}
+
+// next = G(x, y) (xor next when withXor)
+static void compress(RefBlock& next, const RefBlock& x, const RefBlock& y, bool withXor) {
+	RefBlock r, q;
+	for (uint32_t i = 0; i < ARGON2REF_BLOCK_WORDS; i++) {
+		r.v[i] = x.v[i] ^ y.v[i];
+	}
+	q = r;
+	uint64_t* v[16];
+	// rows: 16 consecutive words
+	for (int row = 0; row < 8; row++) {
+		for (int k = 0; k < 16; k++) {
+			v[k] = &q.v[16 * row + k];
+		}
+		permute(v);
+	}
+	// columns: word pairs 2c, 2c+1 of each row
+	for (int col = 0; col < 8; col++) {
+		for (int row = 0; row < 8; row++) {
+			v[2 * row] = &q.v[16 * row + 2 * col];
+			v[2 * row + 1] = &q.v[16 * row + 2 * col + 1];
+		}
+		permute(v);
+	}
+	for (uint32_t i = 0; i < ARGON2REF_BLOCK_WORDS; i++) {
+		uint64_t w = q.v[i] ^ r.v[i];
+		next.v[i] = withXor ? (next.v[i] ^ w) : w;
+	}
+}
+
+static void blockFromBytes(RefBlock& b, const uint8_t* bytes) {
+	for (uint32_t i = 0; i < ARGON2REF_BLOCK_WORDS; i++) {
+		b.v[i] = load64(bytes + 8 * i);
+	}
+}
+
+bool argon2idReference(const uint8_t* pwd, size_t pwdLen, uint32_t tCost, uint32_t mCost,
+	uint8_t* out, size_t outLen)
+{
+	const uint32_t lanes = 1;
+	if (tCost < 1 || outLen < 4 || pwdLen > 0xFFFFFFFFULL) {
+		return false;
+	}
+
+	// H0 = blake2b(p, T, m, t, v, y, |P|, P, |S|, |K|, |X|)
+	std::vector<uint8_t> h0In(7 * 4 + pwdLen + 3 * 4);
+	uint8_t* p = h0In.data();
+	store32(p, lanes); p += 4;
+	store32(p, (uint32_t)outLen); p += 4;
+	store32(p, mCost); p += 4;
+	store32(p, tCost); p += 4;
+	store32(p, ARGON2REF_VERSION); p += 4;
+	store32(p, ARGON2REF_TYPE_ID); p += 4;
+	store32(p, (uint32_t)pwdLen); p += 4;
+	memcpy(p, pwd, pwdLen); p += pwdLen;
+	store32(p, 0); p += 4;
+	store32(p, 0); p += 4;
+	store32(p, 0);
+	uint8_t h0[64 + 8];
+	blake2b(h0, 64, h0In.data(), h0In.size());
+
+	// m' = 4p * floor(m / 4p), at least 8p blocks
+	uint32_t nBlocks = std::max(2 * ARGON2REF_SYNC_POINTS * lanes,
+		(mCost / (ARGON2REF_SYNC_POINTS * lanes)) * (ARGON2REF_SYNC_POINTS * lanes));
+	uint32_t laneLength = nBlocks / lanes;
+	uint32_t segmentLength = laneLength / ARGON2REF_SYNC_POINTS;
+	std::vector<RefBlock> memory(nBlocks);
+
+	uint8_t blockBytes[1024];
+	for (uint32_t i = 0; i < 2; i++) {
+		store32(h0 + 64, i);
+		store32(h0 + 68, 0);
+		blake2bLong(blockBytes, sizeof(blockBytes), h0, sizeof(h0));
+		blockFromBytes(memory[i], blockBytes);
+	}
+
+	RefBlock zero, input, address;
+	memset(&zero, 0, sizeof(zero));
+	for (uint32_t pass = 0; pass < tCost; pass++) {
+		for (uint32_t slice = 0; slice < ARGON2REF_SYNC_POINTS; slice++) {
+			// argon2id: data independent addressing for the first half of the first pass
+			bool independent = (pass == 0 && slice < ARGON2REF_SYNC_POINTS / 2);
+			uint32_t start = (pass == 0 && slice == 0) ? 2 : 0;
+			if (independent) {
+				memset(&input, 0, sizeof(input));
+				input.v[0] = pass;
+				input.v[1] = 0;
+				input.v[2] = slice;
+				input.v[3] = nBlocks;
+				input.v[4] = tCost;
+				input.v[5] = ARGON2REF_TYPE_ID;
+				if (start == 2) {
+					input.v[6]++;
+					compress(address, zero, input, false);
+					compress(address, zero, address, false);
+				}
+			}
+			for (uint32_t i = start; i < segmentLength; i++) {
+				uint32_t cur = slice * segmentLength + i;
+				uint32_t prev = (cur == 0) ? laneLength - 1 : cur - 1;
+				uint64_t pseudoRand;
+				if (independent) {
+					if (i % ARGON2REF_BLOCK_WORDS == 0) {
+						input.v[6]++;
+						compress(address, zero, input, false);
+						compress(address, zero, address, false);
+					}
+					pseudoRand = address.v[i % ARGON2REF_BLOCK_WORDS];
+				}
+				else {
+					pseudoRand = memory[prev].v[0];
+				}
+				// single lane: reference blocks always come from the same lane
+				uint64_t j1 = pseudoRand & 0xFFFFFFFFULL;
+				uint32_t refAreaSize = (pass == 0) ?
+					slice * segmentLength + i - 1 :
+					laneLength - segmentLength + i - 1;
+				uint64_t x = (j1 * j1) >> 32;
+				uint64_t y = ((uint64_t)refAreaSize * x) >> 32;
+				uint32_t relative = refAreaSize - 1 - (uint32_t)y;
+				uint32_t startPos = (pass == 0 || slice == ARGON2REF_SYNC_POINTS - 1) ? 0 : (slice + 1) * segmentLength;
+				uint32_t ref = (startPos + relative) % laneLength;
+				compress(memory[cur], memory[prev], memory[ref], pass > 0);
+			}
+		}
+	}
+
+	uint8_t final[1024];
+	for (uint32_t i = 0; i < ARGON2REF_BLOCK_WORDS; i++) {
+		store64(final + 8 * i, memory[laneLength - 1].v[i]);
+	}
+	blake2bLong(out, outLen, final, sizeof(final));
+	return true;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// portable scalar Argon2id (RFC 9106, version 0x13) with its own blake2b, built independently
+// of the optimized phc-winner-argon2 kernels: known answer & differential tests, share validation
+// only what aqua hashing uses: one lane, no salt / secret / associated data
+bool argon2idReference(const uint8_t* pwd, size_t pwdLen, uint32_t tCost, uint32_t mCost,
+	uint8_t* out, size_t outLen);
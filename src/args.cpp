@@ -33,6 +33,56 @@ std::pair<bool, uint32_t> parseRefreshRate(const std::string& refreshRateStr) {
 	return{ count != 0, uint32_t(refreshRate) };
 }
 
+bool applyMiningArgs(const char* prefix, int argc, char** argv, MiningConfig& cfg)
+{
+	InputParser ip(argc, argv);
+
+	if (ip.cmdOptionExists(OPT_SOLO)) {
+		cfg.soloMine = true;
+	}
+
+	if (ip.cmdOptionExists(OPT_NTHREADS)) {
+		const auto& nThreadsStr = ip.getCmdOption(OPT_NTHREADS);
+		int n = sscanf(nThreadsStr.c_str(), "%u", &cfg.nThreads);
+		if (n<1) {
+			logLine(prefix, 
+				"Warning: invalid value for number of threads (%d), reverting to default", 
+				cfg.nThreads);
+			cfg.nThreads = 0;
+		}
+		else if (cfg.nThreads > (uint32_t)MAX_MINER_THREADS) {
+			logLine(prefix, "Warning: %u threads requested, limited to %d", cfg.nThreads, MAX_MINER_THREADS);
+			cfg.nThreads = MAX_MINER_THREADS;
+		}
+	}
+
+	if (ip.cmdOptionExists(OPT_REFRESH_RATE)) {
+		auto res = parseRefreshRate(ip.getCmdOption(OPT_REFRESH_RATE));
+		if (!res.first)
+			return false;
+		cfg.refreshRateMs = res.second;
+	}
+
+	if (ip.cmdOptionExists(OPT_GETWORK_URL)) {
+		cfg.getWorkUrl = ip.getCmdOption(OPT_GETWORK_URL);
+	}
+
+	if (ip.cmdOptionExists(OPT_FULLNODE_URL)) {
+		cfg.fullNodeUrl = ip.getCmdOption(OPT_FULLNODE_URL);
+	}
+
+	if (ip.cmdOptionExists(OPT_POOLS)) {
+		if (!parsePoolList(ip.getCmdOption(OPT_POOLS), cfg.pools)) {
+			logLine(prefix, "Invalid pools list. Try: --pools 3:http://poolA:8888/0x..,1:http://poolB:8888/0x..");
+			return false;
+		}
+		// first pool of the list is the main one
+		cfg.getWorkUrl = cfg.pools[0].url;
+	}
+
+	return true;
+}
+
 bool parseArgs(const char* prefix, int argc, char** argv)
 {
 	InputParser ip(argc, argv);
@@ -59,34 +109,100 @@ bool parseArgs(const char* prefix, int argc, char** argv)
 		}
 	}
 
-	if (ip.cmdOptionExists(OPT_SOLO)) {
-		cfg.soloMine = true;
+	if (ip.cmdOptionExists(OPT_METRICS_PORT)) {
+		const auto& portStr = ip.getCmdOption(OPT_METRICS_PORT);
+		if (sscanf(portStr.c_str(), "%u", &cfg.metricsPort) != 1 || cfg.metricsPort == 0 || cfg.metricsPort > 65535) {
+			logLine(prefix, "Invalid metrics port: %s", portStr.c_str());
+			return false;
+		}
 	}
 
-	if (ip.cmdOptionExists(OPT_NTHREADS)) {
-		const auto& nThreadsStr = ip.getCmdOption(OPT_NTHREADS);
-		int n = sscanf(nThreadsStr.c_str(), "%u", &cfg.nThreads);
-		if (n<1) {
-			logLine(prefix, 
-				"Warning: invalid value for number of threads (%d), reverting to default", 
-				cfg.nThreads);
-			cfg.nThreads = 0;
+	if (ip.cmdOptionExists(OPT_CONTROL_PORT)) {
+		const auto& portStr = ip.getCmdOption(OPT_CONTROL_PORT);
+		if (sscanf(portStr.c_str(), "%u", &cfg.controlPort) != 1 || cfg.controlPort == 0 || cfg.controlPort > 65535) {
+			logLine(prefix, "Invalid control port: %s", portStr.c_str());
+			return false;
 		}
 	}
 
-	if (ip.cmdOptionExists(OPT_REFRESH_RATE)) {
-		auto res = parseRefreshRate(ip.getCmdOption(OPT_REFRESH_RATE));
-		if (!res.first)
+	if (ip.cmdOptionExists(OPT_LOG_FILE)) {
+		cfg.log.filePath = ip.getCmdOption(OPT_LOG_FILE);
+		if (cfg.log.filePath.size() == 0) {
+			logLine(prefix, "Invalid log file");
 			return false;
-		cfg.refreshRateMs = res.second;
+		}
 	}
 
-	if (ip.cmdOptionExists(OPT_GETWORK_URL)) {
-		cfg.getWorkUrl = ip.getCmdOption(OPT_GETWORK_URL);
+	if (ip.cmdOptionExists(OPT_LOG_ROTATE)) {
+		const auto& rotateStr = ip.getCmdOption(OPT_LOG_ROTATE);
+		if (!parseLogRotate(rotateStr, cfg.log)) {
+			logLine(prefix, "Invalid log rotation: %s, try 10m or 24h", rotateStr.c_str());
+			return false;
+		}
 	}
 
-	if (ip.cmdOptionExists(OPT_FULLNODE_URL)) {
-		cfg.fullNodeUrl = ip.getCmdOption(OPT_FULLNODE_URL);
+	if (ip.cmdOptionExists(OPT_PERF_COUNTERS)) {
+		cfg.perfCounters = true;
+	}
+
+	if (ip.cmdOptionExists(OPT_WATCHDOG)) {
+		const auto& actionStr = ip.getCmdOption(OPT_WATCHDOG);
+		if (!parseWatchdogAction(actionStr, cfg.watchdogAction)) {
+			logLine(prefix, "Invalid watchdog action: %s, try none, restart or repin", actionStr.c_str());
+			return false;
+		}
+	}
+
+	if (ip.cmdOptionExists(OPT_SHM_STATS)) {
+		cfg.shmStatsName = ip.getCmdOption(OPT_SHM_STATS);
+		if (cfg.shmStatsName.size() == 0 || cfg.shmStatsName.find('/') != std::string::npos) {
+			logLine(prefix, "Invalid shared memory stats name, try: --shm-stats aquacppminer");
+			return false;
+		}
+	}
+
+	if (ip.cmdOptionExists(OPT_INTENSITY)) {
+		const auto& intensityStr = ip.getCmdOption(OPT_INTENSITY);
+		if (!parseIntensity(intensityStr, cfg.intensity)) {
+			logLine(prefix, "Invalid intensity: %s, try 60%% or 150k", intensityStr.c_str());
+			return false;
+		}
+	}
+
+	if (ip.cmdOptionExists(OPT_BACKGROUND)) {
+		cfg.background = true;
+	}
+
+	if (ip.cmdOptionExists(OPT_AUTOTUNE)) {
+		cfg.autotune = true;
+	}
+
+	if (ip.cmdOptionExists(OPT_BENCH)) {
+		cfg.bench = true;
+		const auto& benchOutput = ip.getCmdOption(OPT_BENCH);
+		if (benchOutput.size() > 0 && benchOutput[0] != '-') {
+			cfg.benchOutput = benchOutput;
+		}
+	}
+
+	if (ip.cmdOptionExists(OPT_VALIDATE)) {
+		const auto& rateStr = ip.getCmdOption(OPT_VALIDATE);
+		if (!parseValidateRate(rateStr, cfg.validateRate)) {
+			logLine(prefix, "Invalid validation rate: %s, try 0.1%% or 0", rateStr.c_str());
+			return false;
+		}
+	}
+
+	if (ip.cmdOptionExists(OPT_AFFINITY)) {
+		const auto& affinityStr = ip.getCmdOption(OPT_AFFINITY);
+		if (!parseAffinity(affinityStr, cfg.affinity)) {
+			logLine(prefix, "Invalid affinity: %s, try cores, all, none or a cpu list like 0-7,16-23", affinityStr.c_str());
+			return false;
+		}
+	}
+
+	if (!applyMiningArgs(prefix, argc, argv, cfg)) {
+		return false;
 	}
 
 	setMiningConfig(cfg);
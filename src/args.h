@@ -2,7 +2,11 @@
 
 #include <string>
 
+struct MiningConfig;
+
 bool parseArgs(const char* prefix, int argc, char** argv);
+// applies mining related commandline params on top of cfg (no proxy / usage handling, used by config reload)
+bool applyMiningArgs(const char* prefix, int argc, char** argv, MiningConfig& cfg);
 void printUsage();
 std::pair<bool, uint32_t> parseRefreshRate(const std::string& refreshRateStr);
 
@@ -14,15 +18,43 @@ const std::string OPT_FULLNODE_URL = "-n";
 const std::string OPT_REFRESH_RATE = "-r";
 const std::string OPT_SOLO = "--solo";
 const std::string OPT_PROXY = "--proxy";
+const std::string OPT_POOLS = "--pools";
+const std::string OPT_METRICS_PORT = "--metrics-port";
+const std::string OPT_CONTROL_PORT = "--control-port";
+const std::string OPT_LOG_FILE = "--log-file";
+const std::string OPT_LOG_ROTATE = "--log-rotate";
+const std::string OPT_PERF_COUNTERS = "--perf-counters";
+const std::string OPT_WATCHDOG = "--watchdog";
+const std::string OPT_SHM_STATS = "--shm-stats";
+const std::string OPT_AFFINITY = "--affinity";
+const std::string OPT_BACKGROUND = "--background";
+const std::string OPT_INTENSITY = "--intensity";
+const std::string OPT_AUTOTUNE = "--autotune";
+const std::string OPT_BENCH = "--bench";
+const std::string OPT_VALIDATE = "--validate";
 
 const std::string s_usageMsg =
-"aquacppminer.exe -F url [-t nThreads] [-n nodeUrl] [--solo] [-r refreshRate] [-h]\n"
+"aquacppminer.exe -F url [-t nThreads] [-n nodeUrl] [--solo] [-r refreshRate] [--pools list] [--metrics-port port] [--control-port port] [--log-file path] [--log-rotate 10m|24h] [--perf-counters] [--watchdog action] [--shm-stats name] [--affinity policy] [--background] [--intensity cap] [--autotune] [--bench [file]] [--validate rate] [-h]\n"
 "  -F url         : Mining URL. If not specified, will pool mine to local AQUA RPC server (port 8543)\n"
-"  -t nThreads    : number of threads to use (if not specified will use maximum logical threads available)\n"
+"  -t nThreads    : number of threads to use (if not specified will use logical threads available, capped by container cpu quota / cpuset, re-checked while mining)\n"
 "  -n node_url    : optional node url, to get more stats (pool mining only)\n"
 "  -r rate        : pool refresh rate in milliseconds, or 3s, 2.5m, default is 3s\n"
 "  --solo         : solo mining, -F needs to be the node url or empty\n"
 "  --proxy        : proxy to use, ex: --proxy socks5://127.0.0.1:9150\n"
+"  --pools list   : split threads between pools, ex: --pools 3:http://poolA:8888/0x..,1:http://poolB:8888/0x..\n"
+"  --metrics-port : serve prometheus metrics on http://host:port/metrics\n"
+"  --control-port : JSON-RPC control API on http://127.0.0.1:port (stats, setThreads, setIntensity, pause, resume, switchPool, benchmark)\n"
+"  --log-file     : also write log lines to this file\n"
+"  --log-rotate   : rotate log file by size (512k, 10m) or age (24h, 7d), keeps 5 old files\n"
+"  --perf-counters: report IPC, cache / TLB misses per hash and effective GHz per thread (Linux)\n"
+"  --watchdog     : action on slow / stalled miner threads: none (log only, default), restart, repin (Linux)\n"
+"  --shm-stats    : publish counters in shared memory /dev/shm/name (Windows: Local\\name), read with aquastat\n"
+"  --affinity     : pin miner threads: cores (one per physical core), all (every logical cpu), cpu list (ex: 0-7,16-23), none (default)\n"
+"  --background   : idle priority miner threads, parked while the host is under cpu / memory pressure (Linux PSI)\n"
+"  --intensity    : cap throughput without changing thread count: 60% (share of time hashing) or 150k (total H/s)\n"
+"  --autotune     : benchmark thread count & affinity at first start, saved in tuning.cfg per cpu & hash version\n"
+"  --bench [file] : offline benchmark of all hash versions & thread counts (-t, --affinity), JSON report to file or stdout\n"
+"  --validate     : share of hashes re-checked with the reference kernel in background: 0.1% (default), 0 = found shares only\n"
 "  -h             : display this help message and exit\n"
 ;
 
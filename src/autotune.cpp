@@ -0,0 +1,134 @@
+#include "autotune.h"
+#include "bench.h"
+#include "log.h"
+
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+
+const uint32_t AUTOTUNE_WARMUP_MS = 1000;
+const uint32_t AUTOTUNE_RUN_MS = 3000;
+// a candidate with fewer threads wins when it is this close to the best
+const double AUTOTUNE_TIE_RATIO = 0.01;
+
+std::string tuningKey(const std::string& minerVersion, const std::string& arch, int hashVersion) {
+	std::string model, microcode;
+	cpuModelInfo(model, microcode);
+	char key[512];
+	snprintf(key, sizeof(key), "%s|ucode %s|%d cpus|%s|%s|v%d",
+		model.c_str(), microcode.c_str(), (int)cpuTopology().cpus.size(),
+		arch.size() ? arch.c_str() : "SSE2", minerVersion.c_str(), hashVersion);
+	return key;
+}
+
+// key \t nThreads \t affinity \t hashesPerSecond
+static bool parseProfileLine(const std::string& line, TuningProfile& profile) {
+	std::vector<std::string> fields;
+	std::stringstream ss(line);
+	std::string field;
+	while (std::getline(ss, field, '\t')) {
+		fields.push_back(field);
+	}
+	AffinityConfig affinity;
+	if (fields.size() != 4 || !parseAffinity(fields[2], affinity) || affinity.policy == AFFINITY_LIST) {
+		return false;
+	}
+	profile.key = fields[0];
+	profile.nThreads = atoi(fields[1].c_str());
+	profile.affinity = affinity.policy;
+	profile.hashesPerSecond = atof(fields[3].c_str());
+	return profile.nThreads > 0;
+}
+
+static std::string formatProfileLine(const TuningProfile& profile) {
+	char line[1024];
+	snprintf(line, sizeof(line), "%s\t%d\t%s\t%.3f",
+		profile.key.c_str(), profile.nThreads, affinityPolicyName(profile.affinity), profile.hashesPerSecond);
+	return line;
+}
+
+bool loadTuningProfile(const std::string& path, const std::string& key, TuningProfile& profile) {
+	std::ifstream f(path);
+	std::string line;
+	while (std::getline(f, line)) {
+		TuningProfile p;
+		if (line.size() && line[0] != '#' && parseProfileLine(line, p) && p.key == key) {
+			profile = p;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool saveTuningProfile(const std::string& path, const TuningProfile& profile) {
+	std::vector<std::string> lines;
+	{
+		std::ifstream f(path);
+		std::string line;
+		while (std::getline(f, line)) {
+			TuningProfile p;
+			if (line.size() && line[0] != '#' && parseProfileLine(line, p) && p.key != profile.key) {
+				lines.push_back(line);
+			}
+		}
+	}
+	lines.push_back(formatProfileLine(profile));
+
+	std::ofstream f(path, std::ios::trunc);
+	if (!f) {
+		return false;
+	}
+	f << "# aquacppminer tuning profiles (--autotune): key, threads, affinity, H/s" << std::endl;
+	for (const auto& line : lines) {
+		f << line << std::endl;
+	}
+	return (bool)f;
+}
+
+TuningProfile runAutotune(const char* logPrefix, int hashVersion, int maxThreads) {
+	const CpuTopology& topo = cpuTopology();
+	int nLogical = std::min((int)topo.cpus.size(), maxThreads);
+	int nCores = std::min(topo.nCores, nLogical);
+
+	// physical cores only, half of the SMT siblings, all logical cpus
+	std::vector<int> threadCounts = { nCores, (nCores + nLogical) / 2, nLogical };
+	if (nCores == nLogical && nLogical > 1) {
+		// no SMT: does leaving a cpu to the OS & network threads help ?
+		threadCounts.push_back(nLogical - 1);
+	}
+	std::sort(threadCounts.begin(), threadCounts.end());
+	threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+
+	// pinned placement is physical cores first, so thread counts above cores select SMT siblings
+	std::vector<AffinityPolicy> policies = { AFFINITY_NONE };
+#if defined(__linux__) || defined(_WIN32)
+	policies.push_back(AFFINITY_CORES);
+#endif
+
+	logLine(logPrefix, "Autotune: hash version %d, %d candidates, %.0fs each",
+		hashVersion, (int)(threadCounts.size() * policies.size()), (AUTOTUNE_WARMUP_MS + AUTOTUNE_RUN_MS) / 1000.0);
+
+	TuningProfile best;
+	for (int nThreads : threadCounts) {
+		if (nThreads <= 0) {
+			continue;
+		}
+		for (AffinityPolicy policy : policies) {
+			AffinityConfig affinity;
+			affinity.policy = policy;
+			auto res = runBenchmark(hashVersion, nThreads, AUTOTUNE_RUN_MS, AUTOTUNE_WARMUP_MS, affinityPlacement(affinity));
+			logLine(logPrefix, "Autotune: %3d threads, affinity %-5s : %.3f kH/s",
+				nThreads, affinityPolicyName(policy), res.hashesPerSecond / 1000.0);
+			// candidates come by increasing thread count: more threads must be clearly better
+			if (res.hashesPerSecond > best.hashesPerSecond * (1.0 + AUTOTUNE_TIE_RATIO)) {
+				best.nThreads = nThreads;
+				best.affinity = policy;
+				best.hashesPerSecond = res.hashesPerSecond;
+			}
+		}
+	}
+	return best;
+}
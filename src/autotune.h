@@ -0,0 +1,29 @@
+#pragma once
+
+#include "topology.h"
+
+#include <string>
+
+// startup auto tuner (--autotune): offline benchmark of thread count x placement candidates,
+// best result saved in tuning.cfg next to config.cfg, keyed by CPU model, microcode, build ISA,
+// miner version & hash version, so later starts with the same key reuse it without benchmarking
+
+const std::string TUNING_FILE_NAME = "tuning.cfg";
+
+struct TuningProfile {
+	std::string key;
+	int nThreads = 0;
+	AffinityPolicy affinity = AFFINITY_NONE;
+	double hashesPerSecond = 0;
+};
+
+std::string tuningKey(const std::string& minerVersion, const std::string& arch, int hashVersion);
+
+// one line per key in the file, false if the key is not there
+bool loadTuningProfile(const std::string& path, const std::string& key, TuningProfile& profile);
+// replaces the line of the same key, keeps the others
+bool saveTuningProfile(const std::string& path, const TuningProfile& profile);
+
+// benchmarks each candidate for a few seconds (miner threads must not be running)
+// maxThreads: upper bound of the thread count (CPU limits), candidates never exceed it
+TuningProfile runAutotune(const char* logPrefix, int hashVersion, int maxThreads);
@@ -0,0 +1,230 @@
+#include "background.h"
+#include "miner.h"
+#include "miningConfig.h"
+#include "updateThread.h"
+#include "log.h"
+
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#endif
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include <atomic>
+#include <string>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+const char* BACKGROUND_LOG_PREFIX = "BGND";
+
+const int64_t PSI_SAMPLE_MS = 1000;
+// pressure above HIGH parks a quarter of the active threads right away,
+// below LOW for RAMP_UP_CALM_SAMPLES samples in a row brings back one eighth
+const double PSI_HIGH = 0.10;
+const double PSI_LOW = 0.02;
+const int RAMP_UP_CALM_SAMPLES = 5;
+
+// from linux/ioprio.h, not always installed
+const int IOPRIO_WHO_PROCESS_ID = 1;
+const int IOPRIO_CLASS_IDLE_ID = 3;
+const int IOPRIO_CLASS_SHIFT_BITS = 13;
+
+// written by miner threads at start / exit, read by the main thread
+static std::atomic<int> s_tids[MAX_MINER_THREADS];
+
+// main thread only
+static bool s_psiInit = false;
+static int64_t s_lastSampleMs = 0;
+static uint64_t s_lastPsiTotalUs[2] = { 0, 0 };
+static int s_nParked = 0;
+static int s_nCalm = 0;
+static int s_lastTids[MAX_MINER_THREADS];
+static uint64_t s_lastRunDelayNs[MAX_MINER_THREADS];
+
+// read by the metrics thread
+static std::atomic<bool> s_psiAvailable(false);
+static std::atomic<int> s_activeThreads(0);
+static std::atomic<uint32_t> s_pressureMilli[2];
+static std::atomic<uint64_t> s_backoffUs(0);
+static std::atomic<uint64_t> s_preemptedUs(0);
+
+static void setIdlePriority(int minerID) {
+#if defined(__linux__)
+	int tid = (int)syscall(SYS_gettid);
+	s_tids[minerID] = tid;
+
+	// per thread on Linux, nice 19 when SCHED_IDLE is refused
+	struct sched_param param;
+	memset(&param, 0, sizeof(param));
+	if (sched_setscheduler(0, SCHED_IDLE, &param) != 0) {
+		setpriority(PRIO_PROCESS, tid, 19);
+	}
+	syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS_ID, tid, IOPRIO_CLASS_IDLE_ID << IOPRIO_CLASS_SHIFT_BITS);
+#elif defined(_WIN32)
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_IDLE);
+#else
+	static std::atomic<bool> s_logged(false);
+	if (!s_logged.exchange(true)) {
+		logLine(BACKGROUND_LOG_PREFIX, "Warning: idle priority not supported on this OS");
+	}
+#endif
+}
+
+void backgroundThreadStart(int minerID) {
+	if (!miningConfig().background) {
+		return;
+	}
+	setIdlePriority(minerID);
+}
+
+void backgroundThreadStop(int minerID) {
+	s_tids[minerID] = 0;
+}
+
+#ifdef __linux__
+// "some avg10=1.03 avg60=1.41 avg300=1.39 total=31808953", total in us
+static bool readPsiTotal(const char* path, uint64_t& totalUs) {
+	FILE* f = fopen(path, "r");
+	if (!f) {
+		return false;
+	}
+	char line[256];
+	bool ok = false;
+	while (fgets(line, sizeof(line), f)) {
+		unsigned long long total;
+		const char* p = strstr(line, "total=");
+		if (strncmp(line, "some", 4) == 0 && p && sscanf(p, "total=%llu", &total) == 1) {
+			totalUs = total;
+			ok = true;
+			break;
+		}
+	}
+	fclose(f);
+	return ok;
+}
+
+// schedstat: "cpu_time_ns run_delay_ns timeslices"
+static bool readRunDelayNs(int tid, uint64_t& runDelayNs) {
+	char path[64];
+	snprintf(path, sizeof(path), "/proc/self/task/%d/schedstat", tid);
+	FILE* f = fopen(path, "r");
+	if (!f) {
+		return false;
+	}
+	unsigned long long cpuNs, delayNs;
+	bool ok = fscanf(f, "%llu %llu", &cpuNs, &delayNs) == 2;
+	fclose(f);
+	runDelayNs = delayNs;
+	return ok;
+}
+
+static void samplePreemption(int nThreads) {
+	uint64_t preemptedNs = 0;
+	for (int i = 0; i < nThreads; i++) {
+		int tid = s_tids[i];
+		uint64_t delayNs;
+		if (tid <= 0 || !readRunDelayNs(tid, delayNs)) {
+			continue;
+		}
+		// restarted thread: new tid, new counter
+		if (tid == s_lastTids[i] && delayNs >= s_lastRunDelayNs[i]) {
+			preemptedNs += delayNs - s_lastRunDelayNs[i];
+		}
+		s_lastTids[i] = tid;
+		s_lastRunDelayNs[i] = delayNs;
+	}
+	s_preemptedUs += preemptedNs / 1000;
+}
+#endif
+
+void backgroundTick() {
+#ifdef __linux__
+	if (!miningConfig().background) {
+		return;
+	}
+	int64_t nowMs = steadyNowMs();
+	if (s_lastSampleMs != 0 && nowMs - s_lastSampleMs < PSI_SAMPLE_MS) {
+		return;
+	}
+	int64_t elapsedMs = (s_lastSampleMs == 0) ? 0 : nowMs - s_lastSampleMs;
+	s_lastSampleMs = nowMs;
+
+	int nThreads = nMinerThreads();
+	samplePreemption(nThreads);
+
+	const char* PSI_FILES[2] = { "/proc/pressure/cpu", "/proc/pressure/memory" };
+	uint64_t totals[2];
+	bool ok = readPsiTotal(PSI_FILES[0], totals[0]) && readPsiTotal(PSI_FILES[1], totals[1]);
+	if (!s_psiInit) {
+		s_psiInit = true;
+		s_psiAvailable = ok;
+		if (!ok) {
+			logLine(BACKGROUND_LOG_PREFIX, "Warning: no PSI (/proc/pressure), idle priority only");
+		}
+	}
+	if (!s_psiAvailable || !ok) {
+		s_activeThreads = nThreads;
+		return;
+	}
+
+	// pressure over the last sample, from the cumulative stall time (avg10 reacts too slowly)
+	double pressure = 0;
+	for (int r = 0; r < 2; r++) {
+		double p = 0;
+		if (elapsedMs > 0 && totals[r] >= s_lastPsiTotalUs[r]) {
+			p = std::min(1.0, (totals[r] - s_lastPsiTotalUs[r]) / (elapsedMs * 1000.0));
+		}
+		s_lastPsiTotalUs[r] = totals[r];
+		s_pressureMilli[r] = (uint32_t)(p * 1000.0);
+		pressure = std::max(pressure, p);
+	}
+	if (elapsedMs == 0) {
+		return;
+	}
+
+	// parked threads cost hashing time
+	s_nParked = std::min(s_nParked, nThreads);
+	s_backoffUs += (uint64_t)s_nParked * (uint64_t)elapsedMs * 1000;
+
+	int nParkedOld = s_nParked;
+	int nActive = nThreads - s_nParked;
+	if (pressure > PSI_HIGH && nActive > 0) {
+		s_nParked += std::max(1, nActive / 4);
+		s_nCalm = 0;
+	}
+	else if (pressure < PSI_LOW && s_nParked > 0) {
+		if (++s_nCalm >= RAMP_UP_CALM_SAMPLES) {
+			s_nParked = std::max(0, s_nParked - std::max(1, nThreads / 8));
+			s_nCalm = 0;
+		}
+	}
+	else {
+		s_nCalm = 0;
+	}
+	s_nParked = std::min(s_nParked, nThreads);
+
+	// active count is relative to the current pool, threads added later are active too
+	setActiveMinerThreads(s_nParked == 0 ? MAX_MINER_THREADS : nThreads - s_nParked);
+	s_activeThreads = nThreads - s_nParked;
+	if (s_nParked != nParkedOld) {
+		logLine(BACKGROUND_LOG_PREFIX, "cpu pressure %.1f%%, memory %.1f%% -> %d/%d threads active",
+			s_pressureMilli[0] / 10.0, s_pressureMilli[1] / 10.0, nThreads - s_nParked, nThreads);
+	}
+#endif
+}
+
+BackgroundStats getBackgroundStats() {
+	BackgroundStats s;
+	s.psiAvailable = s_psiAvailable;
+	s.activeThreads = s_activeThreads;
+	s.cpuPressure = s_pressureMilli[0] / 1000.0;
+	s.memoryPressure = s_pressureMilli[1] / 1000.0;
+	s.backoffSeconds = s_backoffUs / 1e6;
+	s.preemptedSeconds = s_preemptedUs / 1e6;
+	return s;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+// --background: mining on spare capacity of busy hosts
+// miner threads run at idle priority (Linux SCHED_IDLE + idle io priority, Windows THREAD_PRIORITY_IDLE)
+// and the number of active threads follows host pressure (Linux PSI, /proc/pressure/cpu & memory):
+// threads are parked when pressure rises and brought back one step at a time once the host is idle again
+
+// called by each miner thread on itself, at start / exit, no-op without --background
+void backgroundThreadStart(int minerID);
+void backgroundThreadStop(int minerID);
+
+// called by the main loop, samples pressure about once per second
+void backgroundTick();
+
+struct BackgroundStats {
+	bool psiAvailable;
+	int activeThreads;
+	double cpuPressure;      // share of time some task waited for a CPU, 0..1, over the last sample
+	double memoryPressure;   // same for memory
+	double backoffSeconds;   // thread-seconds parked because of pressure
+	double preemptedSeconds; // thread-seconds runnable but not running (Linux schedstat run_delay)
+};
+BackgroundStats getBackgroundStats();
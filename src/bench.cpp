@@ -0,0 +1,204 @@
+#include "bench.h"
+#include "miner.h"
+#include "topology.h"
+#include "string_utils.h"
+#include "log.h"
+
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <assert.h>
+
+using std::chrono::high_resolution_clock;
+
+// same reference work as testAquaHashing() & golang/ref_argon.go
+const char* BENCH_WORK_HASH_HEX = "0xd3b5f1b47f52fdc72b1dab0b02ab352442487a1d3a43211bc4f0eb5f092403fc";
+const uint64_t BENCH_NONCE = 5577006791947779410ULL;
+
+// aqua hash versions 2..5: m = 1, 16, 32, 64 KiB
+const int BENCH_MIN_VERSION = 2;
+const int BENCH_MAX_VERSION = 5;
+const uint32_t BENCH_DURATION_MS = 5000;
+const uint32_t BENCH_WARMUP_MS = 1000;
+
+static void benchThreadFn(
+	int threadID,
+	int version,
+	int cpu,
+	std::atomic<bool>* pStart,
+	std::atomic<bool>* pCounting,
+	std::atomic<bool>* pRun,
+	uint64_t* pHashes)
+{
+	if (cpu >= 0) {
+		pinCurrentThread(cpu);
+	}
+	Bytes seed;
+	uint8_t rawHash[ARGON2_HASH_LEN];
+	Argon2_Context ctx;
+	uint64_t nonce = BENCH_NONCE + ((uint64_t)threadID << 40);
+	generateAquaSeed(nonce, BENCH_WORK_HASH_HEX, seed);
+	setupAquaArgonCtx(ctx, seed, rawHash);
+	ctx.m_cost = version2memcost(version);
+
+	while (!*pStart) {
+		std::this_thread::yield();
+	}
+
+	uint64_t nHashes = 0;
+	bool counting = false;
+	while (*pRun) {
+		updateAquaSeed(nonce++, seed);
+		int res = argon2_ctx(&ctx, Argon2_id);
+		if (res != ARGON2_OK) {
+			assert(0);
+			break;
+		}
+		// only hashes started after the warm up are counted
+		if (!counting && *pCounting) {
+			counting = true;
+			nHashes = 0;
+			continue;
+		}
+		nHashes++;
+	}
+	*pHashes = nHashes;
+}
+
+BenchResult runBenchmark(int version, int nThreads, uint32_t durationMs, uint32_t warmupMs,
+	const std::vector<int>& cpus)
+{
+	assert(nThreads > 0);
+	BenchResult res;
+	res.version = version;
+	res.nThreads = nThreads;
+
+	std::atomic<bool> start(false), counting(false), run(true);
+	std::vector<uint64_t> hashes(nThreads, 0);
+	std::vector<std::thread*> threads(nThreads);
+	for (int i = 0; i < nThreads; i++) {
+		int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+		threads[i] = new std::thread(benchThreadFn, i, version, cpu, &start, &counting, &run, &hashes[i]);
+	}
+
+	start = true;
+	std::this_thread::sleep_for(std::chrono::milliseconds(warmupMs));
+	counting = true;
+	auto tStart = high_resolution_clock::now();
+	std::this_thread::sleep_for(std::chrono::milliseconds(durationMs));
+	run = false;
+	auto tEnd = high_resolution_clock::now();
+
+	for (int i = 0; i < nThreads; i++) {
+		threads[i]->join();
+		delete threads[i];
+	}
+
+	std::chrono::duration<double> duration = tEnd - tStart;
+	res.durationS = duration.count();
+	res.hashesPerSecond = 0;
+	for (int i = 0; i < nThreads; i++) {
+		double hs = (double)hashes[i] / res.durationS;
+		res.threadHashesPerSecond.push_back(hs);
+		res.hashesPerSecond += hs;
+	}
+	return res;
+}
+
+BenchSweep defaultBenchSweep() {
+	BenchSweep sweep;
+	for (int v = BENCH_MIN_VERSION; v <= BENCH_MAX_VERSION; v++) {
+		sweep.versions.push_back(v);
+	}
+	const CpuTopology& topo = cpuTopology();
+	sweep.threadCounts = { 1, topo.nCores, (int)topo.cpus.size() };
+	std::sort(sweep.threadCounts.begin(), sweep.threadCounts.end());
+	sweep.threadCounts.erase(std::unique(sweep.threadCounts.begin(), sweep.threadCounts.end()), sweep.threadCounts.end());
+	sweep.affinity = "none";
+	sweep.durationMs = BENCH_DURATION_MS;
+	sweep.warmupMs = BENCH_WARMUP_MS;
+	return sweep;
+}
+
+static std::string jsonDouble(double v) {
+	char buf[64];
+	snprintf(buf, sizeof(buf), "%.3f", v);
+	return buf;
+}
+
+static std::string cpuInfoJson() {
+	const CpuTopology& topo = cpuTopology();
+	std::string model, microcode;
+	cpuModelInfo(model, microcode);
+	std::string s = "{";
+	s += "\"model\":\"" + jsonEscape(model) + "\"";
+	s += ",\"microcode\":\"" + jsonEscape(microcode) + "\"";
+	s += ",\"logicalCpus\":" + std::to_string(topo.cpus.size());
+	s += ",\"cores\":" + std::to_string(topo.nCores);
+	s += ",\"packages\":" + std::to_string(topo.nPackages);
+	s += ",\"numaNodes\":" + std::to_string(topo.nNodes);
+	s += ",\"l2Bytes\":" + std::to_string(topo.l2Bytes);
+	s += ",\"l3Bytes\":" + std::to_string(topo.l3Bytes);
+	s += "}";
+	return s;
+}
+
+// per thread spread: slowest / fastest thread & coefficient of variation
+static std::string benchResultJson(const BenchResult& res, const std::string& affinity) {
+	const auto& threads = res.threadHashesPerSecond;
+	double mean = threads.empty() ? 0 : res.hashesPerSecond / threads.size();
+	double minHs = threads.empty() ? 0 : *std::min_element(threads.begin(), threads.end());
+	double maxHs = threads.empty() ? 0 : *std::max_element(threads.begin(), threads.end());
+	double var = 0;
+	for (double hs : threads) {
+		var += (hs - mean) * (hs - mean);
+	}
+	double cv = (threads.empty() || mean <= 0) ? 0 : sqrt(var / threads.size()) / mean;
+
+	std::string s = "{";
+	s += "\"version\":" + std::to_string(res.version);
+	s += ",\"memoryKiB\":" + std::to_string(version2memcost(res.version));
+	s += ",\"threads\":" + std::to_string(res.nThreads);
+	s += ",\"affinity\":\"" + affinity + "\"";
+	s += ",\"seconds\":" + jsonDouble(res.durationS);
+	s += ",\"hashrate\":" + jsonDouble(res.hashesPerSecond);
+	s += ",\"threadMin\":" + jsonDouble(minHs);
+	s += ",\"threadMean\":" + jsonDouble(mean);
+	s += ",\"threadMax\":" + jsonDouble(maxHs);
+	s += ",\"threadCv\":" + jsonDouble(cv);
+	s += ",\"threadHashrates\":[";
+	for (size_t i = 0; i < threads.size(); i++) {
+		s += (i > 0 ? "," : "") + jsonDouble(threads[i]);
+	}
+	s += "]}";
+	return s;
+}
+
+std::string runBenchmarkSweep(const char* logPrefix, const BenchSweep& sweep) {
+	std::string results;
+	for (int version : sweep.versions) {
+		for (int nThreads : sweep.threadCounts) {
+			if (nThreads <= 0) {
+				continue;
+			}
+			auto res = runBenchmark(version, nThreads, sweep.durationMs, sweep.warmupMs, sweep.cpus);
+			logLine(logPrefix, "Bench: version %d (m=%u), %3d threads : %9.3f kH/s (%.3f kH/s per thread)",
+				version, version2memcost(version), nThreads, res.hashesPerSecond / 1000.0,
+				res.hashesPerSecond / nThreads / 1000.0);
+			results += (results.empty() ? "" : ",") + benchResultJson(res, sweep.affinity);
+		}
+	}
+
+	std::string s = "{";
+	s += "\"miner\":\"" + jsonEscape(sweep.minerVersion) + "\"";
+	s += ",\"kernel\":\"" + jsonEscape(sweep.kernel) + "\"";
+	s += ",\"cpu\":" + cpuInfoJson();
+	s += ",\"warmupSeconds\":" + jsonDouble(sweep.warmupMs / 1000.0);
+	s += ",\"durationSeconds\":" + jsonDouble(sweep.durationMs / 1000.0);
+	s += ",\"results\":[" + results + "]";
+	s += "}";
+	return s;
+}
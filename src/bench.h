@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// offline benchmark: hashes a fixed work with an impossible target, no network involved
+struct BenchResult {
+	int version;
+	int nThreads;
+	double durationS;
+	double hashesPerSecond;
+	std::vector<double> threadHashesPerSecond;
+};
+
+// runs nThreads hashing threads for warmupMs (not counted) then durationMs
+// thread i is pinned on cpus[i % size] when cpus is not empty
+BenchResult runBenchmark(int version, int nThreads, uint32_t durationMs, uint32_t warmupMs,
+	const std::vector<int>& cpus = std::vector<int>());
+
+// --bench: sweep of hash versions x thread counts, JSON report with per thread spread & cpu info
+struct BenchSweep {
+	std::vector<int> versions;
+	std::vector<int> threadCounts;
+	std::vector<int> cpus;   // placement (--affinity), empty to let the OS schedule
+	std::string affinity;    // placement name, for the report
+	uint32_t durationMs;
+	uint32_t warmupMs;
+	std::string minerVersion;
+	std::string kernel;      // argon2 kernel of this build (AVX2, AVX, SSE2)
+};
+// default sweep: all hash versions, 1 thread, physical cores & all logical CPUs
+BenchSweep defaultBenchSweep();
+std::string runBenchmarkSweep(const char* logPrefix, const BenchSweep& sweep);
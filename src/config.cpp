@@ -2,6 +2,10 @@
 #include "config.h"
 #include "args.h"
 #include "string_utils.h"
+#include "updateThread.h"
+#include "miner.h"
+#include "timer.h"
+#include "log.h"
 
 #ifdef _MSC_VER
 #include "windows/procinfo_windows.h"
@@ -12,6 +16,7 @@
 #include <sstream>
 #include <thread>
 #include <cstring>
+#include <mutex>
 
 extern std::string s_configDir;
 
@@ -45,9 +50,7 @@ bool configFileExists() {
 	return true;
 }
 
-bool loadConfigFile(std::string& log) {	
-	MiningConfig newCfg = miningConfig();
-
+static bool readConfigFile(MiningConfig& newCfg, std::string& log) {
 	std::ifstream fs(configFilePath());
 	const size_t BUFLEN = 256;
 	char params[N_PARAMS][BUFLEN];
@@ -80,13 +83,102 @@ bool loadConfigFile(std::string& log) {
 		log = "cannot find thread count";
 		return false;
 	}
+	if (newCfg.nThreads > (uint32_t)MAX_MINER_THREADS) {
+		log = "thread count above " + std::to_string(MAX_MINER_THREADS);
+		return false;
+	}
 	
 	if (sscanf(params[REFRESH_RATE_MS], "%u", &newCfg.refreshRateMs) != 1) {
 		log = "cannot find refresh rate";
 		return false;
 	}
 
+	// optional line: pools mined concurrently, same format as --pools
+	newCfg.pools.clear();
+	char pools[2048];
+	if (fs.getline(pools, sizeof(pools)) && strlen(pools) > 0) {
+		if (!parsePoolList(pools, newCfg.pools)) {
+			log = "cannot parse pools list";
+			return false;
+		}
+		newCfg.getWorkUrl = newCfg.pools[0].url;
+	}
+
+	return true;
+}
+
+bool loadConfigFile(std::string& log) {
+	MiningConfig newCfg = miningConfig();
+	if (!readConfigFile(newCfg, log)) {
+		return false;
+	}
+	setMiningConfig(newCfg);
+	return true;
+}
+
+static int s_reloadArgc = 0;
+static char** s_reloadArgv = nullptr;
+
+void setReloadArgs(int argc, char** argv) {
+	s_reloadArgc = argc;
+	s_reloadArgv = argv;
+}
+
+bool reloadConfig(const char* prefix, std::string& log) {
+	// SIGHUP (main thread) and the control API can both reload, and the control API also edits the config
+	std::lock_guard<std::mutex> lock(miningConfigUpdateMutex());
+	Timer t;
+	t.start();
+
+	// file first then commandline, same priority as at startup
+	MiningConfig oldCfg = miningConfig();
+	MiningConfig newCfg = oldCfg;
+	if (configFileExists() && !readConfigFile(newCfg, log)) {
+		return false;
+	}
+	if (s_reloadArgv && !applyMiningArgs(prefix, s_reloadArgc, s_reloadArgv, newCfg)) {
+		log = "invalid commandline parameters";
+		return false;
+	}
+	if (newCfg.getWorkUrl.size() == 0) {
+		log = "empty mining url";
+		return false;
+	}
+	// thread count 0 means auto, keep the count that was resolved at startup
+	if (newCfg.nThreads == 0) {
+		newCfg.nThreads = oldCfg.nThreads;
+	}
 	setMiningConfig(newCfg);
+
+	float durationS = 0.f;
+	t.end(durationS);
+
+	logLine(prefix, "Configuration reloaded in %.2fms", durationS * 1000.f);
+	if (newCfg.getWorkUrl != oldCfg.getWorkUrl) {
+		logLine(prefix, "%-8s : %s", newCfg.soloMine ? "node" : "pool", newCfg.getWorkUrl.c_str());
+	}
+	if (newCfg.refreshRateMs != oldCfg.refreshRateMs) {
+		logLine(prefix, "refresh  : %2.1fs", newCfg.refreshRateMs / 1000.0f);
+	}
+	if (newCfg.nThreads != oldCfg.nThreads) {
+		if (newCfg.nThreads > (uint32_t)MAX_MINER_THREADS || !setMinerThreadCount((int)newCfg.nThreads)) {
+			logLine(prefix, "Warning: thread count change (%u) will only apply after restart", newCfg.nThreads);
+		}
+		else {
+			logLine(prefix, "nthreads : %u", newCfg.nThreads);
+		}
+	}
+	auto poolsLog = formatPoolList(miningConfig().pools);
+	if (poolsLog != formatPoolList(oldCfg.pools)) {
+		logLine(prefix, "pools    : %s", poolsLog.c_str());
+	}
+
+	// move miner threads to their new pools, then start / stop pool update threads
+	assignMinerThreadsToPools();
+	syncUpdateThreads();
+
+	// new urls are picked by the update threads right away
+	triggerWorkUpdateAllPools(UPDATE_TRIGGER_CONFIG_CHANGED);
 	return true;
 }
 
@@ -159,7 +251,7 @@ bool createConfigFile(std::string &log) {
 		else {
 			int nThreads = 0;
 			nThreadsOk = sscanf(nThreadsStr.c_str(), "%d", &nThreads) == 1;
-			if (nThreads >= 0) {
+			if (nThreads >= 0 && nThreads <= MAX_MINER_THREADS) {
 				newCfg.nThreads = (uint32_t)nThreads;
 			}
 			else {
@@ -3,3 +3,7 @@
 bool configFileExists();
 bool loadConfigFile(std::string& log);
 bool createConfigFile(std::string &log);
+
+// hot reload: re-reads config file & commandline params, then swaps the mining config atomically
+void setReloadArgs(int argc, char** argv);
+bool reloadConfig(const char* prefix, std::string& log);
@@ -0,0 +1,378 @@
+#include "control.h"
+#include "httpServer.h"
+#include "miner.h"
+#include "miningConfig.h"
+#include "updateThread.h"
+#include "config.h"
+#include "metrics.h"
+#include "bench.h"
+#include "trace.h"
+#include "intensity.h"
+#include "string_utils.h"
+#include "log.h"
+
+#include <rapidjson/document.h>
+
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <stdio.h>
+#include <time.h>
+
+using namespace rapidjson;
+
+const char* CONTROL_LOG_PREFIX = "CTRL";
+
+// JSON-RPC 2.0 error codes
+const int RPC_PARSE_ERROR = -32700;
+const int RPC_INVALID_REQUEST = -32600;
+const int RPC_METHOD_NOT_FOUND = -32601;
+const int RPC_INVALID_PARAMS = -32602;
+const int RPC_INTERNAL_ERROR = -32603;
+
+const uint32_t MAX_BENCHMARK_SECONDS = 60;
+const uint32_t BENCHMARK_WARMUP_MS = 1000;
+
+static http_server_handle_t s_controlServer = nullptr;
+static uint16_t s_controlPort = 0;
+
+// methods changing the miner state are serialized
+static std::mutex s_control_mutex;
+
+// benchmark runs outside s_control_mutex (up to MAX_BENCHMARK_SECONDS), one at a time
+static std::atomic<bool> s_benchmarkRunning = { false };
+static std::atomic<uint32_t> s_nTraceDumps = { 0 };
+
+struct RpcResult {
+	bool ok = true;
+	int errorCode = 0;
+	std::string errorMessage;
+	std::string json = "true"; // result value when ok
+};
+
+static RpcResult rpcError(int code, const char* message) {
+	RpcResult res;
+	res.ok = false;
+	res.errorCode = code;
+	res.errorMessage = message;
+	return res;
+}
+
+static std::string formatDouble(double v) {
+	char buf[64];
+	snprintf(buf, sizeof(buf), "%.3f", v);
+	return buf;
+}
+
+static RpcResult rpcStats() {
+	auto cfg = miningConfig();
+	int nThreads = nMinerThreads();
+	std::string s = "{";
+	s += "\"threads\":" + std::to_string(nThreads);
+	s += ",\"paused\":" + std::string(minerThreadsPaused() ? "true" : "false");
+	s += ",\"intensity\":\"" + formatIntensity(currentIntensity()) + "\"";
+	s += ",\"solo\":" + std::string(cfg.soloMine ? "true" : "false");
+	s += ",\"hashes\":" + std::to_string(getTotalHashes());
+	s += ",\"hashrate\":" + formatDouble(publishedHashRate());
+	s += ",\"sharesSubmitted\":" + std::to_string(getTotalSharesSubmitted());
+	s += ",\"sharesAccepted\":" + std::to_string(getTotalSharesAccepted());
+	s += ",\"threadHashrates\":[";
+	for (int i = 0; i < nThreads; i++) {
+		s += (i > 0 ? "," : "") + formatDouble(publishedThreadHashRate(i));
+	}
+	s += "],\"pools\":[";
+	for (size_t i = 0; i < cfg.pools.size(); i++) {
+		auto status = getPoolStatus((int)i);
+		s += (i > 0 ? "," : "");
+		s += "{\"url\":\"" + jsonEscape(cfg.pools[i].url) + "\"";
+		s += ",\"weight\":" + std::to_string(cfg.pools[i].weight);
+		s += ",\"up\":" + std::string(status.up ? "true" : "false");
+		s += ",\"threads\":" + std::to_string(nMinerThreadsOnPool((int)i));
+		s += ",\"workVersion\":" + std::to_string(status.workVersion);
+		s += ",\"sharesSubmitted\":" + std::to_string(getPoolSharesSubmitted((int)i));
+		s += ",\"sharesAccepted\":" + std::to_string(getPoolSharesAccepted((int)i));
+		s += "}";
+	}
+	s += "]}";
+
+	RpcResult res;
+	res.json = s;
+	return res;
+}
+
+static RpcResult rpcSetThreads(const Value& params) {
+	if (!params.IsObject() || !params.HasMember("n") || !params["n"].IsInt()) {
+		return rpcError(RPC_INVALID_PARAMS, "expected {\"n\": nThreads}");
+	}
+	int n = params["n"].GetInt();
+	if (n <= 0 || n > MAX_MINER_THREADS) {
+		return rpcError(RPC_INVALID_PARAMS, "thread count out of range");
+	}
+
+	// only added / retired threads allocate or free their argon memory
+	std::lock_guard<std::mutex> lock(miningConfigUpdateMutex());
+	int nOld = nMinerThreads();
+	if (!setMinerThreadCount(n)) {
+		return rpcError(RPC_INTERNAL_ERROR, "not mining");
+	}
+	MiningConfig cfg = miningConfig();
+	cfg.nThreads = (uint32_t)n;
+	setMiningConfig(cfg);
+	logLine(CONTROL_LOG_PREFIX, "Miner threads: %d -> %d", nOld, n);
+	return RpcResult();
+}
+
+static RpcResult rpcSetIntensity(const Value& params) {
+	Intensity intensity;
+	if (!params.IsObject() || !params.HasMember("value") || !params["value"].IsString() ||
+		!parseIntensity(params["value"].GetString(), intensity)) {
+		return rpcError(RPC_INVALID_PARAMS, "expected {\"value\": \"60%\" | \"150k\" | \"off\"}");
+	}
+	std::lock_guard<std::mutex> lock(miningConfigUpdateMutex());
+	setIntensity(intensity);
+	MiningConfig cfg = miningConfig();
+	cfg.intensity = intensity;
+	setMiningConfig(cfg);
+	logLine(CONTROL_LOG_PREFIX, "Intensity: %s", formatIntensity(intensity).c_str());
+	return RpcResult();
+}
+
+static RpcResult rpcPause(bool pause) {
+	if (s_benchmarkRunning) {
+		return rpcError(RPC_INTERNAL_ERROR, "benchmark running");
+	}
+	pauseMinerThreads(pause);
+	logLine(CONTROL_LOG_PREFIX, pause ? "Mining paused" : "Mining resumed");
+	return RpcResult();
+}
+
+static RpcResult rpcSwitchPool(const Value& params) {
+	if (!params.IsObject()) {
+		return rpcError(RPC_INVALID_PARAMS, "expected {\"url\": url} or {\"pools\": \"w:url,...\"}");
+	}
+
+	// same lock as reloadConfig(), which also starts / stops pool update threads
+	std::lock_guard<std::mutex> lock(miningConfigUpdateMutex());
+	MiningConfig cfg = miningConfig();
+	if (params.HasMember("pools") && params["pools"].IsString()) {
+		if (!parsePoolList(params["pools"].GetString(), cfg.pools)) {
+			return rpcError(RPC_INVALID_PARAMS, "invalid pools list");
+		}
+		cfg.getWorkUrl = cfg.pools[0].url;
+	}
+	else if (params.HasMember("url") && params["url"].IsString()) {
+		cfg.getWorkUrl = params["url"].GetString();
+		if (cfg.getWorkUrl.size() == 0) {
+			return rpcError(RPC_INVALID_PARAMS, "empty url");
+		}
+		cfg.pools.clear();
+	}
+	else {
+		return rpcError(RPC_INVALID_PARAMS, "expected {\"url\": url} or {\"pools\": \"w:url,...\"}");
+	}
+
+	setMiningConfig(cfg);
+	assignMinerThreadsToPools();
+	syncUpdateThreads();
+	triggerWorkUpdateAllPools(UPDATE_TRIGGER_CONFIG_CHANGED);
+	logLine(CONTROL_LOG_PREFIX, "Switched to %s", formatPoolList(miningConfig().pools).c_str());
+	return RpcResult();
+}
+
+static RpcResult rpcReload() {
+	std::string log;
+	if (!reloadConfig(CONTROL_LOG_PREFIX, log)) {
+		return rpcError(RPC_INTERNAL_ERROR, log.c_str());
+	}
+	return RpcResult();
+}
+
+static RpcResult rpcBenchmark(const Value& params) {
+	uint32_t seconds = 10;
+	if (params.IsObject() && params.HasMember("seconds")) {
+		if (!params["seconds"].IsUint()) {
+			return rpcError(RPC_INVALID_PARAMS, "expected {\"seconds\": n}");
+		}
+		seconds = params["seconds"].GetUint();
+	}
+	if (seconds == 0 || seconds > MAX_BENCHMARK_SECONDS) {
+		return rpcError(RPC_INVALID_PARAMS, "seconds out of range");
+	}
+
+	if (s_benchmarkRunning.exchange(true)) {
+		return rpcError(RPC_INTERNAL_ERROR, "benchmark already running");
+	}
+
+	int nThreads = nMinerThreads();
+	if (nThreads <= 0) {
+		nThreads = (int)miningConfig().nThreads;
+	}
+	int version = currentWorkParams(0).version;
+	if (version < 2) {
+		version = 2;
+	}
+
+	// miner threads are paused so that they do not compete with the benchmark
+	bool wasPaused;
+	{
+		std::lock_guard<std::mutex> lock(s_control_mutex);
+		wasPaused = minerThreadsPaused();
+		pauseMinerThreads(true);
+	}
+	logLine(CONTROL_LOG_PREFIX, "Benchmark: version %d, %d threads, %us", version, nThreads, seconds);
+	auto bench = runBenchmark(version, nThreads, seconds * 1000, BENCHMARK_WARMUP_MS);
+	{
+		std::lock_guard<std::mutex> lock(s_control_mutex);
+		pauseMinerThreads(wasPaused);
+	}
+	s_benchmarkRunning = false;
+	logLine(CONTROL_LOG_PREFIX, "Benchmark: %.3f kH/s", bench.hashesPerSecond / 1000.0);
+
+	std::string s = "{";
+	s += "\"version\":" + std::to_string(bench.version);
+	s += ",\"threads\":" + std::to_string(bench.nThreads);
+	s += ",\"seconds\":" + formatDouble(bench.durationS);
+	s += ",\"hashrate\":" + formatDouble(bench.hashesPerSecond);
+	s += ",\"threadHashrates\":[";
+	for (size_t i = 0; i < bench.threadHashesPerSecond.size(); i++) {
+		s += (i > 0 ? "," : "") + formatDouble(bench.threadHashesPerSecond[i]);
+	}
+	s += "]}";
+
+	RpcResult res;
+	res.json = s;
+	return res;
+}
+
+extern std::string s_configDir;
+
+// dumps always go to the config directory under a generated name, the caller cannot pick the path
+static RpcResult rpcTraceDump(const Value& params) {
+	if (params.IsObject() && params.HasMember("path")) {
+		return rpcError(RPC_INVALID_PARAMS, "trace dump path cannot be set");
+	}
+	char name[64];
+	snprintf(name, sizeof(name), "trace_%lld_%u.json", (long long)time(nullptr), (unsigned int)s_nTraceDumps++);
+	std::string path = s_configDir + name;
+	std::string log;
+	if (!dumpTrace(path, log)) {
+		return rpcError(RPC_INTERNAL_ERROR, log.c_str());
+	}
+	RpcResult res;
+	res.json = "\"" + jsonEscape(path) + "\"";
+	return res;
+}
+
+// one thread per connection: read only methods & the benchmark do not wait for each other
+static RpcResult dispatch(const std::string& method, const Value& params) {
+	if (method == "stats") {
+		return rpcStats();
+	}
+	if (method == "traceDump") {
+		return rpcTraceDump(params);
+	}
+	if (method == "benchmark") {
+		return rpcBenchmark(params);
+	}
+
+	std::lock_guard<std::mutex> lock(s_control_mutex);
+	if (method == "setThreads") {
+		return rpcSetThreads(params);
+	}
+	if (method == "setIntensity") {
+		return rpcSetIntensity(params);
+	}
+	if (method == "pause") {
+		return rpcPause(true);
+	}
+	if (method == "resume") {
+		return rpcPause(false);
+	}
+	if (method == "switchPool") {
+		return rpcSwitchPool(params);
+	}
+	if (method == "reload") {
+		return rpcReload();
+	}
+	if (method == "hint") {
+		triggerWorkUpdateAllPools(UPDATE_TRIGGER_HINT);
+		return RpcResult();
+	}
+	return rpcError(RPC_METHOD_NOT_FOUND, "method not found");
+}
+
+static std::string formatResponse(const std::string& id, const RpcResult& res) {
+	std::string s = "{\"jsonrpc\":\"2.0\",\"id\":" + id;
+	if (res.ok) {
+		s += ",\"result\":" + res.json;
+	}
+	else {
+		s += ",\"error\":{\"code\":" + std::to_string(res.errorCode);
+		s += ",\"message\":\"" + jsonEscape(res.errorMessage) + "\"}";
+	}
+	s += "}\n";
+	return s;
+}
+
+static void handleControlRequest(const HttpRequest& req, HttpResponse& resp) {
+	resp.contentType = "application/json";
+	if (req.method != "POST") {
+		resp.status = 405;
+		resp.body = formatResponse("null", rpcError(RPC_INVALID_REQUEST, "use POST"));
+		return;
+	}
+	// DNS rebinding: a page of another domain resolving to 127.0.0.1 is same origin, but keeps its host name
+	std::string port = ":" + std::to_string(s_controlPort);
+	if (req.host != "127.0.0.1" + port && req.host != "localhost" + port && req.host != "[::1]" + port) {
+		resp.status = 403;
+		resp.body = formatResponse("null", rpcError(RPC_INVALID_REQUEST, "invalid Host header"));
+		return;
+	}
+	// a web page can POST text/plain to localhost without a CORS preflight, but not application/json
+	if (req.contentType != "application/json") {
+		resp.status = 415;
+		resp.body = formatResponse("null", rpcError(RPC_INVALID_REQUEST, "Content-Type must be application/json"));
+		return;
+	}
+
+	Document doc;
+	doc.Parse(req.body.c_str(), req.body.size());
+	if (doc.HasParseError()) {
+		resp.body = formatResponse("null", rpcError(RPC_PARSE_ERROR, "parse error"));
+		return;
+	}
+	if (!doc.IsObject() || !doc.HasMember("method") || !doc["method"].IsString()) {
+		resp.body = formatResponse("null", rpcError(RPC_INVALID_REQUEST, "invalid request"));
+		return;
+	}
+
+	// id is echoed back, numbers & strings only
+	std::string id = "null";
+	if (doc.HasMember("id")) {
+		const Value& v = doc["id"];
+		if (v.IsInt64()) {
+			id = std::to_string(v.GetInt64());
+		}
+		else if (v.IsString()) {
+			id = "\"" + jsonEscape(v.GetString()) + "\"";
+		}
+	}
+
+	static const Value NO_PARAMS;
+	const Value& params = doc.HasMember("params") ? doc["params"] : NO_PARAMS;
+	resp.body = formatResponse(id, dispatch(doc["method"].GetString(), params));
+}
+
+bool startControlServer(uint16_t port) {
+	if (s_controlServer) {
+		return true;
+	}
+	s_controlPort = port;
+	s_controlServer = startHttpServer(CONTROL_LOG_PREFIX, port, true, handleControlRequest, true);
+	return s_controlServer != nullptr;
+}
+
+void stopControlServer() {
+	stopHttpServer(s_controlServer);
+	s_controlServer = nullptr;
+}
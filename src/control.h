@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stdint.h>
+
+// local JSON-RPC 2.0 control API (HTTP POST on 127.0.0.1:port), used to retune a running miner:
+// stats, setThreads {n}, setIntensity {value}, pause, resume, switchPool {url|pools}, reload, benchmark {seconds}, hint, traceDump {path}
+bool startControlServer(uint16_t port);
+void stopControlServer();
@@ -31,6 +31,16 @@ std::pair<bool, Bytes> hexToBytes(std::string s) {
 	return{ true, res };
 }
 
+std::string bytesToHex(const byte* b, size_t count) {
+	static const char* DIGITS = "0123456789abcdef";
+	std::string s;
+	for (size_t i = 0; i < count; i++) {
+		s += DIGITS[b[i] >> 4];
+		s += DIGITS[b[i] & 15];
+	}
+	return s;
+}
+
 void decodeHex(const char* encoded, mpz_t mpz_res) {
 	auto pStart = encoded;
 	if (strncmp(encoded, "0x", 2) == 0)
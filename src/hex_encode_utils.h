@@ -15,4 +15,6 @@ std::string mpzToString(mpz_t num);
 typedef unsigned char byte;
 typedef std::vector<byte> Bytes;
 
-std::pair<bool, Bytes> hexToBytes(std::string s);
\ No newline at end of file
+std::pair<bool, Bytes> hexToBytes(std::string s);
+// lower case, no 0x prefix
+std::string bytesToHex(const byte* b, size_t count);
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include "histogram.h"
+
+#include <stdio.h>
+
+const double LatencyHistogram::BOUNDS_MS[LatencyHistogram::N_BUCKETS] = {
+	1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 30000
+};
+
+LatencyHistogram::LatencyHistogram() :
+	sumUs(0)
+{
+	for (int i = 0; i <= N_BUCKETS; i++) {
+		buckets[i] = 0;
+	}
+}
+
+void LatencyHistogram::add(double ms) {
+	int i = 0;
+	while (i < N_BUCKETS && ms > BOUNDS_MS[i]) {
+		i++;
+	}
+	buckets[i].fetch_add(1, std::memory_order_relaxed);
+	sumUs.fetch_add((uint64_t)(ms * 1000.0), std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::count() const {
+	uint64_t n = 0;
+	for (int i = 0; i <= N_BUCKETS; i++) {
+		n += buckets[i].load(std::memory_order_relaxed);
+	}
+	return n;
+}
+
+double LatencyHistogram::sumMs() const {
+	return sumUs.load(std::memory_order_relaxed) / 1000.0;
+}
+
+double LatencyHistogram::percentileMs(double p) const {
+	uint64_t total = count();
+	if (total == 0) {
+		return 0;
+	}
+	uint64_t rank = (uint64_t)(p * (double)total);
+	uint64_t n = 0;
+	for (int i = 0; i < N_BUCKETS; i++) {
+		n += buckets[i].load(std::memory_order_relaxed);
+		if (n > rank) {
+			return BOUNDS_MS[i];
+		}
+	}
+	return BOUNDS_MS[N_BUCKETS - 1];
+}
+
+void formatPrometheusHistogram(
+	std::string& out,
+	const char* name,
+	const char* labels,
+	const LatencyHistogram& h)
+{
+	char line[512];
+	const char* sep = (labels && labels[0]) ? "," : "";
+	uint64_t cumulative = 0;
+	for (int i = 0; i <= LatencyHistogram::N_BUCKETS; i++) {
+		cumulative += h.buckets[i].load(std::memory_order_relaxed);
+		if (i < LatencyHistogram::N_BUCKETS) {
+			snprintf(line, sizeof(line), "%s_bucket{%s%sle=\"%g\"} %llu\n",
+				name, labels, sep, LatencyHistogram::BOUNDS_MS[i] / 1000.0, (unsigned long long)cumulative);
+		}
+		else {
+			snprintf(line, sizeof(line), "%s_bucket{%s%sle=\"+Inf\"} %llu\n",
+				name, labels, sep, (unsigned long long)cumulative);
+		}
+		out += line;
+	}
+	snprintf(line, sizeof(line), "%s_sum{%s} %.6f\n%s_count{%s} %llu\n",
+		name, labels, h.sumMs() / 1000.0,
+		name, labels, (unsigned long long)cumulative);
+	out += line;
+}
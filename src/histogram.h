@@ -0,0 +1,29 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <stdint.h>
+
+// lock free latency histogram with fixed buckets, safe to fill from any thread and read from another
+struct LatencyHistogram {
+	static const int N_BUCKETS = 14;
+	// bucket upper bounds in milliseconds, last implicit bucket is +Inf
+	static const double BOUNDS_MS[N_BUCKETS];
+
+	LatencyHistogram();
+	void add(double ms);
+	uint64_t count() const;
+	double sumMs() const;
+	// approximate percentile (0..1), upper bound of the bucket holding it
+	double percentileMs(double p) const;
+
+	std::atomic<uint64_t> buckets[N_BUCKETS + 1];
+	std::atomic<uint64_t> sumUs;
+};
+
+// appends histogram in prometheus text format, labels ex: pool="0"
+void formatPrometheusHistogram(
+	std::string& out,
+	const char* name,
+	const char* labels,
+	const LatencyHistogram& h);
@@ -0,0 +1,287 @@
+#include "httpServer.h"
+#include "log.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET socket_t;
+#define closeSocket closesocket
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+typedef int socket_t;
+#define INVALID_SOCKET (-1)
+#define closeSocket close
+#endif
+
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <cstring>
+#include <ctype.h>
+#include <stdlib.h>
+
+// never get killed by SIGPIPE when a client closes the connection early
+#if defined(MSG_NOSIGNAL)
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+const size_t MAX_REQUEST_SIZE = 64 * 1024;
+const int ACCEPT_POLL_MS = 200;
+const int RECV_TIMEOUT_MS = 2000;
+
+struct HttpServer {
+	socket_t listenSocket;
+	std::thread* pThread;
+	std::atomic<bool> run;
+	bool threadPerConnection;
+	std::atomic<int> nConnections; // served on their own thread
+	HttpHandler handler;
+	std::string logPrefix;
+};
+
+static const char* statusText(int status) {
+	switch (status) {
+		case 200: return "OK";
+		case 400: return "Bad Request";
+		case 403: return "Forbidden";
+		case 404: return "Not Found";
+		case 405: return "Method Not Allowed";
+		case 415: return "Unsupported Media Type";
+		case 500: return "Internal Server Error";
+		case 503: return "Service Unavailable";
+	}
+	return "Unknown";
+}
+
+static void setRecvTimeout(socket_t s, int ms) {
+#ifdef _WIN32
+	DWORD tv = ms;
+	setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof(tv));
+#else
+	struct timeval tv;
+	tv.tv_sec = ms / 1000;
+	tv.tv_usec = (ms % 1000) * 1000;
+	setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof(tv));
+#endif
+}
+
+static bool sendAll(socket_t s, const std::string& data) {
+	size_t sent = 0;
+	while (sent < data.size()) {
+		int n = send(s, data.data() + sent, (int)(data.size() - sent), SEND_FLAGS);
+		if (n <= 0) {
+			return false;
+		}
+		sent += n;
+	}
+	return true;
+}
+
+// reads headers + body (Content-Length), returns false on malformed / too big request
+static bool readRequest(socket_t s, HttpRequest& req) {
+	std::string data;
+	char buf[4096];
+	size_t headerEnd = std::string::npos;
+	size_t contentLength = 0;
+
+	while (true) {
+		int n = recv(s, buf, sizeof(buf), 0);
+		if (n <= 0) {
+			return false;
+		}
+		data.append(buf, n);
+		if (data.size() > MAX_REQUEST_SIZE) {
+			return false;
+		}
+
+		if (headerEnd == std::string::npos) {
+			headerEnd = data.find("\r\n\r\n");
+			if (headerEnd == std::string::npos) {
+				continue;
+			}
+
+			// request line
+			size_t lineEnd = data.find("\r\n");
+			std::string line = data.substr(0, lineEnd);
+			size_t sp1 = line.find(' ');
+			size_t sp2 = line.find(' ', sp1 + 1);
+			if (sp1 == std::string::npos || sp2 == std::string::npos) {
+				return false;
+			}
+			req.method = line.substr(0, sp1);
+			req.path = line.substr(sp1 + 1, sp2 - sp1 - 1);
+
+			// content length, type & host (case insensitive header names), type without its parameters
+			std::string headers = data.substr(lineEnd, headerEnd - lineEnd);
+			for (auto &c : headers) {
+				c = (char)tolower(c);
+			}
+			const char* CONTENT_LENGTH = "\r\ncontent-length:";
+			size_t cl = headers.find(CONTENT_LENGTH);
+			if (cl != std::string::npos) {
+				contentLength = strtoul(headers.c_str() + cl + strlen(CONTENT_LENGTH), nullptr, 10);
+			}
+			if (contentLength > MAX_REQUEST_SIZE) {
+				return false;
+			}
+			const char* CONTENT_TYPE = "\r\ncontent-type:";
+			size_t ct = headers.find(CONTENT_TYPE);
+			if (ct != std::string::npos) {
+				ct = headers.find_first_not_of(" \t", ct + strlen(CONTENT_TYPE));
+				size_t ctEnd = headers.find_first_of(" \t\r;", ct);
+				if (ct != std::string::npos) {
+					req.contentType = headers.substr(ct, ctEnd == std::string::npos ? std::string::npos : ctEnd - ct);
+				}
+			}
+			const char* HOST = "\r\nhost:";
+			size_t h = headers.find(HOST);
+			if (h != std::string::npos) {
+				h = headers.find_first_not_of(" \t", h + strlen(HOST));
+				size_t hEnd = headers.find_first_of(" \t\r", h);
+				if (h != std::string::npos) {
+					req.host = headers.substr(h, hEnd == std::string::npos ? std::string::npos : hEnd - h);
+				}
+			}
+		}
+
+		if (data.size() >= headerEnd + 4 + contentLength) {
+			req.body = data.substr(headerEnd + 4, contentLength);
+			return true;
+		}
+	}
+}
+
+static void serveConnection(HttpServer* server, socket_t s) {
+	setRecvTimeout(s, RECV_TIMEOUT_MS);
+#if defined(SO_NOSIGPIPE)
+	int noSigPipe = 1;
+	setsockopt(s, SOL_SOCKET, SO_NOSIGPIPE, (const char*)&noSigPipe, sizeof(noSigPipe));
+#endif
+
+	HttpRequest req;
+	HttpResponse resp;
+	if (!readRequest(s, req)) {
+		resp.status = 400;
+		resp.body = "bad request\n";
+	}
+	else {
+		server->handler(req, resp);
+	}
+	if (resp.drop) {
+		return;
+	}
+
+	char header[256];
+	snprintf(header, sizeof(header),
+		"HTTP/1.1 %d %s\r\n"
+		"Content-Type: %s\r\n"
+		"Content-Length: %lu\r\n"
+		"Connection: close\r\n\r\n",
+		resp.status, statusText(resp.status),
+		resp.contentType.c_str(),
+		(unsigned long)resp.body.size());
+	if (sendAll(s, header)) {
+		sendAll(s, resp.body);
+	}
+}
+
+static void serverThreadFn(HttpServer* server) {
+	while (server->run) {
+		// poll so that stopHttpServer() does not need to close the socket under our feet
+		fd_set readSet;
+		FD_ZERO(&readSet);
+		FD_SET(server->listenSocket, &readSet);
+		struct timeval tv;
+		tv.tv_sec = 0;
+		tv.tv_usec = ACCEPT_POLL_MS * 1000;
+		int ready = select((int)server->listenSocket + 1, &readSet, nullptr, nullptr, &tv);
+		if (ready <= 0) {
+			continue;
+		}
+
+		socket_t s = accept(server->listenSocket, nullptr, nullptr);
+		if (s == INVALID_SOCKET) {
+			continue;
+		}
+		if (server->threadPerConnection) {
+			server->nConnections++;
+			std::thread([server, s] {
+				serveConnection(server, s);
+				closeSocket(s);
+				server->nConnections--;
+			}).detach();
+			continue;
+		}
+		serveConnection(server, s);
+		closeSocket(s);
+	}
+}
+
+http_server_handle_t startHttpServer(
+	const char* logPrefix,
+	uint16_t port,
+	bool loopbackOnly,
+	HttpHandler handler,
+	bool threadPerConnection)
+{
+#ifdef _WIN32
+	WSADATA wsaData;
+	WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+
+	socket_t s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (s == INVALID_SOCKET) {
+		logLine(logPrefix, "Error: cannot create socket");
+		return nullptr;
+	}
+
+	int reuse = 1;
+	setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(loopbackOnly ? INADDR_LOOPBACK : INADDR_ANY);
+	if (bind(s, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(s, threadPerConnection ? SOMAXCONN : 16) != 0) {
+		logLine(logPrefix, "Error: cannot listen on port %u", (unsigned int)port);
+		closeSocket(s);
+		return nullptr;
+	}
+
+	HttpServer* server = new HttpServer();
+	server->listenSocket = s;
+	server->handler = handler;
+	server->threadPerConnection = threadPerConnection;
+	server->nConnections = 0;
+	server->logPrefix = logPrefix;
+	server->run = true;
+	server->pThread = new std::thread(serverThreadFn, server);
+
+	logLine(logPrefix, "Listening on %s:%u",
+		loopbackOnly ? "127.0.0.1" : "0.0.0.0", (unsigned int)port);
+	return (http_server_handle_t)server;
+}
+
+void stopHttpServer(http_server_handle_t h) {
+	HttpServer* server = (HttpServer*)h;
+	if (!server) {
+		return;
+	}
+	server->run = false;
+	server->pThread->join();
+	delete server->pThread;
+	// connection threads use the server & its handler
+	while (server->nConnections > 0) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	closeSocket(server->listenSocket);
+	delete server;
+}
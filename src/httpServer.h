@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <functional>
+#include <stdint.h>
+
+// minimal HTTP/1.1 server: one background thread, one request per connection (Connection: close)
+// meant for small local endpoints (metrics, control, mock pool), not for heavy traffic
+
+struct HttpRequest {
+	std::string method;
+	std::string path;
+	std::string contentType; // lower case, empty if not sent
+	std::string host;        // Host header, lower case, empty if not sent
+	std::string body;
+};
+
+struct HttpResponse {
+	int status = 200;
+	std::string contentType = "text/plain";
+	std::string body;
+	bool drop = false; // close the connection without answering (fault injection)
+};
+
+typedef std::function<void(const HttpRequest&, HttpResponse&)> HttpHandler;
+typedef void* http_server_handle_t;
+
+// returns nullptr if the port cannot be bound
+// threadPerConnection: slow handlers do not hold other clients back, the handler must be thread safe
+http_server_handle_t startHttpServer(
+	const char* logPrefix,
+	uint16_t port,
+	bool loopbackOnly,
+	HttpHandler handler,
+	bool threadPerConnection = false);
+void stopHttpServer(http_server_handle_t h);
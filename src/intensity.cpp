@@ -0,0 +1,136 @@
+#include "intensity.h"
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+
+// sleep once the bucket owes this much time, so threads hash in batches instead of waking every hash
+const double THROTTLE_QUANTUM_S = 0.010;
+// a single sleep is capped so stop / pause / intensity changes are seen quickly
+const double MAX_THROTTLE_SLEEP_S = 0.100;
+// tokens saved while idle (pause, no work) can not exceed this much time
+const double MAX_BURST_S = 0.050;
+
+static std::atomic<int> s_mode(INTENSITY_OFF);
+static std::atomic<uint64_t> s_valueMilli(0);
+static std::atomic<uint32_t> s_generation(0);
+
+struct IntensityBucket {
+	uint32_t generation = 0;
+	double tokens = 0;
+	std::chrono::steady_clock::time_point tLast;
+};
+static thread_local IntensityBucket t_bucket;
+
+bool parseIntensity(const std::string& s, Intensity& intensity) {
+	if (s == "off" || s == "100%") {
+		intensity.mode = INTENSITY_OFF;
+		intensity.value = 0;
+		return true;
+	}
+	char* end;
+	double v = strtod(s.c_str(), &end);
+	if (end == s.c_str() || v <= 0) {
+		return false;
+	}
+	if (*end == '%') {
+		if (v > 100 || end[1] != 0) {
+			return false;
+		}
+		intensity.mode = INTENSITY_DUTY;
+		intensity.value = v / 100.0;
+		return true;
+	}
+	if (*end == 'k' || *end == 'K') {
+		v *= 1e3;
+		end++;
+	}
+	else if (*end == 'm' || *end == 'M') {
+		v *= 1e6;
+		end++;
+	}
+	if (*end != 0) {
+		return false;
+	}
+	intensity.mode = INTENSITY_RATE;
+	intensity.value = v;
+	return true;
+}
+
+std::string formatIntensity(const Intensity& intensity) {
+	char buf[64];
+	switch (intensity.mode) {
+		case INTENSITY_DUTY:
+			snprintf(buf, sizeof(buf), "%.1f%% cpu", intensity.value * 100.0);
+			break;
+		case INTENSITY_RATE:
+			snprintf(buf, sizeof(buf), "%.3f kH/s", intensity.value / 1000.0);
+			break;
+		default:
+			snprintf(buf, sizeof(buf), "off");
+			break;
+	}
+	return buf;
+}
+
+void setIntensity(const Intensity& intensity) {
+	s_valueMilli = (uint64_t)(intensity.value * 1000.0);
+	s_mode = intensity.mode;
+	s_generation++;
+}
+
+Intensity currentIntensity() {
+	Intensity intensity;
+	intensity.mode = (IntensityMode)s_mode.load();
+	intensity.value = s_valueMilli.load() / 1000.0;
+	return intensity;
+}
+
+// tokens per second for this thread: hashes (rate) or hashing seconds (duty)
+static double threadFillRate(IntensityMode mode, int nActiveThreads) {
+	double value = s_valueMilli.load(std::memory_order_relaxed) / 1000.0;
+	if (mode == INTENSITY_RATE) {
+		return value / std::max(1, nActiveThreads);
+	}
+	return value;
+}
+
+bool intensityThrottle(int nActiveThreads) {
+	IntensityMode mode = (IntensityMode)s_mode.load(std::memory_order_relaxed);
+	if (mode == INTENSITY_OFF) {
+		return false;
+	}
+
+	IntensityBucket& b = t_bucket;
+	auto tNow = std::chrono::steady_clock::now();
+	uint32_t generation = s_generation.load(std::memory_order_relaxed);
+	if (b.generation != generation) {
+		b.generation = generation;
+		b.tokens = 0;
+		b.tLast = tNow;
+	}
+
+	double rate = threadFillRate(mode, nActiveThreads);
+	double elapsedS = std::chrono::duration<double>(tNow - b.tLast).count();
+	b.tLast = tNow;
+	b.tokens = std::min(b.tokens + rate * elapsedS, rate * MAX_BURST_S);
+	if (b.tokens >= -rate * THROTTLE_QUANTUM_S || rate <= 0) {
+		return false;
+	}
+
+	// sleep off the debt, refilled by the next call from the measured elapsed time
+	double sleepS = std::min(-b.tokens / rate, MAX_THROTTLE_SLEEP_S);
+	std::this_thread::sleep_for(std::chrono::microseconds((int64_t)(sleepS * 1e6)));
+	return true;
+}
+
+void intensityRecordHash(uint32_t hashUs) {
+	IntensityMode mode = (IntensityMode)s_mode.load(std::memory_order_relaxed);
+	if (mode == INTENSITY_OFF) {
+		return;
+	}
+	t_bucket.tokens -= (mode == INTENSITY_RATE) ? 1.0 : hashUs / 1e6;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <stdint.h>
+
+// throughput cap (--intensity, control API setIntensity) without changing the thread count
+// each miner thread runs a token bucket: hashes (rate mode) or hashing time (duty mode) consume tokens,
+// refilled at the thread share of the target, the thread sleeps in coarse quanta once in debt
+
+enum IntensityMode {
+	INTENSITY_OFF,
+	INTENSITY_DUTY, // value: share of time hashing, 0..1
+	INTENSITY_RATE  // value: total hashes per second
+};
+
+struct Intensity {
+	IntensityMode mode = INTENSITY_OFF;
+	double value = 0;
+};
+
+// "off", "50%" (duty), "1500" / "1.5k" / "2m" (H/s)
+bool parseIntensity(const std::string& s, Intensity& intensity);
+std::string formatIntensity(const Intensity& intensity);
+
+// can be changed while mining, miner threads pick it up on their next hash
+void setIntensity(const Intensity& intensity);
+Intensity currentIntensity();
+
+// miner thread side, before each hash: true if the thread slept & must check its run flags again
+bool intensityThrottle(int nActiveThreads);
+// after each hash
+void intensityRecordHash(uint32_t hashUs);
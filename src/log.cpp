@@ -3,13 +3,275 @@
 #include <iostream>
 #include <stdio.h>
 #include <time.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <chrono>
 
 #include "log.h"
 
+// lines longer than this are truncated (same limit as the synchronous path)
+const size_t LOG_LINE_MAX = 2048;
+const size_t LOG_PREFIX_MAX = 16;
+// per thread ring slots, a ring is only allocated for threads that actually log
+const uint32_t LOG_RING_SLOTS = 16;
+const uint32_t LOGGER_POLL_MS = 10;
+// producer poll while its ring is full (threads that do not drop)
+const uint32_t LOG_FULL_WAIT_MS = 1;
+// rotated files: path.1 (newest) .. path.N
+const int LOG_ROTATE_KEEP = 5;
+
+struct LogEntry {
+	uint64_t seq; // global order between rings
+	time_t time;
+	char prefix[LOG_PREFIX_MAX];
+	char msg[LOG_LINE_MAX];
+};
+
+// single producer (owning thread) / single consumer (logger thread)
+// a ring is handed to another thread when its owner exits, so short lived submit threads reuse rings
+struct LogRing {
+	LogRing() : head(0), tail(0), dropped(0), owned(false) {}
+	LogEntry entries[LOG_RING_SLOTS];
+	std::atomic<uint32_t> head; // written by producer
+	std::atomic<uint32_t> tail; // written by consumer
+	std::atomic<uint32_t> dropped;
+	std::atomic<bool> owned;
+};
+
+static std::atomic<bool> s_loggerRunning(false);
+static std::atomic<uint64_t> s_logSeq(0);
+static std::mutex s_rings_mutex; // ring registration only, never taken to log a line
+static std::vector<LogRing*> s_rings;
+static std::thread* s_pLoggerThread = nullptr;
+static LogConfig s_logCfg;
+
+// logger thread state
+static FILE* s_logFile = nullptr;
+static uint64_t s_logFileBytes = 0;
+static time_t s_logFileOpenTime = 0;
+static time_t s_cachedSecond = -1;
+static char s_cachedTime[80] = { 0 };
+
+// releases the ring of the current thread on thread exit
+struct LogRingOwner {
+	LogRing* pRing = nullptr;
+	~LogRingOwner() {
+		if (pRing) {
+			pRing->owned = false;
+		}
+	}
+};
+thread_local LogRingOwner t_logRing;
+thread_local bool t_logDropWhenFull = false;
+
+void setLogDropWhenFull(bool drop) {
+	t_logDropWhenFull = drop;
+}
+
+static LogRing* currentThreadRing() {
+	if (t_logRing.pRing) {
+		return t_logRing.pRing;
+	}
+	std::lock_guard<std::mutex> lock(s_rings_mutex);
+	for (auto pRing : s_rings) {
+		if (!pRing->owned) {
+			pRing->owned = true;
+			t_logRing.pRing = pRing;
+			return pRing;
+		}
+	}
+	LogRing* pRing = new LogRing();
+	pRing->owned = true;
+	s_rings.push_back(pRing);
+	t_logRing.pRing = pRing;
+	return pRing;
+}
+
+// time string only formatted once per second
+static const char* formatTime(time_t t) {
+	if (t != s_cachedSecond) {
+		struct tm tstruct = *localtime(&t);
+		strftime(s_cachedTime, sizeof(s_cachedTime), "%y-%m-%d %X", &tstruct);
+		s_cachedSecond = t;
+	}
+	return s_cachedTime;
+}
+
+static void openLogFile() {
+	s_logFile = fopen(s_logCfg.filePath.c_str(), "a");
+	s_logFileBytes = 0;
+	s_logFileOpenTime = time(0);
+	if (s_logFile) {
+		fseek(s_logFile, 0, SEEK_END);
+		long pos = ftell(s_logFile);
+		s_logFileBytes = pos > 0 ? (uint64_t)pos : 0;
+	}
+}
+
+static void rotateLogFile() {
+	fclose(s_logFile);
+	s_logFile = nullptr;
+	const std::string& path = s_logCfg.filePath;
+	remove((path + "." + std::to_string(LOG_ROTATE_KEEP)).c_str());
+	for (int i = LOG_ROTATE_KEEP - 1; i >= 1; i--) {
+		rename((path + "." + std::to_string(i)).c_str(), (path + "." + std::to_string(i + 1)).c_str());
+	}
+	rename(path.c_str(), (path + ".1").c_str());
+	openLogFile();
+}
+
+static void writeLine(const char* prefix, time_t t, const char* msg) {
+	const char* bufTime = formatTime(t);
+	printf("[%s %s] %s\n", prefix, bufTime, msg);
+
+	if (s_logFile) {
+		int n = fprintf(s_logFile, "[%s %s] %s\n", prefix, bufTime, msg);
+		if (n > 0) {
+			s_logFileBytes += n;
+		}
+		bool tooBig = s_logCfg.rotateBytes > 0 && s_logFileBytes >= s_logCfg.rotateBytes;
+		bool tooOld = s_logCfg.rotateSeconds > 0 && (t - s_logFileOpenTime) >= (time_t)s_logCfg.rotateSeconds;
+		if (tooBig || tooOld) {
+			rotateLogFile();
+		}
+	}
+}
+
+// drains all rings, returns number of lines written
+static size_t drainRings(std::vector<LogEntry*>& pending) {
+	pending.clear();
+	std::vector<std::pair<LogRing*, uint32_t>> consumed;
+	uint32_t dropped = 0;
+	{
+		std::lock_guard<std::mutex> lock(s_rings_mutex);
+		for (auto pRing : s_rings) {
+			uint32_t tail = pRing->tail.load(std::memory_order_relaxed);
+			uint32_t head = pRing->head.load(std::memory_order_acquire);
+			for (uint32_t i = tail; i != head; i++) {
+				pending.push_back(&pRing->entries[i % LOG_RING_SLOTS]);
+			}
+			consumed.push_back({ pRing, head });
+			dropped += pRing->dropped.exchange(0, std::memory_order_relaxed);
+		}
+	}
+
+	// restore the global order of lines logged by different threads
+	std::sort(pending.begin(), pending.end(), [](const LogEntry* a, const LogEntry* b) {
+		return a->seq < b->seq;
+	});
+	for (auto pEntry : pending) {
+		writeLine(pEntry->prefix, pEntry->time, pEntry->msg);
+	}
+	if (dropped > 0) {
+		char msg[64];
+		snprintf(msg, sizeof(msg), "%u log lines dropped (log buffer full)", dropped);
+		writeLine("LOG", time(0), msg);
+	}
+
+	// give slots back to producers only once written
+	for (auto &it : consumed) {
+		it.first->tail.store(it.second, std::memory_order_release);
+	}
+
+	if (pending.size() > 0 || dropped > 0) {
+		fflush(stdout);
+		if (s_logFile) {
+			fflush(s_logFile);
+		}
+	}
+	return pending.size();
+}
+
+static void loggerThreadFn() {
+	std::vector<LogEntry*> pending;
+	while (s_loggerRunning) {
+		if (drainRings(pending) == 0) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(LOGGER_POLL_MS));
+		}
+	}
+	drainRings(pending);
+}
+
+bool startLogger(const LogConfig& cfg) {
+	if (s_pLoggerThread) {
+		return true;
+	}
+	s_logCfg = cfg;
+	if (cfg.filePath.size() > 0) {
+		openLogFile();
+		if (!s_logFile) {
+			logLine("LOG", "Error: cannot open log file %s", cfg.filePath.c_str());
+			return false;
+		}
+	}
+	s_loggerRunning = true;
+	s_pLoggerThread = new std::thread(loggerThreadFn);
+	return true;
+}
+
+void stopLogger() {
+	if (!s_pLoggerThread) {
+		return;
+	}
+	s_loggerRunning = false;
+	s_pLoggerThread->join();
+	delete s_pLoggerThread;
+	s_pLoggerThread = nullptr;
+	// lines pushed while the logger thread was exiting
+	std::vector<LogEntry*> pending;
+	drainRings(pending);
+	if (s_logFile) {
+		fclose(s_logFile);
+		s_logFile = nullptr;
+	}
+}
+
+bool parseLogRotate(const std::string& s, LogConfig& cfg) {
+	char* end = nullptr;
+	unsigned long long v = strtoull(s.c_str(), &end, 10);
+	if (end == s.c_str() || v == 0 || strlen(end) != 1) {
+		return false;
+	}
+	switch (*end) {
+		case 'k': cfg.rotateBytes = v * 1024ULL; return true;
+		case 'm': cfg.rotateBytes = v * 1024ULL * 1024ULL; return true;
+		case 'h': cfg.rotateSeconds = (uint32_t)(v * 3600ULL); return true;
+		case 'd': cfg.rotateSeconds = (uint32_t)(v * 24ULL * 3600ULL); return true;
+	}
+	return false;
+}
+
 void logLine(const char* prefix, const char* fmt, va_list args)
 {
-	char tmp[2048];
-	vsnprintf(tmp, 2048, fmt, args);
+	if (s_loggerRunning) {
+		LogRing* pRing = currentThreadRing();
+		uint32_t head = pRing->head.load(std::memory_order_relaxed);
+		uint32_t tail = pRing->tail.load(std::memory_order_acquire);
+		while (head - tail >= LOG_RING_SLOTS && !t_logDropWhenFull && s_loggerRunning) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(LOG_FULL_WAIT_MS));
+			tail = pRing->tail.load(std::memory_order_acquire);
+		}
+		if (head - tail >= LOG_RING_SLOTS) {
+			// never block miner threads, the logger thread reports the loss
+			pRing->dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		LogEntry& entry = pRing->entries[head % LOG_RING_SLOTS];
+		vsnprintf(entry.msg, sizeof(entry.msg), fmt, args);
+		snprintf(entry.prefix, sizeof(entry.prefix), "%s", prefix);
+		entry.time = time(0);
+		entry.seq = s_logSeq.fetch_add(1, std::memory_order_relaxed);
+		pRing->head.store(head + 1, std::memory_order_release);
+		return;
+	}
+
+	char tmp[LOG_LINE_MAX];
+	vsnprintf(tmp, LOG_LINE_MAX, fmt, args);
 
 	time_t  now = time(0);
 	struct tm  tstruct;
@@ -1,6 +1,28 @@
 #pragma once
 
 #include <stdarg.h>
+#include <stdint.h>
+#include <string>
 
 void logLine(const char* prefix, const char* fmt, ...);
 void logLine(std::string prefix, const char* fmt, ...);
+
+// once started, logLine() only formats the message and pushes it to a per thread lock-free ring,
+// a logger thread adds timestamps and writes to stdout & the optional log file
+// before startLogger() / after stopLogger(), logLine() prints synchronously
+struct LogConfig {
+	std::string filePath;     // empty = stdout only
+	uint64_t rotateBytes = 0; // rotate log file when bigger, 0 = never
+	uint32_t rotateSeconds = 0; // rotate log file when older, 0 = never
+};
+
+bool startLogger(const LogConfig& cfg);
+// flushes pending lines
+void stopLogger();
+
+// hot path threads (miners) never wait on a full ring, their extra lines are dropped & counted,
+// other threads wait for the logger thread to make room
+void setLogDropWhenFull(bool drop);
+
+// "10m", "512k" => size rotation, "24h", "2d" => time rotation
+bool parseLogRotate(const std::string& s, LogConfig& cfg);
@@ -7,6 +7,20 @@
 #include "config.h"
 #include "kbhit.h"
 #include "getPwd.h"
+#include "metrics.h"
+#include "control.h"
+#include "trace.h"
+#include "profiler.h"
+#include "perfCounters.h"
+#include "shareStats.h"
+#include "watchdog.h"
+#include "shmStats.h"
+#include "topology.h"
+#include "background.h"
+#include "intensity.h"
+#include "autotune.h"
+#include "bench.h"
+#include "validator.h"
 #ifdef _MSC_VER
 #include "windows/procinfo_windows.h"
 #include "windows/win_tools.h"
@@ -27,6 +41,9 @@
 #include <stdint.h>
 #include <cstring>
 #include <stdio.h>
+#include <vector>
+#include <algorithm>
+#include <signal.h>
 
 #include <argon2.h>
 
@@ -49,8 +66,6 @@ const std::string ARGON_ARCH = "AVX";
 const std::string ARGON_ARCH = "";
 #endif
 
-#define ARGON_VALIDITY_CHECK (1)
-
 using std::chrono::high_resolution_clock;
 
 const char* COORDINATOR_LOG_PREFIX = "AQUA";
@@ -58,8 +73,14 @@ const std::string VERSION = "1.3.2";
 
 bool s_needKeyPressAtEnd = false;
 bool s_run = true;
+// startup timings (time to first hash)
+int64_t s_processStartUs = 0;
 std::string s_configDir;
 
+// set by SIGHUP, served by main loop
+static volatile sig_atomic_t s_reloadRequested = 0;
+static volatile sig_atomic_t s_traceDumpRequested = 0;
+
 std::string LOGO = ""
 "                              _           _       \n"
 "  __ _  __ _ _   _  __ _  ___| |__   __ _(_)_ __  \n"
@@ -76,6 +97,215 @@ void ctrlCHandler() {
 	}
 }
 
+#ifndef _MSC_VER
+void sighupHandler(int) {
+	s_reloadRequested = 1;
+}
+
+void sigusr1Handler(int) {
+	s_traceDumpRequested = 1;
+}
+#endif
+
+void serviceReloadRequest() {
+	if (!s_reloadRequested) {
+		return;
+	}
+	s_reloadRequested = 0;
+
+	std::string log;
+	if (!reloadConfig(COORDINATOR_LOG_PREFIX, log)) {
+		logLine(COORDINATOR_LOG_PREFIX, "Warning: configuration reload failed, keeping current config: %s", log.c_str());
+	}
+}
+
+void serviceTraceDumpRequest() {
+	if (!s_traceDumpRequested) {
+		return;
+	}
+	s_traceDumpRequested = 0;
+
+	std::string log;
+	if (!dumpTrace(s_configDir + TRACE_FILE_NAME, log)) {
+		logLine(COORDINATOR_LOG_PREFIX, "Warning: trace dump failed: %s", log.c_str());
+	}
+	else {
+		logLine(COORDINATOR_LOG_PREFIX, "Trace dump: %s", log.c_str());
+	}
+}
+
+// target vs achieved throughput when capped by --intensity
+void reportIntensity(double durationS, double hashesPerSecond, uint64_t hashUsSinceLast) {
+	Intensity target = currentIntensity();
+	if (target.mode == INTENSITY_RATE) {
+		logLine(COORDINATOR_LOG_PREFIX, "intensity: target %.3f kH/s, achieved %.3f kH/s (%.1f%%)",
+			target.value / 1000.0, hashesPerSecond / 1000.0, 100.0 * hashesPerSecond / target.value);
+	}
+	else if (target.mode == INTENSITY_DUTY) {
+		int nActive = std::max(1, activeMinerThreads());
+		double duty = (hashUsSinceLast / 1e6) / (durationS * nActive);
+		logLine(COORDINATOR_LOG_PREFIX, "intensity: target %.1f%% cpu, achieved %.1f%% (%d threads)",
+			target.value * 100.0, duty * 100.0, nActive);
+	}
+}
+
+// thread count sized from CPU limits (no -t, no --affinity), 0 otherwise
+static uint32_t s_cpuLimitsThreadCount = 0;
+
+void logCpuLimits(const CpuLimits& limits, int nThreads) {
+	char quota[32] = "none";
+	if (limits.quotaCpus > 0) {
+		snprintf(quota, sizeof(quota), "%.2f cpus", limits.quotaCpus);
+	}
+	logLine(COORDINATOR_LOG_PREFIX, "CPU limits: %d allowed cpus, cpuset %d, quota %s -> %d threads",
+		limits.allowedCpus, limits.cpusetCpus, quota, nThreads);
+}
+
+// containers can get a new cpu quota / cpuset while mining, auto sized thread pools follow it
+void resizeToCpuLimits() {
+	if (s_cpuLimitsThreadCount == 0) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(miningConfigUpdateMutex());
+	// thread count was set through the control API or a config reload, not ours anymore
+	if (miningConfig().nThreads != s_cpuLimitsThreadCount) {
+		s_cpuLimitsThreadCount = 0;
+		return;
+	}
+	CpuLimits limits = readCpuLimits();
+	int n = std::min(cpuLimitsThreadCount(limits), MAX_MINER_THREADS);
+	if (n == (int)s_cpuLimitsThreadCount || !setMinerThreadCount(n)) {
+		return;
+	}
+	logCpuLimits(limits, n);
+	MiningConfig cfg = miningConfig();
+	cfg.nThreads = (uint32_t)n;
+	setMiningConfig(cfg);
+	s_cpuLimitsThreadCount = (uint32_t)n;
+}
+
+// hash version used when no work arrived before the autotune wait expires
+const int AUTOTUNE_DEFAULT_HASH_VERSION = 4;
+const int64_t AUTOTUNE_WORK_WAIT_MS = 10000;
+
+// --autotune: profile of this cpu / build / hash version from tuning.cfg, benchmarked if missing,
+// applied to the settings left to auto detection (no -t, no --affinity)
+void applyAutotune() {
+	int64_t tStart = steadyNowMs();
+	while (s_run && getPoolStatus(0).workVersion < 0 && steadyNowMs() - tStart < AUTOTUNE_WORK_WAIT_MS) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+	if (!s_run) {
+		return;
+	}
+	int hashVersion = getPoolStatus(0).workVersion;
+	if (hashVersion < 0) {
+		hashVersion = AUTOTUNE_DEFAULT_HASH_VERSION;
+		logLine(COORDINATOR_LOG_PREFIX, "Autotune: no work yet, tuning for hash version %d", hashVersion);
+	}
+
+	// the key only records the visible cpus, a lowered container quota must not reuse a bigger count
+#ifdef _MSC_VER
+	int maxThreads = std::min((int)nLogicalCores(), MAX_MINER_THREADS);
+#else
+	int maxThreads = std::min(cpuLimitsThreadCount(readCpuLimits()), MAX_MINER_THREADS);
+#endif
+
+	const std::string path = s_configDir + TUNING_FILE_NAME;
+	TuningProfile profile;
+	profile.key = tuningKey(VERSION, ARGON_ARCH, hashVersion);
+	if (loadTuningProfile(path, profile.key, profile)) {
+		logLine(COORDINATOR_LOG_PREFIX, "Autotune: profile loaded from %s", path.c_str());
+		if (profile.nThreads <= 0) {
+			logLine(COORDINATOR_LOG_PREFIX, "Warning: invalid thread count in %s, using defaults", path.c_str());
+			return;
+		}
+		if (profile.nThreads > maxThreads) {
+			logLine(COORDINATOR_LOG_PREFIX, "Autotune: profile has %d threads, limited to %d by cpu limits",
+				profile.nThreads, maxThreads);
+			profile.nThreads = maxThreads;
+		}
+	}
+	else {
+		std::string key = profile.key;
+		profile = runAutotune(COORDINATOR_LOG_PREFIX, hashVersion, maxThreads);
+		profile.key = key;
+		if (profile.nThreads <= 0) {
+			logLine(COORDINATOR_LOG_PREFIX, "Warning: autotune failed, using defaults");
+			return;
+		}
+		if (!saveTuningProfile(path, profile)) {
+			logLine(COORDINATOR_LOG_PREFIX, "Warning: cannot write %s", path.c_str());
+		}
+	}
+	logLine(COORDINATOR_LOG_PREFIX, "Autotune: %d threads, affinity %s (%.3f kH/s) for %s",
+		profile.nThreads, affinityPolicyName(profile.affinity), profile.hashesPerSecond / 1000.0, profile.key.c_str());
+
+	std::lock_guard<std::mutex> lock(miningConfigUpdateMutex());
+	MiningConfig cfg = miningConfig();
+	if (cfg.nThreads <= 0) {
+		cfg.nThreads = (uint32_t)profile.nThreads;
+	}
+	else {
+		logLine(COORDINATOR_LOG_PREFIX, "Autotune: thread count set by -t, keeping %u", cfg.nThreads);
+	}
+	if (cfg.affinity.policy == AFFINITY_NONE) {
+		cfg.affinity.policy = profile.affinity;
+	}
+	setMiningConfig(cfg);
+}
+
+// --bench: offline sweep, JSON report
+std::string runBenchMode() {
+	BenchSweep sweep = defaultBenchSweep();
+	if (miningConfig().nThreads > 0) {
+		sweep.threadCounts = { (int)miningConfig().nThreads };
+	}
+	sweep.cpus = affinityPlacement(miningConfig().affinity);
+	sweep.affinity = affinityPolicyName(miningConfig().affinity.policy);
+	sweep.minerVersion = VERSION;
+	sweep.kernel = ARGON_ARCH.size() ? ARGON_ARCH : std::string("SSE2");
+	logLine(COORDINATOR_LOG_PREFIX, "Bench: %d hash versions x %d thread counts, %.0fs each",
+		(int)sweep.versions.size(), (int)sweep.threadCounts.size(), (sweep.warmupMs + sweep.durationMs) / 1000.0);
+	return runBenchmarkSweep(COORDINATOR_LOG_PREFIX, sweep);
+}
+
+// to the --bench file, or stdout once the logger is stopped (report is the last line)
+bool writeBenchReport(const std::string& json) {
+	const std::string& path = miningConfig().benchOutput;
+	if (path.size() == 0) {
+		printf("%s\n", json.c_str());
+		return true;
+	}
+	FILE* f = fopen(path.c_str(), "w");
+	if (!f) {
+		logLine(COORDINATOR_LOG_PREFIX, "Error: cannot write %s", path.c_str());
+		return false;
+	}
+	fprintf(f, "%s\n", json.c_str());
+	fclose(f);
+	logLine(COORDINATOR_LOG_PREFIX, "Bench: report written to %s", path.c_str());
+	return true;
+}
+
+// p50 / p90 of the share & work lifecycle stages since start
+void reportLifecycleLatencies() {
+	const TraceEvent STAGES[] = { TRACE_GETWORK, TRACE_FIRST_HASH, TRACE_SUBMIT_QUEUE, TRACE_SUBMIT };
+	char line[512] = { 0 };
+	size_t n = 0;
+	for (auto ev : STAGES) {
+		const auto& h = traceLatency(ev);
+		if (h.count() == 0) {
+			continue;
+		}
+		n += snprintf(line + n, sizeof(line) - n, " | %s %.0f/%.0f (%lu)",
+			traceEventName(ev), h.percentileMs(0.5), h.percentileMs(0.9), (unsigned long)h.count());
+	}
+	if (n > 0) {
+		logLine(COORDINATOR_LOG_PREFIX, "latency ms p50/p90%s", line);
+	}
+}
+
 void initConfigurationFile() {
 	std::string confLog;
 	if (!createConfigFile(confLog)) {
@@ -126,7 +356,49 @@ void printOptimizationsInfo() {
 	}
 }
 
+// full per thread list every PER_THREAD_REPORT_EVERY reports, min/median/max otherwise
+const uint32_t PER_THREAD_REPORT_EVERY = 6;
+const int PER_THREAD_REPORT_PER_LINE = 8;
+
+void reportThreadHashRates(std::vector<uint64_t>& threadHashesLast, double durationS, bool full) {
+	// never shrink: counters of retired threads continue if their id is reused
+	int nThreads = nMinerThreads();
+	if ((int)threadHashesLast.size() < nThreads) {
+		threadHashesLast.resize(nThreads, 0);
+	}
+
+	std::vector<double> khs(nThreads);
+	for (int i = 0; i < nThreads; i++) {
+		uint64_t n = getThreadHashes(i);
+		khs[i] = (double)(n - threadHashesLast[i]) / durationS / 1000.0;
+		threadHashesLast[i] = n;
+		setMetricsThreadHashRate(i, khs[i] * 1000.0);
+	}
+	if (nThreads == 0) {
+		return;
+	}
+
+	std::vector<double> sorted = khs;
+	std::sort(sorted.begin(), sorted.end());
+	int slowest = (int)(std::min_element(khs.begin(), khs.end()) - khs.begin());
+	logLine(COORDINATOR_LOG_PREFIX, "per thread kH/s | min=%.3f (MN%02d) | median=%.3f | max=%.3f",
+		sorted.front(), slowest, sorted[nThreads / 2], sorted.back());
+
+	if (!full) {
+		return;
+	}
+	for (int i = 0; i < nThreads; i += PER_THREAD_REPORT_PER_LINE) {
+		char line[512] = { 0 };
+		size_t n = 0;
+		for (int k = i; k < std::min(i + PER_THREAD_REPORT_PER_LINE, nThreads); k++) {
+			n += snprintf(line + n, sizeof(line) - n, "MN%02d %6.3f  ", k, khs[k]);
+		}
+		logLine(COORDINATOR_LOG_PREFIX, "  %s", line);
+	}
+}
+
 int main(int argc, char** argv) {
+	s_processStartUs = traceNowUs();
 	s_configDir = getPwd(argv);
 
 #ifdef _MSC_VER
@@ -194,6 +466,8 @@ int main(int argc, char** argv) {
 	// show number of processors detected
 #ifdef _MSC_VER
 	logLine(COORDINATOR_LOG_PREFIX, "%s", procInfoLog.c_str());
+#else
+	logTopology(COORDINATOR_LOG_PREFIX);
 #endif
 
 	// handle commandline parameters (may change mining config)
@@ -202,31 +476,75 @@ int main(int argc, char** argv) {
 		return 0;
 	}
 
+	// from now on log lines are written by the logger thread, never by miner / submit threads
+	if (!startLogger(miningConfig().log)) {
+		return 1;
+	}
+
+	// offline benchmark, no network
+	if (miningConfig().bench) {
+		std::string json = runBenchMode();
+		stopLogger();
+		return writeBenchReport(json) ? 0 : 1;
+	}
+
 	// Ctrl+C handler
 #ifdef _MSC_VER
 	if (!setCtrlCHandler(ctrlCHandler)) {
 		logLine(COORDINATOR_LOG_PREFIX, "Error: Could not set ctrl+c handler, aborting");
+		stopLogger();
 		return 1;
 	}
 #endif
 
-	// create & launch update thread
+	// SIGHUP reloads config.cfg without stopping miner threads
+	setReloadArgs(argc, argv);
+#ifndef _MSC_VER
+	signal(SIGHUP, sighupHandler);
+	// SIGUSR1 dumps the lifecycle trace (chrome://tracing JSON)
+	signal(SIGUSR1, sigusr1Handler);
+#endif
+
+	// create & launch update thread, miner threads get ready while the first getWork is in flight
 	startUpdateThread();
 
+	// throughput cap, can be changed later through the control API
+	setIntensity(miningConfig().intensity);
+
+	// tuned thread count & placement, before the defaults below
+	if (miningConfig().autotune) {
+		applyAutotune();
+	}
+
+	// miner thread -> CPU placement, before any miner thread starts
+	initAffinity(miningConfig().affinity);
+
 	// auto detect number of threads if not specified
 	if (miningConfig().nThreads <= 0) {
 		MiningConfig newCfg = miningConfig();
+		if (affinityThreadCount() > 0) {
+			newCfg.nThreads = (uint32_t)std::min(affinityThreadCount(), MAX_MINER_THREADS);
+		}
+		else {
 #ifdef _MSC_VER
-		newCfg.nThreads = nLogicalCores();
+			newCfg.nThreads = (uint32_t)std::min((int)nLogicalCores(), MAX_MINER_THREADS);
 #else
-		newCfg.nThreads = std::thread::hardware_concurrency();
+			// CPUs we are allowed to run on (taskset, cgroup cpuset & quota)
+			CpuLimits limits = readCpuLimits();
+			newCfg.nThreads = (uint32_t)std::min(cpuLimitsThreadCount(limits), MAX_MINER_THREADS);
+			s_cpuLimitsThreadCount = newCfg.nThreads;
+			logCpuLimits(limits, newCfg.nThreads);
 #endif
+		}
 		setMiningConfig(newCfg);
 	}
 
 	auto tMiningStart = high_resolution_clock::now();
 	auto tLast = tMiningStart;
-	uint32_t nHashesLast = 0;
+	uint64_t nHashesLast = 0;
+	uint64_t hashUsLast = 0;
+	std::vector<uint64_t> threadHashesLast;
+	uint32_t nReports = 0;
 	if (s_run) {
 		auto nThreads = miningConfig().nThreads;
 		logLine(COORDINATOR_LOG_PREFIX, "--- Start %s mining ---",
@@ -239,17 +557,58 @@ int main(int argc, char** argv) {
 			logLine(COORDINATOR_LOG_PREFIX, "node url : %s",
 				miningConfig().fullNodeUrl.c_str());
 		}
+		auto pools = miningConfig().pools;
+		for (size_t i = 1; i < pools.size(); i++) {
+			logLine(COORDINATOR_LOG_PREFIX, "pool %-3d : %s (weight %u)",
+				(int)i, pools[i].url.c_str(), pools[i].weight);
+		}
 		logLine(COORDINATOR_LOG_PREFIX, "nthreads : %d",
 			nThreads);
 		logLine(COORDINATOR_LOG_PREFIX, "refresh  : %2.1fs",
 			miningConfig().refreshRateMs / 1000.0f);
-		startMinerThreads(nThreads);
+		if (minerThreadCpu(0) >= 0) {
+			std::string cpus;
+			const int MAX_LOGGED_CPUS = 64;
+			for (int i = 0; i < (int)nThreads && i < MAX_LOGGED_CPUS; i++) {
+				cpus += std::to_string(minerThreadCpu(i)) + " ";
+			}
+			logLine(COORDINATOR_LOG_PREFIX, "cpus     : %s%s", cpus.c_str(), (int)nThreads > MAX_LOGGED_CPUS ? "..." : "");
+		}
+		startValidator(miningConfig().validateRate);
+		if (!startMinerThreads((int)nThreads)) {
+			logLine(COORDINATOR_LOG_PREFIX, "Error: cannot start %u miner threads (max %d)", nThreads, MAX_MINER_THREADS);
+			s_run = false;
+		}
+	}
+
+	// optional prometheus endpoint
+	if (miningConfig().metricsPort > 0) {
+		if (!startMetricsServer((uint16_t)miningConfig().metricsPort, VERSION)) {
+			logLine(COORDINATOR_LOG_PREFIX, "Warning: metrics server could not start");
+		}
+	}
+
+	// optional shared memory stats for local monitoring tools
+	if (miningConfig().shmStatsName.size() > 0) {
+		auto kernel = ARGON_ARCH.size() ? ARGON_ARCH : std::string("SSE2");
+		if (!startShmStats(miningConfig().shmStatsName, VERSION, kernel)) {
+			logLine(COORDINATOR_LOG_PREFIX, "Warning: shared memory stats disabled");
+		}
+	}
+
+	if (s_run) {
+		// optional local control API, once miner threads exist
+		if (miningConfig().controlPort > 0) {
+			if (!startControlServer((uint16_t)miningConfig().controlPort)) {
+				logLine(COORDINATOR_LOG_PREFIX, "Warning: control server could not start");
+			}
+		}
 	}
 
 	// run forever until CTRL+C hit
 	while (s_run) {
 		auto tNow = high_resolution_clock::now();
-		uint32_t nHashes = getTotalHashes();
+		uint64_t nHashes = getTotalHashes();
 		if (nHashes > 0) {
 			// hashes / time since last pass
 			std::chrono::duration<double> durationSinceLast = tNow - tLast;
@@ -267,6 +626,11 @@ int main(int argc, char** argv) {
 			auto nSharesAccepted = getTotalSharesAccepted();
 			auto nSharesRejected = nSharesSubmitted - nSharesAccepted;
 
+			setMetricsHashRate(hashesPerSecondSinceLast);
+			uint64_t hashUs = getTotalHashUs();
+			uint64_t hashUsSinceLast = hashUs - hashUsLast;
+			hashUsLast = hashUs;
+
 			double khs = hashesPerSecondSinceLast / 1000.0;
 			std::string formatStr;
 			formatStr = (khs >= 1.0) ? 
@@ -279,14 +643,57 @@ int main(int argc, char** argv) {
 				nSharesAccepted,
 				nSharesRejected,
 				(nSharesSubmitted == 0) ? 0. : (100. * ((double)nSharesRejected / (double)nSharesSubmitted)));
+
+			reportIntensity(durationSinceLast.count(), hashesPerSecondSinceLast, hashUsSinceLast);
+
+			// per thread hash rates, to spot slow cores or throttled sockets
+			bool fullReport = (nReports++ % PER_THREAD_REPORT_EVERY) == 0;
+			shareStatsTick();
+			watchdogTick(durationSinceLast.count());
+			reportThreadHashRates(threadHashesLast, durationSinceLast.count(), fullReport);
+			if (fullReport) {
+				resizeToCpuLimits();
+				reportShareStats(COORDINATOR_LOG_PREFIX);
+				reportLifecycleLatencies();
+				reportProfile(COORDINATOR_LOG_PREFIX);
+				if (miningConfig().perfCounters) {
+					reportPerfCounters(COORDINATOR_LOG_PREFIX);
+				}
+			}
+
+			// per pool stats when splitting threads between pools
+			auto nPools = miningConfig().pools.size();
+			for (int i = 0; nPools > 1 && i < (int)nPools; i++) {
+				auto nPoolSubmitted = getPoolSharesSubmitted(i);
+				auto nPoolAccepted = getPoolSharesAccepted(i);
+				auto nPoolRejected = nPoolSubmitted - nPoolAccepted;
+				logLine(COORDINATOR_LOG_PREFIX, "  pool %d | %d threads | Shares=%5lu | Rejected=%5lu (%4.1f%%)",
+					i,
+					nMinerThreadsOnPool(i),
+					(unsigned long)nPoolAccepted,
+					(unsigned long)nPoolRejected,
+					(nPoolSubmitted == 0) ? 0. : (100. * ((double)nPoolRejected / (double)nPoolSubmitted)));
+			}
 		}
+		// wait for next report, serving config reload requests meanwhile
 		const uint32_t REPORT_INTERVAL_MS = 5 * 1000;
-		std::this_thread::sleep_for(std::chrono::milliseconds(REPORT_INTERVAL_MS));
+		const uint32_t TICK_MS = 100;
+		for (uint32_t waitedMs = 0; s_run && waitedMs < REPORT_INTERVAL_MS; waitedMs += TICK_MS) {
+			serviceReloadRequest();
+			serviceTraceDumpRequest();
+			publishShmStats();
+			backgroundTick();
+			std::this_thread::sleep_for(std::chrono::milliseconds(TICK_MS));
+		}
 	};
 
 	// kill threads
 	logLine(COORDINATOR_LOG_PREFIX, "Stopping Threads");
+	stopControlServer();
+	stopMetricsServer();
+	stopShmStats();
 	stopMinerThreads();
+	stopValidator();
 	stopUpdateThread();
 
 	// curl shutdown
@@ -298,6 +705,7 @@ int main(int argc, char** argv) {
 	ERR_free_strings();
 
 	logLine(COORDINATOR_LOG_PREFIX, "Goodbye !");
+	stopLogger();
 
 	if (s_needKeyPressAtEnd) {
 		printf("Press any key to exit...");
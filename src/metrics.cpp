@@ -0,0 +1,294 @@
+#include "metrics.h"
+#include "httpServer.h"
+#include "miner.h"
+#include "updateThread.h"
+#include "histogram.h"
+#include "trace.h"
+#include "shareStats.h"
+#include "watchdog.h"
+#include "validator.h"
+#include "background.h"
+#include "intensity.h"
+#include "miningConfig.h"
+#include "log.h"
+
+#include <atomic>
+#include <string>
+#include <stdio.h>
+
+const char* METRICS_LOG_PREFIX = "METR";
+const char* PROMETHEUS_CONTENT_TYPE = "text/plain; version=0.0.4; charset=utf-8";
+
+static http_server_handle_t s_metricsServer = nullptr;
+static std::string s_minerVersion;
+static int64_t s_startMs = 0;
+
+// rates in milli hashes per second, so they fit an atomic integer
+static std::atomic<uint64_t> s_hashRateMilli(0);
+static std::atomic<uint64_t> s_threadHashRateMilli[MAX_MINER_THREADS];
+
+void setMetricsHashRate(double hashesPerSecond) {
+	s_hashRateMilli.store((uint64_t)(hashesPerSecond * 1000.0), std::memory_order_relaxed);
+}
+
+void setMetricsThreadHashRate(int minerID, double hashesPerSecond) {
+	if (minerID < 0 || minerID >= MAX_MINER_THREADS) {
+		return;
+	}
+	s_threadHashRateMilli[minerID].store((uint64_t)(hashesPerSecond * 1000.0), std::memory_order_relaxed);
+}
+
+double publishedHashRate() {
+	return s_hashRateMilli.load(std::memory_order_relaxed) / 1000.0;
+}
+
+double publishedThreadHashRate(int minerID) {
+	if (minerID < 0 || minerID >= MAX_MINER_THREADS) {
+		return 0;
+	}
+	return s_threadHashRateMilli[minerID].load(std::memory_order_relaxed) / 1000.0;
+}
+
+static void appendHeader(std::string& out, const char* name, const char* type, const char* help) {
+	out += "# HELP ";
+	out += name;
+	out += " ";
+	out += help;
+	out += "\n# TYPE ";
+	out += name;
+	out += " ";
+	out += type;
+	out += "\n";
+}
+
+static void appendValue(std::string& out, const char* name, const char* labels, double value) {
+	char line[256];
+	if (labels && labels[0]) {
+		snprintf(line, sizeof(line), "%s{%s} %.17g\n", name, labels, value);
+	}
+	else {
+		snprintf(line, sizeof(line), "%s %.17g\n", name, value);
+	}
+	out += line;
+}
+
+static std::string formatMetrics() {
+	std::string out;
+	char labels[128];
+	int nThreads = nMinerThreads();
+	int64_t nowMs = steadyNowMs();
+
+	appendHeader(out, "aquacppminer_info", "gauge", "Miner build information");
+	snprintf(labels, sizeof(labels), "version=\"%s\",arch=\"%s\"", s_minerVersion.c_str(), ARCH);
+	appendValue(out, "aquacppminer_info", labels, 1);
+
+	appendHeader(out, "aquacppminer_uptime_seconds", "gauge", "Seconds since metrics server start");
+	appendValue(out, "aquacppminer_uptime_seconds", "", (nowMs - s_startMs) / 1000.0);
+
+	appendHeader(out, "aquacppminer_threads", "gauge", "Number of miner threads");
+	appendValue(out, "aquacppminer_threads", "", nThreads);
+
+	// hashes
+	appendHeader(out, "aquacppminer_hashes_total", "counter", "Hashes computed by all miner threads");
+	appendValue(out, "aquacppminer_hashes_total", "", (double)getTotalHashes());
+
+	appendHeader(out, "aquacppminer_hashrate", "gauge", "Hashes per second over the last report interval");
+	appendValue(out, "aquacppminer_hashrate", "", s_hashRateMilli.load(std::memory_order_relaxed) / 1000.0);
+
+	// what the pool credits, from accepted shares difficulty
+	ShareWindowStats windows[SHARE_N_WINDOWS];
+	for (int w = 0; w < SHARE_N_WINDOWS; w++) {
+		windows[w] = getShareWindowStats((ShareWindow)w);
+	}
+	appendHeader(out, "aquacppminer_effective_hashrate", "gauge", "Hash rate credited by accepted shares over a sliding window");
+	for (int w = 0; w < SHARE_N_WINDOWS; w++) {
+		snprintf(labels, sizeof(labels), "window=\"%s\"", shareWindowName((ShareWindow)w));
+		appendValue(out, "aquacppminer_effective_hashrate", labels, windows[w].effectiveHashRate);
+	}
+	appendHeader(out, "aquacppminer_luck_ratio", "gauge", "Found shares / expected shares over a sliding window");
+	for (int w = 0; w < SHARE_N_WINDOWS; w++) {
+		snprintf(labels, sizeof(labels), "window=\"%s\"", shareWindowName((ShareWindow)w));
+		appendValue(out, "aquacppminer_luck_ratio", labels, windows[w].luck);
+	}
+	appendHeader(out, "aquacppminer_hashrate_gap_ratio", "gauge", "Share of local hash rate not credited, by cause");
+	for (int w = 0; w < SHARE_N_WINDOWS; w++) {
+		for (int o = SHARE_STALE; o < SHARE_N_OUTCOMES; o++) {
+			snprintf(labels, sizeof(labels), "window=\"%s\",cause=\"%s\"",
+				shareWindowName((ShareWindow)w), shareOutcomeName((ShareOutcome)o));
+			appendValue(out, "aquacppminer_hashrate_gap_ratio", labels, windows[w].gapPercentByOutcome[o] / 100.0);
+		}
+	}
+
+	appendHeader(out, "aquacppminer_thread_hashes_total", "counter", "Hashes computed per miner thread");
+	for (int i = 0; i < nThreads; i++) {
+		snprintf(labels, sizeof(labels), "thread=\"%d\"", i);
+		appendValue(out, "aquacppminer_thread_hashes_total", labels, (double)getThreadHashes(i));
+	}
+
+	appendHeader(out, "aquacppminer_thread_hashrate", "gauge", "Hashes per second per miner thread over the last report interval");
+	for (int i = 0; i < nThreads; i++) {
+		snprintf(labels, sizeof(labels), "thread=\"%d\"", i);
+		appendValue(out, "aquacppminer_thread_hashrate", labels, s_threadHashRateMilli[i].load(std::memory_order_relaxed) / 1000.0);
+	}
+
+	// shares & pools
+	appendHeader(out, "aquacppminer_shares_total", "counter", "Shares submitted per pool, by outcome");
+	for (int i = 0; i < MAX_POOLS; i++) {
+		if (!getPoolStatus(i).active) {
+			continue;
+		}
+		uint32_t found = getPoolSharesSubmitted(i);
+		uint32_t accepted = getPoolSharesAccepted(i);
+		uint32_t lost = getPoolSubmitFailed(i);
+		uint32_t rejected = found - accepted - lost;
+		snprintf(labels, sizeof(labels), "pool=\"%d\",outcome=\"accepted\"", i);
+		appendValue(out, "aquacppminer_shares_total", labels, accepted);
+		snprintf(labels, sizeof(labels), "pool=\"%d\",outcome=\"rejected\"", i);
+		appendValue(out, "aquacppminer_shares_total", labels, rejected);
+		snprintf(labels, sizeof(labels), "pool=\"%d\",outcome=\"lost\"", i);
+		appendValue(out, "aquacppminer_shares_total", labels, lost);
+	}
+
+	appendHeader(out, "aquacppminer_getwork_latency_seconds", "histogram", "aqua_getWork request latency");
+	for (int i = 0; i < MAX_POOLS; i++) {
+		if (getPoolStatus(i).active) {
+			snprintf(labels, sizeof(labels), "pool=\"%d\"", i);
+			formatPrometheusHistogram(out, "aquacppminer_getwork_latency_seconds", labels, getPoolGetWorkLatency(i));
+		}
+	}
+
+	appendHeader(out, "aquacppminer_submit_latency_seconds", "histogram", "aqua_submitWork request latency");
+	for (int i = 0; i < MAX_POOLS; i++) {
+		if (getPoolStatus(i).active) {
+			snprintf(labels, sizeof(labels), "pool=\"%d\"", i);
+			formatPrometheusHistogram(out, "aquacppminer_submit_latency_seconds", labels, getPoolSubmitLatency(i));
+		}
+	}
+
+	appendHeader(out, "aquacppminer_stage_latency_seconds", "histogram", "Share & work lifecycle stage latency");
+	for (int i = 0; i < TRACE_N_EVENTS; i++) {
+		const auto& h = traceLatency((TraceEvent)i);
+		if (h.count() > 0) {
+			snprintf(labels, sizeof(labels), "stage=\"%s\"", traceEventName((TraceEvent)i));
+			formatPrometheusHistogram(out, "aquacppminer_stage_latency_seconds", labels, h);
+		}
+	}
+
+	appendHeader(out, "aquacppminer_thread_state", "gauge", "Watchdog state per miner thread: 0 ok, 1 slow, 2 stalled");
+	for (int i = 0; i < nThreads; i++) {
+		snprintf(labels, sizeof(labels), "thread=\"%d\"", i);
+		appendValue(out, "aquacppminer_thread_state", labels, watchdogThreadState(i));
+	}
+	appendHeader(out, "aquacppminer_thread_cpu", "gauge", "CPU the miner thread last ran on");
+	for (int i = 0; i < nThreads; i++) {
+		snprintf(labels, sizeof(labels), "thread=\"%d\"", i);
+		appendValue(out, "aquacppminer_thread_cpu", labels, watchdogThreadCpu(i));
+	}
+	appendHeader(out, "aquacppminer_watchdog_alerts_total", "counter", "Miner threads flagged by the watchdog");
+	for (int s = WATCHDOG_SLOW; s < WATCHDOG_N_STATES; s++) {
+		snprintf(labels, sizeof(labels), "kind=\"%s\"", watchdogStateName((WatchdogState)s));
+		appendValue(out, "aquacppminer_watchdog_alerts_total", labels, watchdogAlertCount((WatchdogState)s));
+	}
+
+	ValidatorStats validation = getValidatorStats();
+	appendHeader(out, "aquacppminer_validation_checks_total", "counter", "Hashes recomputed with the reference kernel");
+	appendValue(out, "aquacppminer_validation_checks_total", "kind=\"share\"", (double)validation.sharesChecked);
+	appendValue(out, "aquacppminer_validation_checks_total", "kind=\"sample\"", (double)validation.samplesChecked);
+	appendHeader(out, "aquacppminer_validation_invalid_shares_total", "counter", "Found shares not submitted, hash differs from the reference kernel");
+	appendValue(out, "aquacppminer_validation_invalid_shares_total", "", (double)validation.sharesInvalid);
+	appendHeader(out, "aquacppminer_validation_dropped_total", "counter", "Sampled hashes not checked, validator queue full");
+	appendValue(out, "aquacppminer_validation_dropped_total", "", (double)validation.samplesDropped);
+	appendHeader(out, "aquacppminer_validation_mismatches_total", "counter", "Hashes that differ from the reference kernel");
+	appendValue(out, "aquacppminer_validation_mismatches_total", "", (double)validation.mismatches);
+	appendHeader(out, "aquacppminer_validation_fallback", "gauge", "1 when miner threads hash with the reference kernel after a mismatch");
+	appendValue(out, "aquacppminer_validation_fallback", "", validatorFallback() ? 1 : 0);
+
+	Intensity intensity = currentIntensity();
+	if (intensity.mode == INTENSITY_RATE) {
+		appendHeader(out, "aquacppminer_intensity_target_hashrate", "gauge", "Throughput cap in hashes per second (--intensity)");
+		appendValue(out, "aquacppminer_intensity_target_hashrate", "", intensity.value);
+	}
+	else if (intensity.mode == INTENSITY_DUTY) {
+		appendHeader(out, "aquacppminer_intensity_target_ratio", "gauge", "Throughput cap as share of time hashing (--intensity)");
+		appendValue(out, "aquacppminer_intensity_target_ratio", "", intensity.value);
+	}
+	appendHeader(out, "aquacppminer_hashing_seconds_total", "counter", "Time spent hashing, summed over miner threads");
+	appendValue(out, "aquacppminer_hashing_seconds_total", "", getTotalHashUs() / 1e6);
+
+	if (miningConfig().background) {
+		BackgroundStats bg = getBackgroundStats();
+		appendHeader(out, "aquacppminer_background_active_threads", "gauge", "Miner threads not parked by --background");
+		appendValue(out, "aquacppminer_background_active_threads", "", bg.activeThreads);
+		if (bg.psiAvailable) {
+			appendHeader(out, "aquacppminer_host_pressure_ratio", "gauge", "Share of time some task stalled on the resource (PSI), last second");
+			appendValue(out, "aquacppminer_host_pressure_ratio", "resource=\"cpu\"", bg.cpuPressure);
+			appendValue(out, "aquacppminer_host_pressure_ratio", "resource=\"memory\"", bg.memoryPressure);
+		}
+		appendHeader(out, "aquacppminer_background_yield_seconds_total", "counter", "Miner thread time lost to yielding: parked by pressure backoff, or runnable but preempted");
+		appendValue(out, "aquacppminer_background_yield_seconds_total", "reason=\"backoff\"", bg.backoffSeconds);
+		appendValue(out, "aquacppminer_background_yield_seconds_total", "reason=\"preempted\"", bg.preemptedSeconds);
+	}
+
+	// work & pool state, pools without update thread are not exported
+	const char* POOL_GAUGES[][3] = {
+		{ "aquacppminer_work_epoch", "counter", "Number of new works received from the pool" },
+		{ "aquacppminer_work_version", "gauge", "Hash version of the current work" },
+		{ "aquacppminer_seconds_since_new_work", "gauge", "Seconds since the pool sent new work" },
+		{ "aquacppminer_pool_up", "gauge", "1 if last getWork request to the pool succeeded" },
+		{ "aquacppminer_pool_consecutive_failures", "gauge", "getWork failures since last success" },
+		{ "aquacppminer_pool_threads", "gauge", "Miner threads assigned to the pool" },
+	};
+	for (int k = 0; k < (int)(sizeof(POOL_GAUGES) / sizeof(POOL_GAUGES[0])); k++) {
+		const char* name = POOL_GAUGES[k][0];
+		appendHeader(out, name, POOL_GAUGES[k][1], POOL_GAUGES[k][2]);
+		for (int i = 0; i < MAX_POOLS; i++) {
+			PoolStatus st = getPoolStatus(i);
+			if (!st.active) {
+				continue;
+			}
+			snprintf(labels, sizeof(labels), "pool=\"%d\"", i);
+			double v = 0;
+			switch (k) {
+				case 0: v = st.workEpoch; break;
+				case 1: v = st.workVersion; break;
+				case 2: v = st.lastNewWorkMs ? (nowMs - st.lastNewWorkMs) / 1000.0 : -1; break;
+				case 3: v = st.up ? 1 : 0; break;
+				case 4: v = st.consecutiveFailures; break;
+				case 5: v = nMinerThreadsOnPool(i); break;
+			}
+			appendValue(out, name, labels, v);
+		}
+	}
+
+	return out;
+}
+
+static void metricsHandler(const HttpRequest& req, HttpResponse& resp) {
+	if (req.method != "GET") {
+		resp.status = 405;
+		resp.body = "method not allowed\n";
+		return;
+	}
+	if (req.path != "/metrics" && req.path != "/") {
+		resp.status = 404;
+		resp.body = "try /metrics\n";
+		return;
+	}
+	resp.contentType = PROMETHEUS_CONTENT_TYPE;
+	resp.body = formatMetrics();
+}
+
+bool startMetricsServer(uint16_t port, const std::string& version) {
+	if (s_metricsServer) {
+		return true;
+	}
+	s_minerVersion = version;
+	s_startMs = steadyNowMs();
+	s_metricsServer = startHttpServer(METRICS_LOG_PREFIX, port, false, metricsHandler);
+	return s_metricsServer != nullptr;
+}
+
+void stopMetricsServer() {
+	stopHttpServer(s_metricsServer);
+	s_metricsServer = nullptr;
+}
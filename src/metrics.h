@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+#include <stdint.h>
+
+// optional prometheus / openmetrics endpoint (--metrics-port), served from its own thread
+// reads miner counters through atomics only, never takes a lock used by miner threads
+bool startMetricsServer(uint16_t port, const std::string& version);
+void stopMetricsServer();
+
+// hash rates are computed by the periodic report and published here
+void setMetricsHashRate(double hashesPerSecond);
+void setMetricsThreadHashRate(int minerID, double hashesPerSecond);
+double publishedHashRate();
+double publishedThreadHashRate(int minerID);
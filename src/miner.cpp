@@ -5,6 +5,16 @@
 #include "timer.h"
 #include "log.h"
 #include "args.h"
+#include "trace.h"
+#include "profiler.h"
+#include "perfCounters.h"
+#include "shareStats.h"
+#include "watchdog.h"
+#include "topology.h"
+#include "background.h"
+#include "intensity.h"
+#include "validator.h"
+#include "argon2ref.h"
 
 #include <openssl/ssl.h>
 #include <openssl/sha.h>
@@ -26,6 +36,11 @@
 
 #include <argon2.h>
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 using namespace rapidjson;
 using std::chrono::high_resolution_clock;
 using std::string;
@@ -40,32 +55,68 @@ using std::string;
 	#define RAND_BYTES_WIN_FIX
 #endif
 
+// one fixed slot per miner thread id, never reallocated: submit threads can keep a MinerInfo*
+// while miner threads are added or retired
 struct MinerInfo {
 	MinerInfo() :
-		needRegenSeed(false)
-	{
-	}
-
-	MinerInfo(const MinerInfo& origin) :
-		needRegenSeed(false)
+		pThread(nullptr),
+		run(false),
+		needRegenSeed(false),
+		arenaNode(-1)
 	{
-		logPrefix = origin.logPrefix;
+		logPrefix[0] = 0;
 	}
 
+	std::thread* pThread; // only touched under s_minerThreads_mutex
+	std::atomic<bool> run;
 	std::atomic<bool> needRegenSeed;
-	std::string logPrefix;
+	std::atomic<int> arenaNode; // NUMA node of the CPU the thread is pinned on, -1 if not pinned
+	char logPrefix[16];
 };
 
 // atomics shared by miner threads
-static std::vector<std::thread*> s_minerThreads;
-static std::vector<MinerInfo> s_minerThreadsInfo;
-static std::atomic<uint32_t> s_totalHashes(0);
-static bool s_bMinerThreadsRun = true;
+static MinerInfo s_minerThreadsInfo[MAX_MINER_THREADS];
+static std::atomic<bool> s_bMinerThreadsRun(true);
+static std::atomic<bool> s_bMinerThreadsPaused(false);
+// threads with id >= this count are parked (--background)
+static std::atomic<int> s_nActiveMinerThreads(MAX_MINER_THREADS);
+// running miner threads use ids [0, s_nMinerThreads), readable from any thread
+static std::atomic<int> s_nMinerThreads(0);
+// highest number of slots ever used, counters of retired threads stay in the totals
+static std::atomic<int> s_nMinerSlotsUsed(0);
+static std::mutex s_minerThreads_mutex;
 static std::atomic<uint32_t> s_nBlocksFound(0);
 static std::atomic<uint32_t> s_nSharesFound(0);
 static std::atomic<uint32_t> s_nSharesAccepted(0);
 extern std::atomic<int> s_version;
 
+// per pool share counters
+struct PoolShareStats {
+	PoolShareStats() : nSharesFound(0), nSharesAccepted(0), nSubmitFailed(0) {}
+	std::atomic<uint32_t> nSharesFound;
+	std::atomic<uint32_t> nSharesAccepted;
+	std::atomic<uint32_t> nSubmitFailed; // httpPost failed, share lost
+	LatencyHistogram submitLatency;
+};
+static PoolShareStats s_poolShares[MAX_POOLS];
+
+// per miner thread counters, each block on its own cache line so hashing threads never share one
+// only written by the owning miner thread (relaxed), summed by the reporter
+struct alignas(64) MinerCounters {
+	std::atomic<uint64_t> hashes;
+	std::atomic<uint64_t> shares;
+	std::atomic<uint64_t> hashUs; // time spent hashing
+};
+static MinerCounters s_minerCounters[MAX_MINER_THREADS];
+
+// single writer increment, no need for a locked read-modify-write
+inline void incCounter(std::atomic<uint64_t>& counter) {
+	counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+// pool each miner thread is hashing for, can change while mining
+static std::atomic<int> s_minerPool[MAX_MINER_THREADS];
+
 // use same atomic for miners and update thread http request ID
 extern std::atomic<uint32_t> s_nodeReqId;
 
@@ -77,11 +128,15 @@ thread_local uint8_t s_argonHash[ARGON2_HASH_LEN] = { 0 };
 thread_local int s_minerThreadID = { -1 };
 thread_local char s_currentWorkHash[256] = { 0 };
 thread_local char s_logPrefix[32] = "MINE";
-thread_local uint64_t s_threadHashes = 0;
-thread_local uint64_t s_threadShares = 0;
+// argon2 memory of a pinned thread (--affinity), on the NUMA node of its CPU, kept between hashes
+thread_local int t_arenaNode = -1;
+thread_local uint8_t* t_arena = nullptr;
+thread_local size_t t_arenaBytes = 0;
 
 // need to be able to stop main loop from miner threads
 extern bool s_run;
+// traceNowUs() at the start of main
+extern int64_t s_processStartUs;
 
 // argon2id params for aquachain each HF
 const std::vector<int> AQUA_HF7 = { 1, 1, 1 };
@@ -111,6 +166,8 @@ void mpz_maxBest(mpz_t mpz_n) {
 	mpz_init_set_str(mpz_exponent, "256", 10);
 	mpz_init_set_str(mpz_n, "0", 10);
 	mpz_pow_ui(mpz_n, mpz_two, mpz_get_ui(mpz_exponent));
+	mpz_clear(mpz_two);
+	mpz_clear(mpz_exponent);
 }
 
 #ifdef RAND_BYTES_WIN_FIX
@@ -140,9 +197,59 @@ uint32_t getTotalSharesAccepted()
 	return s_nSharesAccepted;
 }
 
-uint32_t getTotalHashes()
+uint64_t getTotalHashes()
+{
+	uint64_t total = 0;
+	for (int i = 0; i < s_nMinerSlotsUsed; i++) {
+		total += s_minerCounters[i].hashes.load(std::memory_order_relaxed);
+	}
+	return total;
+}
+
+uint64_t getThreadHashes(int minerID)
+{
+	assert(minerID >= 0 && minerID < MAX_MINER_THREADS);
+	return s_minerCounters[minerID].hashes.load(std::memory_order_relaxed);
+}
+
+uint64_t getTotalHashUs()
+{
+	uint64_t total = 0;
+	for (int i = 0; i < s_nMinerSlotsUsed; i++) {
+		total += s_minerCounters[i].hashUs.load(std::memory_order_relaxed);
+	}
+	return total;
+}
+
+uint64_t getThreadShares(int minerID)
 {
-	return s_totalHashes;
+	assert(minerID >= 0 && minerID < MAX_MINER_THREADS);
+	return s_minerCounters[minerID].shares.load(std::memory_order_relaxed);
+}
+
+int nMinerThreads()
+{
+	return s_nMinerThreads;
+}
+
+void pauseMinerThreads(bool pause)
+{
+	s_bMinerThreadsPaused = pause;
+}
+
+bool minerThreadsPaused()
+{
+	return s_bMinerThreadsPaused;
+}
+
+void setActiveMinerThreads(int nActive)
+{
+	s_nActiveMinerThreads = nActive;
+}
+
+int activeMinerThreads()
+{
+	return std::min((int)s_nMinerThreads, (int)s_nActiveMinerThreads);
 }
 
 uint32_t getTotalBlocksAccepted()
@@ -150,6 +257,65 @@ uint32_t getTotalBlocksAccepted()
 	return s_nBlocksFound;
 }
 
+uint32_t getPoolSharesSubmitted(int poolId)
+{
+	assert(poolId >= 0 && poolId < MAX_POOLS);
+	return s_poolShares[poolId].nSharesFound;
+}
+
+uint32_t getPoolSharesAccepted(int poolId)
+{
+	assert(poolId >= 0 && poolId < MAX_POOLS);
+	return s_poolShares[poolId].nSharesAccepted;
+}
+
+uint32_t getPoolSubmitFailed(int poolId)
+{
+	assert(poolId >= 0 && poolId < MAX_POOLS);
+	return s_poolShares[poolId].nSubmitFailed;
+}
+
+const LatencyHistogram& getPoolSubmitLatency(int poolId)
+{
+	assert(poolId >= 0 && poolId < MAX_POOLS);
+	return s_poolShares[poolId].submitLatency;
+}
+
+static void assignMinerThreadsToPools(int nThreads)
+{
+	auto cfg = miningConfig();
+	auto assignment = splitThreadsByWeight(cfg.pools, nThreads);
+	for (int i = 0; i < MAX_MINER_THREADS; i++) {
+		s_minerPool[i] = (i < (int)assignment.size()) ? assignment[i] : 0;
+	}
+}
+
+void assignMinerThreadsToPools()
+{
+	int nThreads = s_nMinerThreads;
+	if (nThreads == 0) {
+		nThreads = std::min((int)miningConfig().nThreads, MAX_MINER_THREADS);
+	}
+	assignMinerThreadsToPools(nThreads);
+}
+
+int minerThreadPool(int minerID)
+{
+	assert(minerID >= 0 && minerID < MAX_MINER_THREADS);
+	return s_minerPool[minerID];
+}
+
+int nMinerThreadsOnPool(int poolId)
+{
+	int n = 0;
+	for (int i = 0; i < s_nMinerThreads; i++) {
+		if (s_minerPool[i] == poolId) {
+			n++;
+		}
+	}
+	return n;
+}
+
 #define USE_CUSTOM_ALLOCATOR (0)
 #if USE_CUSTOM_ALLOCATOR
 static std::mutex s_alloc_mutex;
@@ -188,8 +354,29 @@ void myFree(uint8_t *memory, size_t bytes_to_allocate)
 }
 #endif
 
+static int nodeArenaAlloc(uint8_t **memory, size_t bytes_to_allocate)
+{
+	if (bytes_to_allocate > t_arenaBytes) {
+		freeNodeLocalMemory(t_arena, t_arenaBytes);
+		t_arena = allocNodeLocalMemory(bytes_to_allocate, t_arenaNode);
+		t_arenaBytes = t_arena ? bytes_to_allocate : 0;
+	}
+	*memory = t_arena;
+	return t_arena != nullptr;
+}
+
+static void nodeArenaFree(uint8_t *memory, size_t bytes_to_allocate)
+{
+	// reused by the next hash, released by freeCurrentThreadMiningMemory()
+}
+
 void freeCurrentThreadMiningMemory() {
+	freeNodeLocalMemory(t_arena, t_arenaBytes);
+	t_arena = nullptr;
+	t_arenaBytes = 0;
 #if USE_CUSTOM_ALLOCATOR
+	// threads can be retired while others are still allocating
+	std::lock_guard<std::mutex> lock(s_alloc_mutex);
 	auto tId = std::this_thread::get_id();
 	auto it = threadBlocks.find(tId);
 	if (it != threadBlocks.end()) {
@@ -256,6 +443,10 @@ void setupAquaArgonCtx(
 	ctx.m_cost = version2memcost(s_version);
 	ctx.lanes = 1;
 	ctx.threads = 1;
+	if (t_arenaNode >= 0) {
+		ctx.allocate_cbk = nodeArenaAlloc;
+		ctx.free_cbk = nodeArenaFree;
+	}
 #if USE_CUSTOM_ALLOCATOR
 	printf("using custom allocator\n");
 	ctx.allocate_cbk = myAlloc;
@@ -277,10 +468,15 @@ std::string nonceToString(uint64_t nonce) {
 	return res;
 }
 
-static std::mutex s_submit_mutex;
-static http_connection_handle_t s_httpHandleSubmit = nullptr;
+// one submit connection per pool
+struct SubmitPipe {
+	SubmitPipe() : httpHandle(nullptr) {}
+	std::mutex mutex;
+	http_connection_handle_t httpHandle;
+};
+static SubmitPipe s_submitPipes[MAX_POOLS];
 
-void submitThreadFn(uint64_t nonceVal, std::string hashStr, int minerThreadId)
+void submitThreadFn(uint64_t nonceVal, std::string hashStr, int minerThreadId, int poolId, std::string poolUrl, int64_t foundUs, double difficulty, int version, Bytes foundHash)
 {
 	const std::vector<std::string> HTTP_HEADER = {
 		"Accept: application/json",
@@ -289,6 +485,14 @@ void submitThreadFn(uint64_t nonceVal, std::string hashStr, int minerThreadId)
 
 	MinerInfo* pMinerInfo = &s_minerThreadsInfo[minerThreadId];
 	auto nonceStr = nonceToString(nonceVal);
+
+#if ARGON_VALIDITY_CHECK
+	// a wrong hash would only come back as a reject (and a wait for new work), drop it instead
+	if (!validateShare(version, nonceVal, hashStr, foundHash.data())) {
+		logLine(pMinerInfo->logPrefix, "share not submitted, nonce = %s: hash does not match the reference kernel", nonceStr.c_str());
+		return;
+	}
+#endif
 	char submitParams[512] = { 0 };
 
 	snprintf(
@@ -302,28 +506,41 @@ void submitThreadFn(uint64_t nonceVal, std::string hashStr, int minerThreadId)
 
 	std::string response;
 	bool ok = false;
-	printf("[submit] %s\n", submitParams);
+	int64_t sendUs = 0;
+	logLine(pMinerInfo->logPrefix, "submit %s", submitParams);
 
-	// all submits are done through the same CURL HTTPP connection
+	// all submits to a pool are done through the same CURL HTTPP connection
 	// so protected with a mutex
 	// means that submits will be done sequentially and not in parallel
-	s_submit_mutex.lock();
+	SubmitPipe& pipe = s_submitPipes[poolId];
+	pipe.mutex.lock();
 	{
-		if (!s_httpHandleSubmit) {
-			s_httpHandleSubmit = newHttpConnectionHandle();
+		if (!pipe.httpHandle) {
+			pipe.httpHandle = newHttpConnectionHandle();
 		}
+		auto tPost = high_resolution_clock::now();
+		sendUs = traceNowUs();
+		traceSpan(TRACE_SUBMIT_QUEUE, minerThreadId, poolId, foundUs, sendUs);
 		ok = httpPost(
-			s_httpHandleSubmit,
-			miningConfig().submitWorkUrl.c_str(),
+			pipe.httpHandle,
+			poolUrl.c_str(),
 			submitParams, response, &HTTP_HEADER);
+		if (ok) {
+			std::chrono::duration<double, std::milli> postDuration = high_resolution_clock::now() - tPost;
+			s_poolShares[poolId].submitLatency.add(postDuration.count());
+		}
 	}
-	s_submit_mutex.unlock();
+	pipe.mutex.unlock();
+	int64_t responseUs = traceNowUs();
 
 	if (!ok) {
 		logLine(
 			pMinerInfo->logPrefix,
 			"\n\n!!! httpPost failed while trying to submit nonce %s!!!\n",
 			nonceStr.c_str());
+			s_poolShares[poolId].nSubmitFailed++;
+			traceSpan(TRACE_SUBMIT, minerThreadId, poolId, sendUs, responseUs, TRACE_SUBMIT_FAILED);
+			recordShareOutcome(SHARE_LOST, difficulty);
 			std::this_thread::sleep_for(std::chrono::milliseconds(3000));
 	}
 	else {
@@ -341,6 +558,9 @@ void submitThreadFn(uint64_t nonceVal, std::string hashStr, int minerThreadId)
 			}
 		}
 
+		traceSpan(TRACE_SUBMIT, minerThreadId, poolId, sendUs, responseUs,
+			accepted ? TRACE_SUBMIT_ACCEPTED : TRACE_SUBMIT_REJECTED);
+
 		// log
 		if (accepted) {
 			logLine(
@@ -349,6 +569,13 @@ void submitThreadFn(uint64_t nonceVal, std::string hashStr, int minerThreadId)
 				nonceStr.c_str()
 			);
 			s_nSharesAccepted++;
+			s_poolShares[poolId].nSharesAccepted++;
+			recordShareOutcome(SHARE_ACCEPTED, difficulty);
+
+			// a found block means new work is already waiting on the node
+			if (miningConfig().soloMine) {
+				triggerWorkUpdate(poolId, UPDATE_TRIGGER_BLOCK_FOUND);
+			}
 		}
 		else {
 			logLine(
@@ -358,15 +585,56 @@ void submitThreadFn(uint64_t nonceVal, std::string hashStr, int minerThreadId)
 				nonceStr.c_str(),
 				response.c_str());
 			pMinerInfo->needRegenSeed = true;
+
+			// stale if the pool has already moved to another work
+			bool stale = currentWorkParams(poolId).hash != hashStr;
+			recordShareOutcome(stale ? SHARE_STALE : SHARE_REJECTED, difficulty);
+
+			// rejects are mostly stale shares, refresh work asap
+			triggerWorkUpdate(poolId, UPDATE_TRIGGER_SHARE_REJECTED);
 		}
 	}
 	s_nSharesFound++;
+	s_poolShares[poolId].nSharesFound++;
 }
 
+#if AQUA_PROFILE
+thread_local bool t_profiledKernelChecked = false;
+
+// the profiled kernel must produce the same hash as argon2_ctx, checked once per thread
+static bool checkProfiledKernel(Argon2_Context *ctx) {
+	uint8_t ref[ARGON2_HASH_LEN];
+	if (argon2_ctx(ctx, Argon2_id) != ARGON2_OK) {
+		return false;
+	}
+	memcpy(ref, ctx->out, ARGON2_HASH_LEN);
+	if (argon2_ctx_profiled(ctx, Argon2_id) != ARGON2_OK) {
+		return false;
+	}
+	return memcmp(ref, ctx->out, ARGON2_HASH_LEN) == 0;
+}
+#endif
+
 bool aquahash(const int version, Argon2_Context *ctx){
     ctx->m_cost = version2memcost(version);
  //   printf("mcost=%d\n", ctx->m_cost);
+	// optimized kernel disagreed with the reference once, it cannot be trusted anymore
+	if (validatorFallback()) {
+		return argon2idReference(ctx->pwd, ctx->pwdlen, ctx->t_cost, ctx->m_cost, ctx->out, ctx->outlen);
+	}
+#if AQUA_PROFILE
+	if (!t_profiledKernelChecked) {
+		t_profiledKernelChecked = true;
+		if (!checkProfiledKernel(ctx)) {
+			logLine(s_logPrefix, "Error: profiled argon2 kernel does not match argon2_ctx");
+			assert(0);
+			return false;
+		}
+	}
+	int res = argon2_ctx_profiled(ctx, Argon2_id);
+#else
 	int res = argon2_ctx(ctx, Argon2_id);
+#endif
 	if (res != ARGON2_OK) {
 		logLine(s_logPrefix, "Error: argon2 failed with code %d", res);
 		assert(0);
@@ -383,31 +651,42 @@ bool hash(const WorkParams& p, mpz_t mpz_result, uint64_t nonce, Argon2_Context
     }
 
 	// update the seed with the new nonce
+	PROFILE_BEGIN(tSeed);
 	updateAquaSeed(nonce, s_seed);
+	PROFILE_END(PROF_SEED_UPDATE, tSeed);
 
 	// argon hash
-    int res = aquahash(s_version, &ctx);
+    int res = aquahash(p.version, &ctx);
+	validateSample(p.version, s_seed, ctx.out);
 
 	// convert hash to a mpz (big int)
+	PROFILE_BEGIN(tMpz);
 	mpz_fromBytesNoInit(ctx.out, ctx.outlen, mpz_result);
+	PROFILE_END(PROF_MPZ_IMPORT, tMpz);
 
 	// compare to target
+	PROFILE_BEGIN(tCmp);
 	bool needSubmit = mpz_cmp(mpz_result, p.mpz_target) < 0;
+	PROFILE_END(PROF_TARGET_CMP, tCmp);
 	if (needSubmit) {
+		incCounter(s_minerCounters[s_minerThreadID].shares);
+		int64_t foundUs = traceNowUs();
+		traceInstant(TRACE_SHARE_FOUND, s_minerThreadID, p.poolId);
 		if (miningConfig().soloMine) {
 			// for solo mining we do a synchronous submit ASAP
-			submitThreadFn(s_nonce, p.hash, s_minerThreadID);
+			submitThreadFn(s_nonce, p.hash, s_minerThreadID, p.poolId, p.poolUrl, foundUs, p.difficultyValue,
+				p.version, Bytes(ctx.out, ctx.out + ctx.outlen));
 		}
 		else {
 			// for pool mining we launch a thread to submit work asynchronously
 			// like that we can continue mining while curl performs the request & wait for a response
-			std::thread{ submitThreadFn, s_nonce, p.hash, s_minerThreadID}.detach();
+			std::thread{ submitThreadFn, s_nonce, p.hash, s_minerThreadID, p.poolId, p.poolUrl, foundUs, p.difficultyValue,
+				p.version, Bytes(ctx.out, ctx.out + ctx.outlen) }.detach();
 
 			// sleep for a short duration, to allow the submit thread launch its request asap
 			std::this_thread::sleep_for(std::chrono::milliseconds(1));
 		}
 	}
-	s_threadShares++;
 	return true;
 }
 
@@ -419,14 +698,66 @@ uint64_t makeAquaNonce()
 	return nonce;
 }
 
+const uint32_t MINER_PAUSE_POLL_MS = 5;
+// threads started before the first work wait for it, woken as soon as it is published
+const uint32_t MINER_WORK_WAIT_MS = 100;
+// highest hash version aqua_getWork announces, warm up version when the pool has no work yet
+// (the arena only grows, so a later work of a lower version reuses it)
+const int AQUA_WARMUP_DEFAULT_VERSION = 4;
+
+// startup timings, logged once
+static std::atomic<int> s_nMinerThreadsReady(0);
+static std::atomic<bool> s_readyLogged(false);
+static std::atomic<bool> s_firstHashLogged(false);
+
+// one hash before the first work: memory, page faults & kernel code warmed up while getWork is in flight
+static void warmUpMinerThread(int minerID)
+{
+	int version = getPoolStatus(minerThreadPool(minerID)).workVersion;
+	if (version < 2) {
+		version = AQUA_WARMUP_DEFAULT_VERSION;
+	}
+	if (!aquahash(version, &s_ctx)) {
+		return;
+	}
+	setupAquaArgonCtx(s_ctx, s_seed, s_argonHash);
+	int nReady = ++s_nMinerThreadsReady;
+	if (nReady == (int)miningConfig().nThreads && !s_readyLogged.exchange(true)) {
+		logLine(s_logPrefix, "%d miner threads ready, %.1f ms after process start",
+			nReady, (traceNowUs() - s_processStartUs) / 1000.0);
+	}
+}
+
 void minerThreadFn(int minerID)
 {
 	// record thread id in TLS
 	s_minerThreadID = minerID;
+	setLogDropWhenFull(true);
+
+#if AQUA_PROFILE
+	profileSetThread(minerID);
+#endif
+
+	// log prefix was set by startMinerThread()
+	MinerInfo& info = s_minerThreadsInfo[minerID];
+	snprintf(s_logPrefix, sizeof(s_logPrefix), "%s", info.logPrefix);
 
-	// generate log prefix
-	snprintf(s_logPrefix, sizeof(s_logPrefix), "MN%02d", minerID);
-	s_minerThreadsInfo[minerID].logPrefix.assign(s_logPrefix);
+	// pin before the first allocation, so argon2 memory lands on the node of the CPU
+	int cpu = minerThreadCpu(minerID);
+	if (cpu >= 0) {
+		if (pinCurrentThread(cpu)) {
+			t_arenaNode = cpuNumaNode(cpu);
+		}
+		else {
+			logLine(s_logPrefix, "Warning: cannot pin thread on CPU %d", cpu);
+		}
+	}
+
+	info.arenaNode = t_arenaNode;
+
+	// optional hardware counters, opened on this thread
+	perfThreadStart(minerID);
+	backgroundThreadStart(minerID);
 
 	// init thread TLS variables that need it
 	s_seed.resize(40, 0);
@@ -438,24 +769,52 @@ void minerThreadFn(int minerID)
 	mpz_t mpz_result;
 	mpz_init(mpz_result);
 
+	warmUpMinerThread(minerID);
+
 	bool solo = miningConfig().soloMine;
 	int version = -1;
+	// work publish -> first hash latency, traced once per new work
+	bool firstHashPending = false;
 
 
-	while (s_bMinerThreadsRun) {
-		// get params for current block
-		WorkParams prms = currentWorkParams();
-		if (version2memcost(s_version) != s_ctx.m_cost) {
-            if (prms.version == 0) {
-              printf("hash version must be 2 or higher\n");
-              break;
-            }
-			version = s_version;
-			printf("[%s] Activating Hash Version: %d (m=%d)\n", s_logPrefix, version,version2memcost(version));
-	        setupAquaArgonCtx(s_ctx, s_seed, s_argonHash);
+	while (s_bMinerThreadsRun && info.run) {
+		// paused through the control API or parked by --background, keep context & memory warm
+		if (s_bMinerThreadsPaused || minerID >= s_nActiveMinerThreads) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(MINER_PAUSE_POLL_MS));
+			continue;
 		}
+		// throughput cap (--intensity)
+		if (intensityThrottle(activeMinerThreads())) {
+			continue;
+		}
+
+		// moved to a CPU of another NUMA node by the watchdog, the next hash allocates the arena there
+		int arenaNode = info.arenaNode.load(std::memory_order_relaxed);
+		if (arenaNode != t_arenaNode) {
+			freeNodeLocalMemory(t_arena, t_arenaBytes);
+			t_arena = nullptr;
+			t_arenaBytes = 0;
+			t_arenaNode = arenaNode;
+#if !USE_CUSTOM_ALLOCATOR
+			s_ctx.allocate_cbk = nodeArenaAlloc;
+			s_ctx.free_cbk = nodeArenaFree;
+#endif
+			logLine(s_logPrefix, "Argon2 memory moved to NUMA node %d", arenaNode);
+		}
+
+		// get params for current block of the pool this thread mines for
+		PROFILE_BEGIN(tSnapshot);
+		WorkParams prms = currentWorkParams(minerThreadPool(minerID));
+		PROFILE_END(PROF_WORK_SNAPSHOT, tSnapshot);
 		// if params valid
 		if (prms.hash.size() != 0) {
+			if (version2memcost(prms.version) != s_ctx.m_cost) {
+				version = prms.version;
+				logLine(s_logPrefix, "Activating Hash Version: %d (m=%d)", version, version2memcost(version));
+				setupAquaArgonCtx(s_ctx, s_seed, s_argonHash);
+				s_ctx.m_cost = version2memcost(version);
+			}
+
 			// check if work hash has changed
 			if (strcmp(prms.hash.c_str(), s_currentWorkHash)) {
 				// generate the TLS nonce & seed nonce again
@@ -463,17 +822,15 @@ void minerThreadFn(int minerID)
 				generateAquaSeed(s_nonce, prms.hash, s_seed);
 				// save current hash in TLS
 				strcpy(s_currentWorkHash, prms.hash.c_str());
+				firstHashPending = prms.publishUs > 0;
 
 #if DEBUG_NONCE
 				logLine(s_logPrefix, "new work starting nonce: %s", nonceToString(s_nonce).c_str());
 #endif
-			} else if (s_minerThreadsInfo[minerID].needRegenSeed) {
-					// pool has rejected the nonce, record current number of succesfull pool getWork requests
-					uint32_t getWorkCountOfRejectedShare = getPoolGetWorkCount();
-
-					// generate a new nonce
+			} else if (info.needRegenSeed) {
+					// pool has rejected the nonce, generate a new one
 					s_nonce = makeAquaNonce();
-					s_minerThreadsInfo[minerID].needRegenSeed = false;
+					info.needRegenSeed = false;
 #if DEBUG_NONCES
 					logLine(s_logPrefix, "regen nonce after reject: %s", nonceToString(s_nonce).c_str());
 #endif
@@ -484,12 +841,12 @@ void minerThreadFn(int minerID)
 						logLine(s_logPrefix, "regenerated nonce after a reject, not waiting for pool to send new work !");
 #else
 						logLine(s_logPrefix, "Thread stopped mining because last share rejected, waiting for new work from pool");
-						std::this_thread::sleep_for(std::chrono::seconds(3));
+						waitForNewWork(prms.poolId, prms.hash, 3000);
 						logLine(s_logPrefix, "Thread resumes mining");
 #endif
 					//}
 				// only inc the TLS nonce
-				printf("incrementing nonce again?\n");
+				logLine(s_logPrefix, "incrementing nonce again?");
 				s_nonce++;
 				}
 			
@@ -498,11 +855,26 @@ void minerThreadFn(int minerID)
 			//if (s_nonce % 10000 == 0) {
 			//	printf("Hashing m_cost=%d\n", s_ctx.m_cost);
 			//}
+			auto tHash = high_resolution_clock::now();
 			bool hashOk = hash(prms, mpz_result, s_nonce, s_ctx);
+			uint32_t hashUs = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+				high_resolution_clock::now() - tHash).count();
+			watchdogRecordHash(minerID, hashUs);
+			intensityRecordHash(hashUs);
+			s_minerCounters[minerID].hashUs.store(
+				s_minerCounters[minerID].hashUs.load(std::memory_order_relaxed) + hashUs, std::memory_order_relaxed);
 			if (hashOk) {
 				s_nonce++;
-				s_threadHashes++;
-				s_totalHashes++;
+				incCounter(s_minerCounters[minerID].hashes);
+				if (firstHashPending) {
+					firstHashPending = false;
+					traceSpan(TRACE_FIRST_HASH, minerID, prms.poolId, prms.publishUs, traceNowUs());
+				}
+				if (!s_firstHashLogged && !s_firstHashLogged.exchange(true)) {
+					int64_t nowUs = traceNowUs();
+					logLine(s_logPrefix, "first hash: %.1f ms after process start, %.1f ms after first work",
+						(nowUs - s_processStartUs) / 1000.0, (nowUs - prms.publishUs) / 1000.0);
+				}
 			}
 			else {
 				assert(0);
@@ -511,31 +883,137 @@ void minerThreadFn(int minerID)
 				s_run = false;
 			}
 		}
+		else {
+			// no work yet, parked ready until the update thread publishes one
+			waitForWork(minerThreadPool(minerID), MINER_WORK_WAIT_MS);
+		}
 	}
+	backgroundThreadStop(minerID);
+	perfThreadStop(minerID);
 	freeCurrentThreadMiningMemory();
 }
 
-void startMinerThreads(int nThreads)
+// needs s_minerThreads_mutex
+static void startMinerThread(int minerID)
 {
-	assert(nThreads > 0);
-	assert(s_minerThreads.size() == 0);
-	s_minerThreads.resize(nThreads);
-	s_minerThreadsInfo.resize(nThreads);
-	for (int i = 0; i < nThreads; i++) {
-		s_minerThreads[i] = new std::thread(minerThreadFn, i);
+	MinerInfo& info = s_minerThreadsInfo[minerID];
+	assert(info.pThread == nullptr);
+	snprintf(info.logPrefix, sizeof(info.logPrefix), "MN%02d", minerID);
+	info.needRegenSeed = false;
+	info.run = true;
+	info.pThread = new std::thread(minerThreadFn, minerID);
+}
+
+// needs s_minerThreads_mutex, waits for the current hash to finish & the thread arena to be freed
+static void joinMinerThread(int minerID)
+{
+	MinerInfo& info = s_minerThreadsInfo[minerID];
+	assert(info.pThread);
+	info.pThread->join();
+	delete info.pThread;
+	info.pThread = nullptr;
+}
+
+static void resizeMinerThreads(int nThreads)
+{
+	int nOld = s_nMinerThreads;
+	if (nThreads > nOld) {
+		// new threads get their pool before starting to hash
+		assignMinerThreadsToPools(nThreads);
+		for (int i = nOld; i < nThreads; i++) {
+			startMinerThread(i);
+		}
+		s_nMinerThreads = nThreads;
+		if (nThreads > s_nMinerSlotsUsed) {
+			s_nMinerSlotsUsed = nThreads;
+		}
+	}
+	else if (nThreads < nOld) {
+		// retire the highest ids so running threads stay contiguous
+		for (int i = nThreads; i < nOld; i++) {
+			s_minerThreadsInfo[i].run = false;
+		}
+		s_nMinerThreads = nThreads;
+		for (int i = nThreads; i < nOld; i++) {
+			joinMinerThread(i);
+		}
+		assignMinerThreadsToPools(nThreads);
+	}
+}
+
+bool startMinerThreads(int nThreads)
+{
+	if (nThreads <= 0 || nThreads > MAX_MINER_THREADS) {
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(s_minerThreads_mutex);
+	assert(s_nMinerThreads == 0);
+	s_bMinerThreadsRun = true;
+	resizeMinerThreads(nThreads);
+	return true;
+}
+
+bool setMinerThreadCount(int nThreads)
+{
+	if (nThreads <= 0 || nThreads > MAX_MINER_THREADS) {
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(s_minerThreads_mutex);
+	if (s_nMinerThreads == 0 || !s_bMinerThreadsRun) {
+		// not mining (yet / anymore)
+		return false;
 	}
+	resizeMinerThreads(nThreads);
+	return true;
+}
+
+bool restartMinerThread(int minerID)
+{
+	std::lock_guard<std::mutex> lock(s_minerThreads_mutex);
+	if (minerID < 0 || minerID >= s_nMinerThreads || !s_bMinerThreadsRun) {
+		return false;
+	}
+	s_minerThreadsInfo[minerID].run = false;
+	joinMinerThread(minerID);
+	startMinerThread(minerID);
+	return true;
+}
+
+bool pinMinerThread(int minerID, int cpu)
+{
+#ifdef __linux__
+	std::lock_guard<std::mutex> lock(s_minerThreads_mutex);
+	if (minerID < 0 || minerID >= s_nMinerThreads) {
+		return false;
+	}
+	cpu_set_t cpuset;
+	CPU_ZERO(&cpuset);
+	CPU_SET(cpu, &cpuset);
+	if (pthread_setaffinity_np(s_minerThreadsInfo[minerID].pThread->native_handle(), sizeof(cpu_set_t), &cpuset) != 0) {
+		return false;
+	}
+	// the thread reallocates its arena between two hashes if the node changed
+	s_minerThreadsInfo[minerID].arenaNode = cpuNumaNode(cpu);
+	return true;
+#else
+	return false;
+#endif
 }
 
 void stopMinerThreads()
 {
-	assert(s_bMinerThreadsRun);
+	std::lock_guard<std::mutex> lock(s_minerThreads_mutex);
+	if (s_nMinerThreads == 0) {
+		return;
+	}
 	s_bMinerThreadsRun = false;
-	for (size_t i = 0; i < s_minerThreads.size(); i++) {
-		s_minerThreads[i]->join();
-		delete s_minerThreads[i];
+	resizeMinerThreads(0);
+	for (int i = 0; i < MAX_POOLS; i++) {
+		s_submitPipes[i].mutex.lock();
+		destroyHttpConnectionHandle(s_submitPipes[i].httpHandle);
+		s_submitPipes[i].httpHandle = nullptr;
+		s_submitPipes[i].mutex.unlock();
 	}
-	s_minerThreads.clear();
-	destroyHttpConnectionHandle(s_httpHandleSubmit);
 }
 void setArgonParams(long t_cost, long m_cost, long lanes, Argon2_Context *ctx) {
 	printf("Setting argon2 params\n");
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "hex_encode_utils.h"
+#include "histogram.h"
 
 #include <stdint.h>
 #include <string>
@@ -13,33 +14,69 @@
 // size of the hash that argon2i / argon2id will generate
 const uint32_t ARGON2_HASH_LEN = 32;
 
+// max number of miner threads
+const int MAX_MINER_THREADS = 1024;
+
 // current work
 struct WorkParams {
+	int poolId = 0;
+	std::string poolUrl = ""; // shares are submitted to the pool the work comes from
+	int64_t publishUs = 0; // traceNowUs() when handed to miner threads
 	int version = -1;
 	std::string difficulty = "";
+	double difficultyValue = 0; // expected hashes per share
 	std::string target = "";
 	std::string hash = "";
 	mpz_t mpz_target;
 };
 
-void startMinerThreads(int nThreads);
+// false if nThreads is not in [1, MAX_MINER_THREADS]
+bool startMinerThreads(int nThreads);
 void stopMinerThreads();
+// adds or retires miner threads while mining (highest ids are retired first), false if not mining
+bool setMinerThreadCount(int nThreads);
+// stops & starts one thread again (new TLS context & arena), waits for its current hash
+bool restartMinerThread(int minerID);
+// Linux only, false elsewhere, the argon2 arena of the thread follows it to the NUMA node of the new cpu
+bool pinMinerThread(int minerID, int cpu);
+// paused threads keep their context & memory, resume hashing within a few ms
+void pauseMinerThreads(bool pause);
+bool minerThreadsPaused();
+// parks threads with id >= nActive without retiring them (memory stays allocated)
+void setActiveMinerThreads(int nActive);
+int activeMinerThreads();
 
-uint32_t getTotalHashes();
+// hash counters are 64 bits, summed from per thread counters
+uint64_t getTotalHashes();
+uint64_t getThreadHashes(int minerID);
+uint64_t getThreadShares(int minerID);
+// time spent inside hash(), summed over threads
+uint64_t getTotalHashUs();
+int nMinerThreads();
 uint32_t getTotalSharesSubmitted();
 uint32_t getTotalSharesAccepted();
 uint32_t getTotalBlocksAccepted();
+uint32_t getPoolSharesSubmitted(int poolId);
+uint32_t getPoolSharesAccepted(int poolId);
+uint32_t getPoolSubmitFailed(int poolId);
+const LatencyHistogram& getPoolSubmitLatency(int poolId);
 void freeCurrentThreadMiningMemory();
 
-void mpz_maxBest(mpz_t mpz_n);
+// split miner threads between the pools of the current config, can be called while mining
+void assignMinerThreadsToPools();
+int minerThreadPool(int minerID);
+int nMinerThreadsOnPool(int poolId);
 
-// in updateThread.cpp
-extern std::mutex s_workParams_mutex;
+void mpz_maxBest(mpz_t mpz_n);
+uint32_t version2memcost(int version);
 
 bool generateAquaSeed(
 	uint64_t nonce,
 	std::string workHashHex,
 	Bytes& seed);
+void updateAquaSeed(
+	uint64_t nonce,
+	Bytes& seed);
 
 inline void mpz_fromBytesNoInit(uint8_t* bytes, size_t count, mpz_t mpz_result) {
 	const int ORDER = 1;
@@ -4,8 +4,16 @@
 #include <assert.h>
 #include <vector>
 #include <sstream>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <stdlib.h>
 
-static MiningConfig s_cfg;
+// immutable snapshot, readers take a reference on it, writers swap a new one
+static std::shared_ptr<const MiningConfig> s_cfg = std::make_shared<MiningConfig>();
+static std::atomic<uint32_t> s_cfgGeneration = { 0 };
+static std::mutex s_cfgUpdate_mutex;
 
 // TODO: read from https://aquachain.github.io/pools.json
 const std::vector<std::string> POOLS = {
@@ -19,11 +27,21 @@ const std::vector<std::string> POOLS = {
 };
 
 void initMiningConfig() {
-	s_cfg.defaultSubmitWorkUrl = "http://127.0.0.1:8543";
-	s_cfg.getWorkUrl = s_cfg.defaultSubmitWorkUrl;
-	s_cfg.soloMine = false;
-	s_cfg.nThreads = 0;
-	s_cfg.refreshRateMs = 3000;
+	MiningConfig cfg;
+	cfg.defaultSubmitWorkUrl = "http://127.0.0.1:8543";
+	cfg.getWorkUrl = cfg.defaultSubmitWorkUrl;
+	cfg.soloMine = false;
+	cfg.nThreads = 0;
+	cfg.refreshRateMs = 3000;
+	cfg.metricsPort = 0;
+	cfg.controlPort = 0;
+	cfg.perfCounters = false;
+	cfg.background = false;
+	cfg.autotune = false;
+	cfg.bench = false;
+	cfg.validateRate = DEFAULT_VALIDATE_RATE;
+	cfg.watchdogAction = WATCHDOG_ACTION_NONE;
+	std::atomic_store(&s_cfg, std::shared_ptr<const MiningConfig>(std::make_shared<MiningConfig>(cfg)));
 }
 
 
@@ -37,10 +55,108 @@ void setMiningConfig(MiningConfig cfg) {
 		cfg.fullNodeUrl = cfg.submitWorkUrl;
 	}
 
+	// main pool is getWorkUrl, extra pools only make sense for pool mining
+	if (cfg.pools.empty()) {
+		cfg.pools.push_back({ cfg.getWorkUrl, 1 });
+	}
+	cfg.pools[0].url = cfg.getWorkUrl;
+	if (cfg.soloMine && cfg.pools.size() > 1) {
+		logLine("CONF", "Warning: solo mining, ignoring %d extra pools", (int)cfg.pools.size() - 1);
+		cfg.pools.resize(1);
+	}
+	if (cfg.pools.size() > (size_t)MAX_POOLS) {
+		logLine("CONF", "Warning: only %d pools can be mined at the same time", MAX_POOLS);
+		cfg.pools.resize(MAX_POOLS);
+	}
+
 	// set globally
-	s_cfg = cfg;
+	std::atomic_store(&s_cfg, std::shared_ptr<const MiningConfig>(std::make_shared<MiningConfig>(cfg)));
+	s_cfgGeneration++;
+}
+
+MiningConfig miningConfig() {
+	return *std::atomic_load(&s_cfg);
+}
+
+uint32_t miningConfigGeneration() {
+	return s_cfgGeneration;
+}
+
+std::mutex& miningConfigUpdateMutex() {
+	return s_cfgUpdate_mutex;
+}
+
+bool parsePoolList(const std::string& s, std::vector<PoolConfig>& pools) {
+	std::vector<PoolConfig> res;
+	std::stringstream ss(s);
+	std::string item;
+	while (std::getline(ss, item, ',')) {
+		if (item.size() == 0) {
+			continue;
+		}
+		PoolConfig pool = { item, 1 };
+		// optional "weight:" prefix, urls always start with a scheme so no ambiguity
+		auto sep = item.find(':');
+		if (sep != std::string::npos && sep > 0 &&
+			item.find_first_not_of("0123456789") == sep) {
+			pool.weight = (uint32_t)strtoul(item.substr(0, sep).c_str(), nullptr, 10);
+			pool.url = item.substr(sep + 1);
+		}
+		if (pool.url.size() == 0) {
+			return false;
+		}
+		res.push_back(pool);
+	}
+	if (res.empty()) {
+		return false;
+	}
+	pools = res;
+	return true;
+}
+
+std::string formatPoolList(const std::vector<PoolConfig>& pools) {
+	std::string res;
+	for (size_t i = 0; i < pools.size(); i++) {
+		if (i > 0) {
+			res += ",";
+		}
+		res += std::to_string(pools[i].weight) + ":" + pools[i].url;
+	}
+	return res;
 }
 
-const MiningConfig& miningConfig() {
-	return s_cfg;
+std::vector<int> splitThreadsByWeight(const std::vector<PoolConfig>& pools, int nThreads) {
+	std::vector<int> res(nThreads > 0 ? nThreads : 0, 0);
+	uint64_t totalWeight = 0;
+	for (auto &it : pools) {
+		totalWeight += it.weight;
+	}
+	if (totalWeight == 0 || nThreads <= 0) {
+		return res;
+	}
+
+	// largest remainder method
+	std::vector<int> counts(pools.size(), 0);
+	std::vector<std::pair<uint64_t, int>> remainders;
+	int assigned = 0;
+	for (size_t i = 0; i < pools.size(); i++) {
+		uint64_t share = (uint64_t)nThreads * pools[i].weight;
+		counts[i] = (int)(share / totalWeight);
+		assigned += counts[i];
+		remainders.push_back({ share % totalWeight, -(int)i });
+	}
+	std::sort(remainders.rbegin(), remainders.rend());
+	for (size_t i = 0; assigned < nThreads; i++) {
+		counts[-remainders[i % remainders.size()].second]++;
+		assigned++;
+	}
+
+	// contiguous thread ranges per pool
+	int t = 0;
+	for (size_t i = 0; i < pools.size(); i++) {
+		for (int k = 0; k < counts[i]; k++) {
+			res[t++] = (int)i;
+		}
+	}
+	return res;
 }
@@ -1,8 +1,24 @@
 #pragma once
 
+#include "log.h"
+#include "watchdog.h"
+#include "topology.h"
+#include "intensity.h"
+#include "validator.h"
+
 #include <string>
+#include <vector>
+#include <mutex>
 #include <stdint.h>
 
+// max number of pools mined at the same time
+const int MAX_POOLS = 8;
+
+struct PoolConfig {
+	std::string url;
+	uint32_t weight; // share of miner threads, relative to other pools
+};
+
 struct MiningConfig {
 	bool soloMine;
 	uint32_t nThreads;
@@ -14,10 +30,66 @@ struct MiningConfig {
 	std::string fullNodeUrl;
 
 	std::string defaultSubmitWorkUrl;
+
+	// prometheus endpoint port, 0 = disabled
+	uint32_t metricsPort;
+
+	// local JSON-RPC control API port (loopback only), 0 = disabled
+	uint32_t controlPort;
+
+	// shared memory stats segment name (/dev/shm/<name>), empty = disabled
+	std::string shmStatsName;
+
+	// per miner thread hardware counters (Linux perf_event_open)
+	bool perfCounters;
+
+	// what the watchdog does with slow / stalled miner threads
+	WatchdogAction watchdogAction;
+
+	// throughput cap (--intensity)
+	Intensity intensity;
+
+	// idle priority & pressure based backoff (--background)
+	bool background;
+
+	// benchmark thread count & affinity candidates at startup, saved in tuning.cfg (--autotune)
+	bool autotune;
+
+	// offline benchmark sweep instead of mining (--bench), JSON report written to benchOutput or stdout
+	bool bench;
+	std::string benchOutput;
+
+	// share of ordinary hashes recomputed with the reference kernel (--validate), found shares are always checked
+	double validateRate;
+
+	// miner thread -> CPU placement (--affinity)
+	AffinityConfig affinity;
+
+	// asynchronous logger sinks (--log-file, --log-rotate)
+	LogConfig log;
+
+	// pools mined concurrently, pools[0] is always getWorkUrl (solo: single pool)
+	std::vector<PoolConfig> pools;
 };
 
 void initMiningConfig();
-const MiningConfig& miningConfig();
 
-// do not call that during mining, only during init !
+// returns a copy of the current config snapshot, never changes under the caller
+MiningConfig miningConfig();
+
+// swaps the config snapshot atomically, safe to call while mining
 void setMiningConfig(MiningConfig cfg);
+
+// incremented each time the config snapshot is swapped
+uint32_t miningConfigGeneration();
+
+// held by every read-modify-write of the config snapshot & the thread / pool changes applied from it
+// (control API, SIGHUP reload, cpu limits resize, autotune), so that concurrent updates are not lost
+std::mutex& miningConfigUpdateMutex();
+
+// parses "weight:url,weight:url,..." (weight optional, defaults to 1)
+bool parsePoolList(const std::string& s, std::vector<PoolConfig>& pools);
+std::string formatPoolList(const std::vector<PoolConfig>& pools);
+
+// pool index of each miner thread, threads split between pools according to their weights
+std::vector<int> splitThreadsByWeight(const std::vector<PoolConfig>& pools, int nThreads);
@@ -0,0 +1,205 @@
+#include "perfCounters.h"
+#include "miner.h"
+#include "miningConfig.h"
+#include "log.h"
+
+#ifdef __linux__
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#include <string.h>
+#include <mutex>
+#include <atomic>
+
+enum PerfCounter {
+	PERF_CYCLES,
+	PERF_INSTRUCTIONS,
+	PERF_L1D_MISSES,
+	PERF_L2_MISSES,   // no generic L2 event: LLC read accesses, i.e. L2 read misses
+	PERF_LLC_MISSES,
+	PERF_DTLB_MISSES,
+	PERF_N_COUNTERS
+};
+
+static const char* PERF_COUNTER_NAMES[PERF_N_COUNTERS] = {
+	"cycles", "instructions", "L1D", "L2", "LLC", "dTLB"
+};
+
+static uint64_t hwCacheConfig(uint64_t cache, uint64_t op, uint64_t result) {
+	return cache | (op << 8) | (result << 16);
+}
+
+struct PerfThread {
+	bool active = false;
+	int fds[PERF_N_COUNTERS];
+	clockid_t cpuClock;
+	// values at last report
+	uint64_t lastCounters[PERF_N_COUNTERS];
+	uint64_t lastCpuNs = 0;
+	uint64_t lastHashes = 0;
+};
+
+// slots are only touched under s_perf_mutex: thread start / stop & periodic report, never per hash
+static std::mutex s_perf_mutex;
+static PerfThread s_perfThreads[MAX_MINER_THREADS];
+static std::atomic<bool> s_perfUnavailableLogged(false);
+
+static int openCounter(uint32_t type, uint64_t config) {
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = 0;
+	attr.exclude_kernel = 1; // allowed with perf_event_paranoid <= 2
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	// current thread, any cpu
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+// scaled for multiplexing, 0 if the counter is not available
+static uint64_t readCounter(int fd) {
+	if (fd < 0) {
+		return 0;
+	}
+	uint64_t values[3] = { 0, 0, 0 };
+	if (read(fd, values, sizeof(values)) != sizeof(values) || values[2] == 0) {
+		return 0;
+	}
+	return (uint64_t)((double)values[0] * values[1] / values[2]);
+}
+
+static uint64_t readCpuNs(clockid_t clock) {
+	struct timespec ts;
+	if (clock_gettime(clock, &ts) != 0) {
+		return 0;
+	}
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void perfThreadStart(int minerID) {
+	if (!miningConfig().perfCounters) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(s_perf_mutex);
+	PerfThread& t = s_perfThreads[minerID];
+
+	t.fds[PERF_CYCLES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+	int cyclesErrno = errno;
+	t.fds[PERF_INSTRUCTIONS] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+	t.fds[PERF_L1D_MISSES] = openCounter(PERF_TYPE_HW_CACHE, hwCacheConfig(
+		PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+	t.fds[PERF_L2_MISSES] = openCounter(PERF_TYPE_HW_CACHE, hwCacheConfig(
+		PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_ACCESS));
+	t.fds[PERF_LLC_MISSES] = openCounter(PERF_TYPE_HW_CACHE, hwCacheConfig(
+		PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+	t.fds[PERF_DTLB_MISSES] = openCounter(PERF_TYPE_HW_CACHE, hwCacheConfig(
+		PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS));
+
+	if (t.fds[PERF_CYCLES] < 0 && !s_perfUnavailableLogged.exchange(true)) {
+		logLine("PERF", "Warning: hardware counters unavailable (%s), reporting CPU time only", strerror(cyclesErrno));
+	}
+
+	// CPU time of this thread, readable by the reporting thread
+	if (pthread_getcpuclockid(pthread_self(), &t.cpuClock) != 0) {
+		t.cpuClock = CLOCK_THREAD_CPUTIME_ID;
+	}
+	for (int i = 0; i < PERF_N_COUNTERS; i++) {
+		t.lastCounters[i] = readCounter(t.fds[i]);
+	}
+	t.lastCpuNs = readCpuNs(t.cpuClock);
+	t.lastHashes = getThreadHashes(minerID);
+	t.active = true;
+}
+
+void perfThreadStop(int minerID) {
+	std::lock_guard<std::mutex> lock(s_perf_mutex);
+	PerfThread& t = s_perfThreads[minerID];
+	if (!t.active) {
+		return;
+	}
+	for (int i = 0; i < PERF_N_COUNTERS; i++) {
+		if (t.fds[i] >= 0) {
+			close(t.fds[i]);
+		}
+		t.fds[i] = -1;
+	}
+	t.active = false;
+}
+
+void reportPerfCounters(const char* logPrefix) {
+	std::lock_guard<std::mutex> lock(s_perf_mutex);
+	bool header = false;
+	for (int id = 0; id < MAX_MINER_THREADS; id++) {
+		PerfThread& t = s_perfThreads[id];
+		if (!t.active) {
+			continue;
+		}
+
+		uint64_t delta[PERF_N_COUNTERS];
+		for (int i = 0; i < PERF_N_COUNTERS; i++) {
+			uint64_t v = readCounter(t.fds[i]);
+			delta[i] = v - t.lastCounters[i];
+			t.lastCounters[i] = v;
+		}
+		uint64_t cpuNs = readCpuNs(t.cpuClock);
+		uint64_t hashes = getThreadHashes(id);
+		double cpuS = (cpuNs - t.lastCpuNs) / 1e9;
+		uint64_t nHashes = hashes - t.lastHashes;
+		t.lastCpuNs = cpuNs;
+		t.lastHashes = hashes;
+
+		if (!header) {
+			header = true;
+			logLine(logPrefix, "  thread | H/cpu-s |  GHz |  IPC | miss/hash %5s %5s %5s %5s",
+				PERF_COUNTER_NAMES[PERF_L1D_MISSES], PERF_COUNTER_NAMES[PERF_L2_MISSES],
+				PERF_COUNTER_NAMES[PERF_LLC_MISSES], PERF_COUNTER_NAMES[PERF_DTLB_MISSES]);
+		}
+
+		char line[256];
+		size_t n = snprintf(line, sizeof(line), "  MN%02d   | %7.1f |", id, cpuS > 0 ? nHashes / cpuS : 0.0);
+		if (t.fds[PERF_CYCLES] < 0) {
+			snprintf(line + n, sizeof(line) - n, "  n/a |  n/a |");
+			logLine(logPrefix, "%s", line);
+			continue;
+		}
+		n += snprintf(line + n, sizeof(line) - n, " %4.2f | %4.2f |          ",
+			cpuS > 0 ? delta[PERF_CYCLES] / cpuS / 1e9 : 0.0,
+			delta[PERF_CYCLES] > 0 ? (double)delta[PERF_INSTRUCTIONS] / delta[PERF_CYCLES] : 0.0);
+		const PerfCounter MISSES[] = { PERF_L1D_MISSES, PERF_L2_MISSES, PERF_LLC_MISSES, PERF_DTLB_MISSES };
+		for (auto c : MISSES) {
+			if (t.fds[c] < 0 || nHashes == 0) {
+				n += snprintf(line + n, sizeof(line) - n, " %5s", "n/a");
+			}
+			else {
+				n += snprintf(line + n, sizeof(line) - n, " %5.0f", (double)delta[c] / nHashes);
+			}
+		}
+		logLine(logPrefix, "%s", line);
+	}
+}
+
+#else
+
+#include <atomic>
+
+void perfThreadStart(int minerID) {
+	static std::atomic<bool> s_logged(false);
+	if (miningConfig().perfCounters && !s_logged.exchange(true)) {
+		logLine("PERF", "Warning: hardware counters are only supported on Linux");
+	}
+}
+
+void perfThreadStop(int minerID) {
+}
+
+void reportPerfCounters(const char* logPrefix) {
+}
+
+#endif
@@ -0,0 +1,12 @@
+#pragma once
+
+// optional per miner thread hardware counters (--perf-counters, Linux perf_event_open)
+// cycles, instructions, L1D / L2 / LLC / dTLB misses + thread CPU time
+// when perf events are not available (containers, perf_event_paranoid, other OSes) only CPU time is reported
+
+// called by each miner thread on itself, at start / exit
+void perfThreadStart(int minerID);
+void perfThreadStop(int minerID);
+
+// logs IPC, misses per hash, hashes per CPU second & effective GHz since the previous report
+void reportPerfCounters(const char* logPrefix);
@@ -0,0 +1,195 @@
+#include "profiler.h"
+#include "log.h"
+
+#if AQUA_PROFILE
+
+#include "miner.h"
+#include "../phc-winner-argon2/src/core.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <stdio.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define HAVE_RDTSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC
+#else
+#include <time.h>
+#endif
+
+struct ProfileCounter {
+	std::atomic<uint64_t> ticks;
+	std::atomic<uint64_t> count;
+};
+
+// one cache line block per miner thread, written by its owner only
+struct alignas(64) ProfileThreadCounters {
+	ProfileCounter stages[PROF_N_STAGES];
+};
+static ProfileThreadCounters s_profile[MAX_MINER_THREADS];
+thread_local int t_profileThread = -1;
+
+static const char* PROFILE_STAGE_NAMES[PROF_N_STAGES] = {
+	"work snapshot",
+	"seed update",
+	"memory alloc",
+	"H0",
+	"first blocks",
+	"fill indep.",
+	"fill dep.",
+	"final tag",
+	"mpz import",
+	"target cmp"
+};
+
+uint64_t profileTicks() {
+#ifdef HAVE_RDTSC
+	return __rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+// ticks per ns, measured once against the steady clock
+static double ticksPerNs() {
+	static double s_ticksPerNs = 0;
+	if (s_ticksPerNs == 0) {
+#ifdef HAVE_RDTSC
+		auto t0 = std::chrono::steady_clock::now();
+		uint64_t c0 = profileTicks();
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		uint64_t c1 = profileTicks();
+		std::chrono::duration<double, std::nano> ns = std::chrono::steady_clock::now() - t0;
+		s_ticksPerNs = (double)(c1 - c0) / ns.count();
+#else
+		s_ticksPerNs = 1.0;
+#endif
+	}
+	return s_ticksPerNs;
+}
+
+void profileSetThread(int minerID) {
+	t_profileThread = minerID;
+}
+
+void profileAdd(ProfileStage stage, uint64_t ticks) {
+	if (t_profileThread < 0) {
+		return;
+	}
+	ProfileCounter& c = s_profile[t_profileThread].stages[stage];
+	c.ticks.store(c.ticks.load(std::memory_order_relaxed) + ticks, std::memory_order_relaxed);
+	c.count.store(c.count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+// argon2_ctx() of the reference implementation, split in phases (single thread, ARGON2_NO_THREADS)
+int argon2_ctx_profiled(argon2_context* context, argon2_type type) {
+	int result = validate_inputs(context);
+	if (result != ARGON2_OK) {
+		return result;
+	}
+
+	uint32_t memory_blocks = context->m_cost;
+	if (memory_blocks < 2 * ARGON2_SYNC_POINTS * context->lanes) {
+		memory_blocks = 2 * ARGON2_SYNC_POINTS * context->lanes;
+	}
+	uint32_t segment_length = memory_blocks / (context->lanes * ARGON2_SYNC_POINTS);
+	memory_blocks = segment_length * (context->lanes * ARGON2_SYNC_POINTS);
+
+	argon2_instance_t instance;
+	instance.version = context->version;
+	instance.memory = NULL;
+	instance.passes = context->t_cost;
+	instance.memory_blocks = memory_blocks;
+	instance.segment_length = segment_length;
+	instance.lane_length = segment_length * ARGON2_SYNC_POINTS;
+	instance.lanes = context->lanes;
+	instance.threads = context->threads > context->lanes ? context->lanes : context->threads;
+	instance.type = type;
+	instance.print_internals = 0;
+	instance.context_ptr = context;
+
+	PROFILE_BEGIN(tMemory);
+	result = allocate_memory(context, (uint8_t**)&(instance.memory), instance.memory_blocks, sizeof(block));
+	PROFILE_END(PROF_MEMORY, tMemory);
+	if (result != ARGON2_OK) {
+		return result;
+	}
+
+	uint8_t blockhash[ARGON2_PREHASH_SEED_LENGTH];
+	PROFILE_BEGIN(tH0);
+	initial_hash_opt_aqua(blockhash, context, type);
+	PROFILE_END(PROF_H0, tH0);
+
+	PROFILE_BEGIN(tFirstBlocks);
+	fill_first_blocks(blockhash, &instance);
+	PROFILE_END(PROF_FIRST_BLOCKS, tFirstBlocks);
+
+	for (uint32_t pass = 0; pass < instance.passes; pass++) {
+		for (uint32_t slice = 0; slice < ARGON2_SYNC_POINTS; slice++) {
+			// argon2id: first half of the first pass uses argon2i (data independent) addressing
+			bool independent = (type == Argon2_i) ||
+				(type == Argon2_id && pass == 0 && slice < ARGON2_SYNC_POINTS / 2);
+			PROFILE_BEGIN(tFill);
+			for (uint32_t lane = 0; lane < instance.lanes; lane++) {
+				argon2_position_t position;
+				position.pass = pass;
+				position.lane = lane;
+				position.slice = (uint8_t)slice;
+				position.index = 0;
+				fill_segment(&instance, position);
+			}
+			PROFILE_END(independent ? PROF_FILL_INDEPENDENT : PROF_FILL_DEPENDENT, tFill);
+		}
+	}
+
+	PROFILE_BEGIN(tFinal);
+	finalize(context, &instance);
+	PROFILE_END(PROF_FINAL_TAG, tFinal);
+	return ARGON2_OK;
+}
+
+void reportProfile(const char* logPrefix) {
+	uint64_t ticks[PROF_N_STAGES] = { 0 };
+	uint64_t counts[PROF_N_STAGES] = { 0 };
+	for (int t = 0; t < MAX_MINER_THREADS; t++) {
+		for (int s = 0; s < PROF_N_STAGES; s++) {
+			ticks[s] += s_profile[t].stages[s].ticks.load(std::memory_order_relaxed);
+			counts[s] += s_profile[t].stages[s].count.load(std::memory_order_relaxed);
+		}
+	}
+
+	// stages are per hash, except fill stages which are per slice: normalize on the number of hashes
+	uint64_t nHashes = counts[PROF_FINAL_TAG];
+	if (nHashes == 0) {
+		return;
+	}
+	uint64_t totalTicks = 0;
+	for (int s = 0; s < PROF_N_STAGES; s++) {
+		totalTicks += ticks[s];
+	}
+
+	double tpn = ticksPerNs();
+	logLine(logPrefix, "hash profile, %llu hashes, %.2f ticks/ns", (unsigned long long)nHashes, tpn);
+	logLine(logPrefix, "  %-14s | %12s | %10s | %6s", "stage", "ticks/hash", "ns/hash", "%");
+	for (int s = 0; s < PROF_N_STAGES; s++) {
+		double perHash = (double)ticks[s] / nHashes;
+		logLine(logPrefix, "  %-14s | %12.0f | %10.1f | %5.1f%%",
+			PROFILE_STAGE_NAMES[s], perHash, perHash / tpn,
+			totalTicks ? 100.0 * ticks[s] / totalTicks : 0.0);
+	}
+	double totalPerHash = (double)totalTicks / nHashes;
+	logLine(logPrefix, "  %-14s | %12.0f | %10.1f | %5.1f%%", "total", totalPerHash, totalPerHash / tpn, 100.0);
+}
+
+#else
+
+void reportProfile(const char* logPrefix) {
+}
+
+#endif
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+
+// per phase hash profiler, compiled in with AQUA_PROFILE=1 (RelProfile config, bin/aquacppminer_prof)
+// when off, the PROFILE_* macros are empty and nothing is added to the hot path
+#ifndef AQUA_PROFILE
+#define AQUA_PROFILE (0)
+#endif
+
+enum ProfileStage {
+	PROF_WORK_SNAPSHOT,    // currentWorkParams() copy
+	PROF_SEED_UPDATE,      // nonce written in the seed
+	PROF_MEMORY,           // argon2 memory allocation
+	PROF_H0,               // argon2 initial hash
+	PROF_FIRST_BLOCKS,     // first blocks expansion
+	PROF_FILL_INDEPENDENT, // data independent slices (argon2i addressing)
+	PROF_FILL_DEPENDENT,   // data dependent slices
+	PROF_FINAL_TAG,        // final blake2b (and memory release)
+	PROF_MPZ_IMPORT,       // hash to big int
+	PROF_TARGET_CMP,       // compare to target
+	PROF_N_STAGES
+};
+
+#if AQUA_PROFILE
+
+#include <argon2.h>
+
+// rdtsc on x86, CLOCK_MONOTONIC ns elsewhere
+uint64_t profileTicks();
+// owning thread only, counters are per miner thread
+void profileSetThread(int minerID);
+void profileAdd(ProfileStage stage, uint64_t ticks);
+
+// same result as argon2_ctx(), each phase timed separately
+int argon2_ctx_profiled(argon2_context* context, argon2_type type);
+
+#define PROFILE_BEGIN(var) uint64_t var = profileTicks()
+#define PROFILE_END(stage, var) profileAdd(stage, profileTicks() - var)
+
+#else
+
+#define PROFILE_BEGIN(var)
+#define PROFILE_END(stage, var)
+
+#endif
+
+// logs the per stage breakdown table, no-op when the profiler is compiled out
+void reportProfile(const char* logPrefix);
@@ -0,0 +1,207 @@
+#include "shareStats.h"
+#include "miner.h"
+#include "miningConfig.h"
+#include "updateThread.h"
+#include "log.h"
+
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <math.h>
+#include <algorithm>
+#include <assert.h>
+
+const int64_t BUCKET_MS = 60 * 1000;
+const int N_BUCKETS = 24 * 60;
+const int WINDOW_BUCKETS[SHARE_N_WINDOWS] = { 5, 60, 24 * 60 };
+// 95% two sided normal quantile
+const double CI_Z = 1.96;
+
+struct ShareBucket {
+	int64_t minute = -1; // bucket start / BUCKET_MS, -1 = empty
+	double hashes = 0;
+	double expectedShares = 0;
+	uint32_t shares[SHARE_N_OUTCOMES] = { 0 };
+	double difficulty[SHARE_N_OUTCOMES] = { 0 }; // sum of share difficulties per outcome
+};
+
+// submit threads & the reporter only, never taken by miner threads
+static std::mutex s_shareStats_mutex;
+static ShareBucket s_buckets[N_BUCKETS];
+static int64_t s_startMs = 0;
+static std::vector<uint64_t> s_threadHashesLast;
+static std::atomic<uint64_t> s_outcomeTotals[SHARE_N_OUTCOMES];
+
+static ShareBucket& currentBucket(int64_t nowMs) {
+	int64_t minute = nowMs / BUCKET_MS;
+	ShareBucket& b = s_buckets[minute % N_BUCKETS];
+	if (b.minute != minute) {
+		b = ShareBucket();
+		b.minute = minute;
+	}
+	return b;
+}
+
+const char* shareWindowName(ShareWindow window) {
+	switch (window) {
+		case SHARE_WINDOW_5M: return "5m";
+		case SHARE_WINDOW_1H: return "1h";
+		case SHARE_WINDOW_24H: return "24h";
+		default: break;
+	}
+	return "?";
+}
+
+const char* shareOutcomeName(ShareOutcome outcome) {
+	switch (outcome) {
+		case SHARE_ACCEPTED: return "accepted";
+		case SHARE_STALE: return "stale";
+		case SHARE_REJECTED: return "rejected";
+		case SHARE_LOST: return "lost";
+		default: break;
+	}
+	return "?";
+}
+
+void recordShareOutcome(ShareOutcome outcome, double difficulty) {
+	assert(outcome >= 0 && outcome < SHARE_N_OUTCOMES);
+	s_outcomeTotals[outcome]++;
+	std::lock_guard<std::mutex> lock(s_shareStats_mutex);
+	ShareBucket& b = currentBucket(steadyNowMs());
+	b.shares[outcome]++;
+	b.difficulty[outcome] += difficulty;
+}
+
+void getShareOutcomeTotals(uint64_t totals[SHARE_N_OUTCOMES]) {
+	for (int i = 0; i < SHARE_N_OUTCOMES; i++) {
+		totals[i] = s_outcomeTotals[i].load(std::memory_order_relaxed);
+	}
+}
+
+void shareStatsTick() {
+	int64_t nowMs = steadyNowMs();
+
+	// difficulty of the current work of each pool
+	double poolDifficulty[MAX_POOLS];
+	for (int i = 0; i < MAX_POOLS; i++) {
+		poolDifficulty[i] = getPoolStatus(i).active ? currentWorkParams(i).difficultyValue : 0;
+	}
+
+	double hashes = 0;
+	double expected = 0;
+	int nThreads = nMinerThreads();
+	std::lock_guard<std::mutex> lock(s_shareStats_mutex);
+	if (s_startMs == 0) {
+		s_startMs = nowMs;
+	}
+	if ((int)s_threadHashesLast.size() < nThreads) {
+		s_threadHashesLast.resize(nThreads, 0);
+	}
+	for (int i = 0; i < nThreads; i++) {
+		uint64_t n = getThreadHashes(i);
+		double delta = (double)(n - s_threadHashesLast[i]);
+		s_threadHashesLast[i] = n;
+		double difficulty = poolDifficulty[minerThreadPool(i)];
+		hashes += delta;
+		if (difficulty > 0) {
+			expected += delta / difficulty;
+		}
+	}
+
+	ShareBucket& b = currentBucket(nowMs);
+	b.hashes += hashes;
+	b.expectedShares += expected;
+}
+
+ShareWindowStats getShareWindowStats(ShareWindow window) {
+	assert(window >= 0 && window < SHARE_N_WINDOWS);
+	ShareWindowStats res = ShareWindowStats();
+	double difficulty[SHARE_N_OUTCOMES] = { 0 };
+	double hashes = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(s_shareStats_mutex);
+		int64_t nowMs = steadyNowMs();
+		int64_t minute = nowMs / BUCKET_MS;
+		int nBuckets = WINDOW_BUCKETS[window];
+		for (int64_t m = minute - nBuckets + 1; m <= minute; m++) {
+			const ShareBucket& b = s_buckets[((m % N_BUCKETS) + N_BUCKETS) % N_BUCKETS];
+			if (b.minute != m) {
+				continue;
+			}
+			hashes += b.hashes;
+			res.expectedShares += b.expectedShares;
+			for (int o = 0; o < SHARE_N_OUTCOMES; o++) {
+				res.shares[o] += b.shares[o];
+				difficulty[o] += b.difficulty[o];
+			}
+		}
+		// window starts at the first full minute, or at start
+		int64_t windowStartMs = (minute - nBuckets + 1) * BUCKET_MS;
+		if (s_startMs > windowStartMs) {
+			windowStartMs = s_startMs;
+		}
+		res.durationS = (nowMs - windowStartMs) / 1000.0;
+	}
+
+	if (res.durationS <= 0) {
+		return res;
+	}
+	res.localHashRate = hashes / res.durationS;
+	res.effectiveHashRate = difficulty[SHARE_ACCEPTED] / res.durationS;
+
+	// poisson: relative error of a count n is ~1/sqrt(n)
+	uint32_t nAccepted = res.shares[SHARE_ACCEPTED];
+	if (nAccepted > 0) {
+		double rel = CI_Z / sqrt((double)nAccepted);
+		res.effectiveLow = res.effectiveHashRate * std::max(0.0, 1.0 - rel);
+		res.effectiveHigh = res.effectiveHashRate * (1.0 + rel);
+	}
+
+	uint32_t nFound = 0;
+	for (int o = 0; o < SHARE_N_OUTCOMES; o++) {
+		nFound += res.shares[o];
+	}
+	res.luck = res.expectedShares > 0 ? nFound / res.expectedShares : 0;
+
+	// gap: shares credited vs hashes done, split by cause, what remains is luck
+	if (res.localHashRate > 0) {
+		res.gapPercent = 100.0 * (res.localHashRate - res.effectiveHashRate) / res.localHashRate;
+		double explained = 0;
+		for (int o = SHARE_STALE; o < SHARE_N_OUTCOMES; o++) {
+			res.gapPercentByOutcome[o] = 100.0 * (difficulty[o] / res.durationS) / res.localHashRate;
+			explained += res.gapPercentByOutcome[o];
+		}
+		res.gapPercentLuck = res.gapPercent - explained;
+	}
+	return res;
+}
+
+void reportShareStats(const char* logPrefix) {
+	for (int w = 0; w < SHARE_N_WINDOWS; w++) {
+		auto s = getShareWindowStats((ShareWindow)w);
+		if (s.localHashRate <= 0) {
+			continue;
+		}
+		// longer windows are only shown once they differ from the shorter one
+		if (w > 0 && s.durationS <= WINDOW_BUCKETS[w - 1] * BUCKET_MS / 1000.0) {
+			break;
+		}
+		if (s.shares[SHARE_ACCEPTED] == 0) {
+			logLine(logPrefix, "effective %-3s | local %.3f kH/s | no accepted share yet (%.1f expected)",
+				shareWindowName((ShareWindow)w), s.localHashRate / 1000.0, s.expectedShares);
+			continue;
+		}
+		logLine(logPrefix,
+			"effective %-3s | %.3f kH/s [%.3f-%.3f] | local %.3f kH/s | luck %.0f%% | gap %.1f%%: stale %.1f%% rejected %.1f%% lost %.1f%% luck %.1f%%",
+			shareWindowName((ShareWindow)w),
+			s.effectiveHashRate / 1000.0, s.effectiveLow / 1000.0, s.effectiveHigh / 1000.0,
+			s.localHashRate / 1000.0,
+			100.0 * s.luck,
+			s.gapPercent,
+			s.gapPercentByOutcome[SHARE_STALE],
+			s.gapPercentByOutcome[SHARE_REJECTED],
+			s.gapPercentByOutcome[SHARE_LOST],
+			s.gapPercentLuck);
+	}
+}
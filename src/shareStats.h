@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+
+// effective hash rate estimator: what the pool credits us, from share outcomes & share difficulty
+// one minute buckets, windows of 5 min / 1 h / 24 h
+
+enum ShareOutcome {
+	SHARE_ACCEPTED,
+	SHARE_STALE,    // rejected, the pool had moved to a new work meanwhile
+	SHARE_REJECTED, // rejected for another reason
+	SHARE_LOST,     // submit request failed, the pool never saw it
+	SHARE_N_OUTCOMES
+};
+
+enum ShareWindow {
+	SHARE_WINDOW_5M,
+	SHARE_WINDOW_1H,
+	SHARE_WINDOW_24H,
+	SHARE_N_WINDOWS
+};
+
+struct ShareWindowStats {
+	double durationS;          // covered time, shorter than the window right after start
+	double localHashRate;      // hashes computed / duration
+	double effectiveHashRate;  // difficulty of accepted shares / duration
+	double effectiveLow;       // ~95% confidence interval of effectiveHashRate (poisson)
+	double effectiveHigh;
+	double expectedShares;     // hashes / difficulty
+	uint32_t shares[SHARE_N_OUTCOMES];
+	double luck;               // found shares / expected shares, 0 if nothing expected yet
+	// gap between local & effective rate, in % of local rate
+	double gapPercent;
+	double gapPercentByOutcome[SHARE_N_OUTCOMES]; // SHARE_ACCEPTED entry unused
+	double gapPercentLuck;     // remainder explained by share finding variance
+};
+
+// called for each submit result
+void recordShareOutcome(ShareOutcome outcome, double difficulty);
+// called by the periodic report: adds hashes computed since last call, with the difficulty of the work of each thread
+void shareStatsTick();
+
+ShareWindowStats getShareWindowStats(ShareWindow window);
+// share outcomes since start, lock free
+void getShareOutcomeTotals(uint64_t totals[SHARE_N_OUTCOMES]);
+const char* shareWindowName(ShareWindow window);
+const char* shareOutcomeName(ShareOutcome outcome);
+
+void reportShareStats(const char* logPrefix);
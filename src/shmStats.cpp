@@ -0,0 +1,169 @@
+#include "shmStats.h"
+#include "shmStatsLayout.h"
+#include "miner.h"
+#include "miningConfig.h"
+#include "updateThread.h"
+#include "shareStats.h"
+#include "validator.h"
+#include "log.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <string.h>
+
+const char* SHM_LOG_PREFIX = "SHM ";
+
+static AquaShmStats* s_pStats = nullptr;
+static std::string s_shmName;
+#ifdef _WIN32
+static HANDLE s_hMapping = NULL;
+#endif
+
+static_assert(MAX_MINER_THREADS <= AQUA_SHM_MAX_THREADS, "shm layout too small for MAX_MINER_THREADS");
+static_assert(MAX_POOLS <= AQUA_SHM_MAX_POOLS, "shm layout too small for MAX_POOLS");
+static_assert(SHARE_N_OUTCOMES == AQUA_SHM_N_OUTCOMES, "shm layout out of sync with ShareOutcome");
+
+static uint64_t unixNowMs() {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static void* mapSegment(const std::string& name) {
+#ifdef _WIN32
+	std::string mappingName = "Local\\" + name;
+	s_hMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(AquaShmStats), mappingName.c_str());
+	if (s_hMapping == NULL) {
+		return nullptr;
+	}
+	void* p = MapViewOfFile(s_hMapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(AquaShmStats));
+	if (!p) {
+		CloseHandle(s_hMapping);
+		s_hMapping = NULL;
+	}
+	return p;
+#else
+	std::string path = "/" + name;
+	int fd = shm_open(path.c_str(), O_CREAT | O_RDWR, 0644);
+	if (fd < 0) {
+		return nullptr;
+	}
+	if (ftruncate(fd, sizeof(AquaShmStats)) != 0) {
+		close(fd);
+		shm_unlink(path.c_str());
+		return nullptr;
+	}
+	void* p = mmap(nullptr, sizeof(AquaShmStats), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		shm_unlink(path.c_str());
+		return nullptr;
+	}
+	return p;
+#endif
+}
+
+static void unmapSegment() {
+#ifdef _WIN32
+	UnmapViewOfFile(s_pStats);
+	CloseHandle(s_hMapping);
+	s_hMapping = NULL;
+#else
+	munmap(s_pStats, sizeof(AquaShmStats));
+	shm_unlink(("/" + s_shmName).c_str());
+#endif
+	s_pStats = nullptr;
+}
+
+bool startShmStats(const std::string& name, const std::string& minerVersion, const std::string& kernel) {
+	void* p = mapSegment(name);
+	if (!p) {
+		logLine(SHM_LOG_PREFIX, "Error: cannot create shared memory segment %s", name.c_str());
+		return false;
+	}
+	s_shmName = name;
+
+	// readers check magic last, so a half initialized header is never trusted
+	AquaShmStats* pStats = (AquaShmStats*)p;
+	memset(pStats, 0, sizeof(AquaShmStats));
+	pStats->layoutVersion = AQUA_SHM_LAYOUT_VERSION;
+	pStats->size = sizeof(AquaShmStats);
+#ifdef _WIN32
+	pStats->pid = (uint32_t)GetCurrentProcessId();
+#else
+	pStats->pid = (uint32_t)getpid();
+#endif
+	strncpy(pStats->minerVersion, minerVersion.c_str(), sizeof(pStats->minerVersion) - 1);
+	strncpy(pStats->kernel, kernel.c_str(), sizeof(pStats->kernel) - 1);
+	pStats->startUnixMs = unixNowMs();
+	std::atomic_thread_fence(std::memory_order_release);
+	pStats->magic = AQUA_SHM_MAGIC;
+	s_pStats = pStats;
+
+	publishShmStats();
+#ifdef _WIN32
+	logLine(SHM_LOG_PREFIX, "Publishing stats in Local\\%s", name.c_str());
+#else
+	logLine(SHM_LOG_PREFIX, "Publishing stats in /dev/shm/%s", name.c_str());
+#endif
+	return true;
+}
+
+void stopShmStats() {
+	if (!s_pStats) {
+		return;
+	}
+	unmapSegment();
+}
+
+void publishShmStats() {
+	AquaShmStats* pStats = s_pStats;
+	if (!pStats) {
+		return;
+	}
+
+	// everything is sampled before entering the write section, keeps it short for readers
+	uint64_t shares[SHARE_N_OUTCOMES];
+	getShareOutcomeTotals(shares);
+	uint64_t sharesInvalid = getValidatorStats().sharesInvalid;
+	uint64_t nowUnixMs = unixNowMs();
+	int64_t nowSteadyMs = steadyNowMs();
+	AquaShmPool pools[AQUA_SHM_MAX_POOLS];
+	memset(pools, 0, sizeof(pools));
+	for (int i = 0; i < MAX_POOLS; i++) {
+		PoolStatus st = getPoolStatus(i);
+		pools[i].active = st.active ? 1 : 0;
+		pools[i].up = st.up ? 1 : 0;
+		pools[i].workEpoch = st.workEpoch;
+		pools[i].workVersion = st.workVersion;
+		pools[i].lastWorkUnixMs = (st.lastNewWorkMs > 0) ?
+			nowUnixMs - (uint64_t)(nowSteadyMs - st.lastNewWorkMs) : 0;
+	}
+	int nThreads = nMinerThreads();
+
+	pStats->seq = pStats->seq + 1;
+	std::atomic_thread_fence(std::memory_order_release);
+	{
+		pStats->updateUnixMs = nowUnixMs;
+		pStats->nThreads = (uint32_t)nThreads;
+		pStats->paused = minerThreadsPaused() ? 1 : 0;
+		pStats->totalHashes = getTotalHashes();
+		memcpy(pStats->shares, shares, sizeof(shares));
+		pStats->sharesInvalid = sharesInvalid;
+		memcpy(pStats->pools, pools, sizeof(pools));
+		// readers only look at the first nThreads entries
+		for (int i = 0; i < nThreads; i++) {
+			pStats->threadHashes[i] = getThreadHashes(i);
+		}
+	}
+	std::atomic_thread_fence(std::memory_order_release);
+	pStats->seq = pStats->seq + 1;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string>
+
+// publishes miner counters in a shared memory segment (layout in shmStatsLayout.h)
+// so that local monitoring tools can read them without syscalls or parsing logs
+bool startShmStats(const std::string& name, const std::string& minerVersion, const std::string& kernel);
+void stopShmStats();
+
+// called periodically from the main thread (single writer)
+void publishShmStats();
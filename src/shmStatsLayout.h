@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+
+// layout of the shared memory stats segment (--shm-stats name)
+// POSIX: /dev/shm/<name>, Windows: file mapping "Local\<name>"
+// shared with external readers (see src/tools/aquastat), bump AQUA_SHM_LAYOUT_VERSION on any change
+//
+// seqlock: the miner makes seq odd, updates the fields below it, then makes seq even again
+// readers copy the struct and retry if seq was odd or changed during the copy, no syscall needed
+
+const uint32_t AQUA_SHM_MAGIC = 0x53534141; // "AASS"
+const uint32_t AQUA_SHM_LAYOUT_VERSION = 2;
+const int AQUA_SHM_MAX_THREADS = 1024;
+const int AQUA_SHM_MAX_POOLS = 8;
+const int AQUA_SHM_N_OUTCOMES = 4; // accepted, stale, rejected, lost (see ShareOutcome)
+
+struct AquaShmPool {
+	uint32_t active;        // pool has an update thread
+	uint32_t up;            // last getWork succeeded
+	uint32_t workEpoch;     // number of new works received
+	int32_t workVersion;    // aqua hash version of the current work, -1 if none yet
+	uint64_t lastWorkUnixMs; // wall clock time of the last new work, 0 if none yet
+};
+
+struct AquaShmStats {
+	// written once before the segment becomes visible
+	uint32_t magic;
+	uint32_t layoutVersion;
+	uint32_t size;           // sizeof(AquaShmStats)
+	uint32_t pid;
+	char minerVersion[16];
+	char kernel[16];         // argon2 fill kernel: SSE2, AVX, AVX2
+	uint64_t startUnixMs;
+
+	// seqlock, odd while the fields below are being written
+	volatile uint32_t seq;
+	uint32_t pad0;
+
+	uint64_t updateUnixMs;   // wall clock time of the last update
+	uint32_t nThreads;       // running miner threads
+	uint32_t paused;
+	uint64_t totalHashes;
+	uint64_t shares[AQUA_SHM_N_OUTCOMES];
+	uint64_t sharesInvalid;  // found shares not submitted, hash differs from the reference kernel
+	AquaShmPool pools[AQUA_SHM_MAX_POOLS];
+	uint64_t threadHashes[AQUA_SHM_MAX_THREADS];
+};
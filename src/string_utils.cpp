@@ -57,3 +57,27 @@ std::string trim(const std::string& s)
 {
 	return ltrim(rtrim(s));
 }
+
+std::string jsonEscape(const std::string& s)
+{
+	std::string res;
+	for (auto c : s) {
+		switch (c) {
+			case '"': res += "\\\""; break;
+			case '\\': res += "\\\\"; break;
+			case '\n': res += "\\n"; break;
+			case '\r': res += "\\r"; break;
+			case '\t': res += "\\t"; break;
+			default:
+				if ((unsigned char)c < 0x20) {
+					char buf[8];
+					snprintf(buf, sizeof(buf), "\\u%04x", (unsigned char)c);
+					res += buf;
+				}
+				else {
+					res += c;
+				}
+		}
+	}
+	return res;
+}
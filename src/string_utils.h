@@ -10,3 +10,5 @@ std::string ltrim(const std::string& s);
 std::string rtrim(const std::string& s);
 // trim from both ends
 std::string trim(const std::string& s);
+// escape a string to be embedded in a JSON string literal
+std::string jsonEscape(const std::string& s);
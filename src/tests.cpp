@@ -1,12 +1,13 @@
 #include "miner.h"
 #include "tests.h"
 #include "hex_encode_utils.h"
-#include "timer.h"
-
-#include "../phc-winner-argon2/src/core.h"
+#include "argon2ref.h"
+#include "profiler.h"
 
+#include <random>
 #include <assert.h>
 #include <inttypes.h>
+#include <string.h>
 
 #define VERBOSE_TESTS (0)
 
@@ -82,6 +83,7 @@ bool testAquaHashing() {
 	Argon2_Context ctx;
 	uint8_t rawHash[ARGON2_HASH_LEN];
 	setupAquaArgonCtx(ctx, seed, rawHash);
+	ctx.m_cost = version2memcost(2); // reference is a version 2 hash, not the current work version
 
 #if VERBOSE_TESTS	
 	printf("\n- Argon params -\n");
@@ -134,114 +136,108 @@ bool testAquaHashing() {
 	printBytes("result: ", ctx.out, ctx.outlen);
 	printf("\n---- testAquaHashing() OK ----\n\n");
 #endif
-	
-	// - mpz_import bench
-	const bool BENCH_MPZ_IMPORT = false;
-	if (BENCH_MPZ_IMPORT)
-	{
-		Timer tTotal;
-		float durationS;
-		const int N_ITER = 10000 * 1000;
-
-		// 1: 2131, 2098
-		// 2/4/8: ~1950
-		tTotal.start();
-		{
-			mpz_t mpz_res;
-			for (int i = 0; i < N_ITER; i++) {
-				mpz_fromBytes(ctx.out, ctx.outlen, mpz_res);
-			}
-		}
-		tTotal.end(durationS);
-		printf("mpz_fromBytes took %.2fms\n", durationS*1000.f);
-
-		// 1: 714, 702
-		// 2/4/8: ~550
-		tTotal.start();
-		{
-			mpz_t mpz_res;
-			mpz_init(mpz_res);
-			for (int i = 0; i < N_ITER; i++) {
-				mpz_fromBytesNoInit(ctx.out, ctx.outlen, mpz_res);
-			}		
-		}
-		tTotal.end(durationS);
-		printf("mpz_fromBytesNoInit took %.2fms\n", durationS*1000.f); 
-	}
 
+	return true;
+}
 
-	// - initial hash bench
-	const bool BENCH_INITIAL_HASH = false;
-	if (BENCH_INITIAL_HASH)
-	{
-		printf("\n\n------------ INITIAL HASH BENCH\n\n");
+// aqua hash known answers, one lane, t=1, no salt: version 2..5 -> m = 1, 16, 32, 64 KiB
+// generated with an independent RFC 9106 Argon2id implementation (checked against the RFC vector),
+// the first one is the reference of testAquaHashing() & golang/ref_argon.go
+struct HashKat {
+	int version;
+	const char* workHashHex;
+	uint64_t nonce;
+	const char* hashHex;
+};
+
+static const HashKat HASH_KATS[] = {
+	{ 2, "0xd3b5f1b47f52fdc72b1dab0b02ab352442487a1d3a43211bc4f0eb5f092403fc", 5577006791947779410ULL, "d38cb8b68d42c357ee596072e4621b5dec25f360e1b4173cb134a1752a36f4ea" },
+	{ 2, "0x0000000000000000000000000000000000000000000000000000000000000000", 0ULL, "439ceaecb2e73b2ab6327a01f185f4c82a2a64f8c4b48689d1d76f51e847c3f8" },
+	{ 2, "0x8f4a7c1e2b3d5f6a9c0e1d2f3a4b5c6d7e8f90a1b2c3d4e5f60718293a4b5c6d", 18446744073709551615ULL, "122c6393631ae143aa8a4884c2a48cd4567bd4e25a939b6d25ed2a753b51d402" },
+	{ 3, "0xd3b5f1b47f52fdc72b1dab0b02ab352442487a1d3a43211bc4f0eb5f092403fc", 5577006791947779410ULL, "3d508f2291d9e9dfd31905a111808d10cb3d88bc81562b76e2c8a89325e29105" },
+	{ 3, "0x0000000000000000000000000000000000000000000000000000000000000000", 0ULL, "3e2e9c52ed30f80fba952062bb0e2e866ff6e78da47b43535dee60942320dd08" },
+	{ 3, "0x8f4a7c1e2b3d5f6a9c0e1d2f3a4b5c6d7e8f90a1b2c3d4e5f60718293a4b5c6d", 18446744073709551615ULL, "f773dcfd0e3fea0228e5c3f09dfe0720f3b48e6dc54dc63a517a189a28c20985" },
+	{ 4, "0xd3b5f1b47f52fdc72b1dab0b02ab352442487a1d3a43211bc4f0eb5f092403fc", 5577006791947779410ULL, "a4c371b62de34b0d97c4286a1ad155958793e5e0a2e7e82441478825407a5d47" },
+	{ 4, "0x0000000000000000000000000000000000000000000000000000000000000000", 0ULL, "0e1ed275a4c917670cb1989c0bffa60f72dd8301ae651d52041e732648d6875f" },
+	{ 4, "0x8f4a7c1e2b3d5f6a9c0e1d2f3a4b5c6d7e8f90a1b2c3d4e5f60718293a4b5c6d", 18446744073709551615ULL, "e70a41e2e6b5ca19d25951c248dbdf160e18022b54f977f03ba5bf443abb90d2" },
+	{ 5, "0xd3b5f1b47f52fdc72b1dab0b02ab352442487a1d3a43211bc4f0eb5f092403fc", 5577006791947779410ULL, "a7f07645e8551c7344292b35ff77291ea7eddab13f8676b6df54c8197ed23f27" },
+	{ 5, "0x0000000000000000000000000000000000000000000000000000000000000000", 0ULL, "850899dde2099d751d0a82e7c93775ec1baa1e721aba1fc72a5084d100397d36" },
+	{ 5, "0x8f4a7c1e2b3d5f6a9c0e1d2f3a4b5c6d7e8f90a1b2c3d4e5f60718293a4b5c6d", 18446744073709551615ULL, "9166ace126f893508b962d7107f41ad3fd2a5c251f32ea2acfe97fe6b7a2f65b" },
+};
+
+// hash of every kernel this binary contains, false if one of them disagrees with the first
+static bool kernelHashes(int version, const Bytes& seed, std::vector<std::string>& names, std::vector<std::string>& hashes) {
+	uint8_t rawHash[ARGON2_HASH_LEN];
+	Argon2_Context ctx;
+	setupAquaArgonCtx(ctx, seed, rawHash);
+	ctx.m_cost = version2memcost(version);
 
-		// need seed /context / block hash to call initial_hash()
-		Bytes seed;
-		Argon2_Context ctx;
-		uint8_t rawHash[ARGON2_HASH_LEN];
-		generateAquaSeed(NONCE, WORK_HASH_HEX, seed);
-		setupAquaArgonCtx(ctx, seed, rawHash);
-
-		// setup params
-		const size_t N_ITER = 
-#ifdef _DEBUG
-			(size_t)(5 * 1e4);
-#else
-			(size_t)(50 * 1e5);
+	if (argon2_ctx(&ctx, Argon2_id) != ARGON2_OK) {
+		return false;
+	}
+	names.push_back("argon2_ctx");
+	hashes.push_back(bytesToHex(rawHash, ARGON2_HASH_LEN));
+#if AQUA_PROFILE
+	if (argon2_ctx_profiled(&ctx, Argon2_id) != ARGON2_OK) {
+		return false;
+	}
+	names.push_back("argon2_ctx_profiled");
+	hashes.push_back(bytesToHex(rawHash, ARGON2_HASH_LEN));
 #endif
-		uint8_t blockhash[ARGON2_PREHASH_SEED_LENGTH];
-		uint8_t blockhashOpt[ARGON2_PREHASH_SEED_LENGTH];
-		
-		for (int k = 0; k < 3; k++) 
-		{
-			// benchmark normal
-			Timer tTotalNormal;
-			tTotalNormal.start();
-			{
-				for (int i = 0; i < N_ITER; i++) {
-					initial_hash(blockhash, &ctx, Argon2_id);
-				}
-			}
-			float normalDurationMs = 0;
-			tTotalNormal.end(normalDurationMs);
-
-			// benchmark opt
-			Timer tTotalOpt;
-			tTotalOpt.start();
-			{
-				for (int i = 0; i < N_ITER; i++) {
-					initial_hash_opt_aqua(blockhashOpt, &ctx, Argon2_id);
-				}
-			}
-			float optDurationMs = 0;
-			tTotalOpt.end(optDurationMs);
-
-			printf("%lu iterations => %.2fms / %.2fms => %.2f%%\n",
-				(unsigned long)N_ITER,
-				normalDurationMs*1000.f,
-				optDurationMs*1000.f,
-				100.f * ((optDurationMs - normalDurationMs) / normalDurationMs));
-		}
-
-		const uint8_t refHash[ARGON2_PREHASH_SEED_LENGTH] = { 203, 25, 163, 127, 246, 90, 9, 74, 160, 254, 217, 147, 200, 118, 80, 235, 105, 20, 113, 211, 106, 228, 185, 243, 81, 25, 160, 27, 53, 226, 238, 149, 187, 104, 128, 234, 131, 241, 186, 247, 238, 251, 74, 22, 46, 218, 139, 78, 42, 59, 153, 26, 230, 129, 64, 0, 92, 155, 59, 59, 238, 167, 30, 184, };
+	if (!argon2idReference(seed.data(), seed.size(), 1, version2memcost(version), rawHash, ARGON2_HASH_LEN)) {
+		return false;
+	}
+	names.push_back("reference");
+	hashes.push_back(bytesToHex(rawHash, ARGON2_HASH_LEN));
+	return true;
+}
 
-		for (int i = 0; i < ARGON2_PREHASH_DIGEST_LENGTH; i++) {
-			if (refHash[i] != blockhash[i]) {
-				printf("VALIDATION ERROR (NORMAL) !\n");
-				exit(1);
+bool testHashKat() {
+	int nFailed = 0;
+	for (const auto& kat : HASH_KATS) {
+		Bytes seed;
+		if (!generateAquaSeed(kat.nonce, kat.workHashHex, seed)) {
+			printf("Error: KAT seed generation failed\n");
+			return false;
+		}
+		std::vector<std::string> names, hashes;
+		if (!kernelHashes(kat.version, seed, names, hashes)) {
+			printf("Error: KAT version %d, hashing failed\n", kat.version);
+			return false;
+		}
+		for (size_t k = 0; k < names.size(); k++) {
+			if (hashes[k] != kat.hashHex) {
+				printf("Error: KAT version %d, nonce %" PRIu64 ", %s\n  expected %s\n  got      %s\n",
+					kat.version, kat.nonce, names[k].c_str(), kat.hashHex, hashes[k].c_str());
+				nFailed++;
 			}
 		}
+	}
+	return nFailed == 0;
+}
 
-		for (int i = 0; i < ARGON2_PREHASH_DIGEST_LENGTH; i++) {
-			if (refHash[i] != blockhashOpt[i]) {
-				printf("VALIDATION ERROR (OPT) !\n");
-				exit(1);
+bool testHashDifferential(uint32_t nIterations, uint64_t rngSeed) {
+	std::mt19937_64 rng(rngSeed);
+	const int N_VERSIONS = 4;
+	for (uint32_t i = 0; i < nIterations; i++) {
+		int version = 2 + (int)(i % N_VERSIONS);
+		Bytes seed(40);
+		for (auto& b : seed) {
+			b = (uint8_t)rng();
+		}
+		std::vector<std::string> names, hashes;
+		if (!kernelHashes(version, seed, names, hashes)) {
+			printf("Error: differential test, hashing failed\n");
+			return false;
+		}
+		for (size_t k = 1; k < names.size(); k++) {
+			if (hashes[k] != hashes[0]) {
+				printf("Error: differential test, version %d, seed %s\n  %-20s %s\n  %-20s %s\n",
+					version, bytesToHex(seed.data(), seed.size()).c_str(),
+					names[0].c_str(), hashes[0].c_str(), names[k].c_str(), hashes[k].c_str());
+				return false;
 			}
 		}
-
-		printf("------------\n");
 	}
-
 	return true;
 }
@@ -1,3 +1,9 @@
 #pragma once
 
-bool testAquaHashing();
\ No newline at end of file
+#include <stdint.h>
+
+bool testAquaHashing();
+// known answer vectors of hash versions 2..5, checked on every kernel of the build & the portable reference
+bool testHashKat();
+// random seeds, every kernel of the build against the portable reference
+bool testHashDifferential(uint32_t nIterations, uint64_t rngSeed);
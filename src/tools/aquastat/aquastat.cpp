@@ -0,0 +1,186 @@
+// aquastat: reference reader of the aquacppminer shared memory stats (--shm-stats name)
+// usage: aquastat name [-w intervalMs]
+// one snapshot by default, -w prints hash rates computed between snapshots until killed
+
+#include "shmStatsLayout.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <utility>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* OUTCOME_NAMES[AQUA_SHM_N_OUTCOMES] = { "accepted", "stale", "rejected", "lost" };
+
+static const AquaShmStats* mapStats(const std::string& name) {
+#ifdef _WIN32
+	std::string mappingName = "Local\\" + name;
+	HANDLE h = OpenFileMappingA(FILE_MAP_READ, FALSE, mappingName.c_str());
+	if (h == NULL) {
+		return nullptr;
+	}
+	return (const AquaShmStats*)MapViewOfFile(h, FILE_MAP_READ, 0, 0, sizeof(AquaShmStats));
+#else
+	std::string path = "/" + name;
+	int fd = shm_open(path.c_str(), O_RDONLY, 0);
+	if (fd < 0) {
+		return nullptr;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(AquaShmStats)) {
+		close(fd);
+		return nullptr;
+	}
+	void* p = mmap(nullptr, sizeof(AquaShmStats), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	return (p == MAP_FAILED) ? nullptr : (const AquaShmStats*)p;
+#endif
+}
+
+// seqlock read: copy, retry if the writer was active meanwhile
+static bool readStats(const AquaShmStats* pShm, AquaShmStats& out) {
+	const int MAX_TRIES = 1000;
+	for (int i = 0; i < MAX_TRIES; i++) {
+		uint32_t seq0 = pShm->seq;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (seq0 & 1) {
+			std::this_thread::yield();
+			continue;
+		}
+		memcpy(&out, (const void*)pShm, sizeof(AquaShmStats));
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (pShm->seq == seq0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static uint64_t unixNowMs() {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static double secondsSince(uint64_t nowMs, uint64_t thenMs) {
+	return (thenMs > 0 && nowMs > thenMs) ? (nowMs - thenMs) / 1000.0 : 0.0;
+}
+
+static void printStats(const AquaShmStats& s, const AquaShmStats* pLast) {
+	uint64_t nowMs = unixNowMs();
+	double durationS = pLast ? (s.updateUnixMs - pLast->updateUnixMs) / 1000.0 : 0;
+	bool rates = pLast && durationS > 0;
+
+	printf("pid %u | %s | kernel %s | up %.0fs | updated %.1fs ago%s\n",
+		s.pid,
+		s.minerVersion,
+		s.kernel,
+		secondsSince(s.updateUnixMs, s.startUnixMs),
+		secondsSince(nowMs, s.updateUnixMs),
+		s.paused ? " | PAUSED" : "");
+
+	printf("threads %u | hashes %llu", s.nThreads, (unsigned long long)s.totalHashes);
+	if (rates) {
+		printf(" | %.2f KH/s", (s.totalHashes - pLast->totalHashes) / durationS / 1000.0);
+	}
+	printf("\n");
+
+	printf("shares");
+	for (int i = 0; i < AQUA_SHM_N_OUTCOMES; i++) {
+		printf(" | %s %llu", OUTCOME_NAMES[i], (unsigned long long)s.shares[i]);
+	}
+	printf(" | invalid %llu\n", (unsigned long long)s.sharesInvalid);
+
+	for (int i = 0; i < AQUA_SHM_MAX_POOLS; i++) {
+		const AquaShmPool& p = s.pools[i];
+		if (!p.active) {
+			continue;
+		}
+		printf("pool %d | %s | epoch %u | version %d | last work %.1fs ago\n",
+			i,
+			p.up ? "up" : "DOWN",
+			p.workEpoch,
+			p.workVersion,
+			secondsSince(nowMs, p.lastWorkUnixMs));
+	}
+
+	// hashes per thread, KH/s per thread in watch mode
+	const uint32_t PER_LINE = 8;
+	uint32_t nThreads = s.nThreads < (uint32_t)AQUA_SHM_MAX_THREADS ? s.nThreads : AQUA_SHM_MAX_THREADS;
+	for (uint32_t i = 0; i < nThreads; i += PER_LINE) {
+		printf("  t%-4u", i);
+		for (uint32_t k = i; k < nThreads && k < i + PER_LINE; k++) {
+			if (rates && k < pLast->nThreads) {
+				printf(" %8.2f", (s.threadHashes[k] - pLast->threadHashes[k]) / durationS / 1000.0);
+			}
+			else {
+				printf(" %8llu", (unsigned long long)s.threadHashes[k]);
+			}
+		}
+		printf("\n");
+	}
+}
+
+int main(int argc, char** argv) {
+	if (argc < 2 || argv[1][0] == '-') {
+		printf("usage: aquastat name [-w intervalMs]\n");
+		printf("  name : shared memory name given to aquacppminer --shm-stats\n");
+		printf("  -w   : print a snapshot & hash rates every intervalMs until killed\n");
+		return 1;
+	}
+	std::string name = argv[1];
+	int intervalMs = 0;
+	if (argc >= 4 && strcmp(argv[2], "-w") == 0) {
+		intervalMs = atoi(argv[3]);
+	}
+
+	const AquaShmStats* pShm = mapStats(name);
+	if (!pShm) {
+		printf("cannot open shared memory stats %s, is aquacppminer running with --shm-stats %s ?\n", name.c_str(), name.c_str());
+		return 1;
+	}
+	if (pShm->magic != AQUA_SHM_MAGIC) {
+		printf("%s is not an aquacppminer stats segment (or is still initializing)\n", name.c_str());
+		return 1;
+	}
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (pShm->layoutVersion != AQUA_SHM_LAYOUT_VERSION || pShm->size != sizeof(AquaShmStats)) {
+		printf("layout version %u not supported (expected %u)\n", pShm->layoutVersion, AQUA_SHM_LAYOUT_VERSION);
+		return 1;
+	}
+
+	// large struct, keep it off the stack
+	AquaShmStats* pCur = new AquaShmStats();
+	AquaShmStats* pLast = new AquaShmStats();
+	bool hasLast = false;
+	do {
+		if (!readStats(pShm, *pCur)) {
+			printf("writer busy, retrying\n");
+		}
+		else {
+			printStats(*pCur, hasLast ? pLast : nullptr);
+			std::swap(pCur, pLast);
+			hasLast = true;
+		}
+		if (intervalMs > 0) {
+			printf("\n");
+			fflush(stdout);
+			std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+		}
+	} while (intervalMs > 0);
+
+	delete pCur;
+	delete pLast;
+	return 0;
+}
@@ -0,0 +1,82 @@
+// aquacppminer_test: known answer & differential tests of the hash kernels built in this binary
+// usage: aquacppminer_test [-n iterations] [-s seed]
+// each ISA config (rel / relavx / relavx2 / relprofile) builds its own binary, run them all to cover every kernel
+// exits with 1 on the first mismatch, the failing seed is printed so the case can be replayed
+
+#include "tests.h"
+
+#include <chrono>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+// globals normally defined in main.cpp
+bool s_run = true;
+std::string s_configDir;
+int64_t s_processStartUs = 0;
+
+const uint32_t DEFAULT_ITERATIONS = 200;
+
+// kernel compiled for an ISA the host lacks: nothing to test here
+static bool buildIsaSupported(const char*& isa) {
+#if defined(__AVX2__)
+	isa = "avx2";
+#if defined(__GNUC__)
+	return __builtin_cpu_supports("avx2");
+#endif
+#elif defined(__AVX__)
+	isa = "avx";
+#if defined(__GNUC__)
+	return __builtin_cpu_supports("avx");
+#endif
+#else
+	isa = "sse";
+#endif
+	return true;
+}
+
+static void printUsage() {
+	printf("usage: aquacppminer_test [-n iterations] [-s seed]\n");
+}
+
+int main(int argc, char** argv) {
+	uint32_t nIterations = DEFAULT_ITERATIONS;
+	uint64_t rngSeed = (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "-n" && hasValue) {
+			nIterations = (uint32_t)strtoul(argv[++i], nullptr, 10);
+		}
+		else if (arg == "-s" && hasValue) {
+			rngSeed = strtoull(argv[++i], nullptr, 10);
+		}
+		else {
+			printUsage();
+			return 2;
+		}
+	}
+
+	const char* isa = "";
+	if (!buildIsaSupported(isa)) {
+		printf("%s kernel not supported by this cpu, skipped\n", isa);
+		return 0;
+	}
+
+	int nFailed = 0;
+	bool ok = testAquaHashing();
+	printf("%-14s %s\n", "reference", ok ? "OK" : "FAILED");
+	nFailed += ok ? 0 : 1;
+
+	ok = testHashKat();
+	printf("%-14s %s\n", "known answers", ok ? "OK" : "FAILED");
+	nFailed += ok ? 0 : 1;
+
+	ok = testHashDifferential(nIterations, rngSeed);
+	printf("%-14s %s (%s kernel, %u seeds, -s %" PRIu64 ")\n",
+		"differential", ok ? "OK" : "FAILED", isa, nIterations, rngSeed);
+	nFailed += ok ? 0 : 1;
+
+	return nFailed == 0 ? 0 : 1;
+}
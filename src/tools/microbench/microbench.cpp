@@ -0,0 +1,342 @@
+// aquacppminer_bench: microbenchmarks of the hashing hot path primitives, with JSON baselines
+// usage: aquacppminer_bench [-f filter] [-n samples] [--save baseline.json] [--compare baseline.json] [--threshold 5]
+// --compare exits with 1 when a primitive is slower than its baseline by more than threshold %
+// (and by more than the measurement noise), so it can gate a build
+
+#include "miner.h"
+#include "updateThread.h"
+#include "topology.h"
+#include "string_utils.h"
+
+#include "../../../phc-winner-argon2/src/core.h"
+
+#include <rapidjson/document.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// globals the miner sources expect from main.cpp
+bool s_run = true;
+std::string s_configDir;
+int64_t s_processStartUs = 0;
+
+#if defined(__AVX2__)
+const char* KERNEL = "AVX2";
+#elif defined(__AVX__)
+const char* KERNEL = "AVX";
+#else
+const char* KERNEL = "SSE2";
+#endif
+
+// same reference work as testAquaHashing() & golang/ref_argon.go
+const char* WORK_HASH_HEX = "0xd3b5f1b47f52fdc72b1dab0b02ab352442487a1d3a43211bc4f0eb5f092403fc";
+const uint64_t NONCE = 5577006791947779410ULL;
+const char* GETWORK_RESPONSE =
+	"{\"jsonrpc\":\"2.0\",\"id\":1,\"result\":["
+	"\"0xd3b5f1b47f52fdc72b1dab0b02ab352442487a1d3a43211bc4f0eb5f092403fc\","
+	"\"0x0000000000000000000000000000000000000000000000000000000000000004\","
+	"\"0x00000a7c5ac471b4787b4e1cd0d9b1c6d8e1f3a0d9a7c7c8b3e8a1d2c3b4a5f6\"]}";
+
+// each sample runs long enough for the clock resolution not to matter
+const double TARGET_SAMPLE_MS = 20.0;
+const int WARMUP_SAMPLES = 2;
+const int DEFAULT_SAMPLES = 15;
+const double DEFAULT_THRESHOLD_PCT = 5.0;
+// a regression must also be larger than this many times the combined noise (MAD)
+const double NOISE_FACTOR = 3.0;
+
+// defeats dead code elimination of results
+static volatile uint64_t s_sink = 0;
+// parsed reference work, its target is freed once all primitives ran
+static WorkParams s_work;
+
+struct BenchStats {
+	std::string name;
+	uint64_t iterations; // per sample
+	int samples;
+	double medianNs;     // per operation
+	double minNs;
+	double madNs;        // median absolute deviation
+};
+
+static double median(std::vector<double> v) {
+	std::sort(v.begin(), v.end());
+	size_t n = v.size();
+	return (n % 2) ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2.0;
+}
+
+static double runBatch(const std::function<void(uint64_t)>& fn, uint64_t iterations) {
+	auto t0 = std::chrono::steady_clock::now();
+	fn(iterations);
+	auto t1 = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(t1 - t0).count();
+}
+
+// iteration count calibrated to TARGET_SAMPLE_MS, warm up samples dropped,
+// median & MAD of the per operation time are robust to the odd preempted sample
+static BenchStats measure(const std::string& name, int nSamples, const std::function<void(uint64_t)>& fn) {
+	uint64_t iterations = 1;
+	while (runBatch(fn, iterations) < TARGET_SAMPLE_MS * 1e6 && iterations < (1ULL << 40)) {
+		iterations *= 2;
+	}
+	std::vector<double> nsPerOp;
+	for (int i = 0; i < WARMUP_SAMPLES + nSamples; i++) {
+		double ns = runBatch(fn, iterations) / iterations;
+		if (i >= WARMUP_SAMPLES) {
+			nsPerOp.push_back(ns);
+		}
+	}
+	BenchStats st;
+	st.name = name;
+	st.iterations = iterations;
+	st.samples = nSamples;
+	st.medianNs = median(nsPerOp);
+	st.minNs = *std::min_element(nsPerOp.begin(), nsPerOp.end());
+	std::vector<double> dev;
+	for (double ns : nsPerOp) {
+		dev.push_back(fabs(ns - st.medianNs));
+	}
+	st.madNs = median(dev);
+	return st;
+}
+
+struct Primitive {
+	std::string name;
+	std::function<void(uint64_t)> fn;
+};
+
+static std::vector<Primitive> primitives() {
+	static Bytes seed;
+	static uint8_t rawHash[ARGON2_HASH_LEN];
+	static Argon2_Context ctx;
+	generateAquaSeed(NONCE, WORK_HASH_HEX, seed);
+	setupAquaArgonCtx(ctx, seed, rawHash);
+	parseGetWork(GETWORK_RESPONSE, s_work);
+
+	// the optimized initial hash is only worth comparing if it computes the same thing
+	uint8_t ref[ARGON2_PREHASH_SEED_LENGTH], opt[ARGON2_PREHASH_SEED_LENGTH];
+	initial_hash(ref, &ctx, Argon2_id);
+	initial_hash_opt_aqua(opt, &ctx, Argon2_id);
+	if (memcmp(ref, opt, ARGON2_PREHASH_DIGEST_LENGTH) != 0) {
+		printf("Error: initial_hash_opt_aqua does not match initial_hash\n");
+		exit(2);
+	}
+
+	std::vector<Primitive> list;
+	const int VERSIONS[] = { 2, 3, 4, 5 };
+	for (int version : VERSIONS) {
+		std::string name = "argon2_ctx/m=" + std::to_string(version2memcost(version));
+		list.push_back({ name, [version](uint64_t n) {
+			ctx.m_cost = version2memcost(version);
+			uint64_t nonce = NONCE;
+			for (uint64_t i = 0; i < n; i++) {
+				updateAquaSeed(nonce++, seed);
+				argon2_ctx(&ctx, Argon2_id);
+				s_sink += rawHash[0];
+			}
+		} });
+	}
+	list.push_back({ "initial_hash", [](uint64_t n) {
+		uint8_t blockhash[ARGON2_PREHASH_SEED_LENGTH];
+		for (uint64_t i = 0; i < n; i++) {
+			initial_hash(blockhash, &ctx, Argon2_id);
+			s_sink += blockhash[0];
+		}
+	} });
+	list.push_back({ "initial_hash_opt_aqua", [](uint64_t n) {
+		uint8_t blockhash[ARGON2_PREHASH_SEED_LENGTH];
+		for (uint64_t i = 0; i < n; i++) {
+			initial_hash_opt_aqua(blockhash, &ctx, Argon2_id);
+			s_sink += blockhash[0];
+		}
+	} });
+	list.push_back({ "mpz_fromBytes", [](uint64_t n) {
+		for (uint64_t i = 0; i < n; i++) {
+			mpz_t mpz_res;
+			mpz_fromBytes(rawHash, ARGON2_HASH_LEN, mpz_res);
+			s_sink += mpz_size(mpz_res);
+			mpz_clear(mpz_res);
+		}
+	} });
+	list.push_back({ "mpz_fromBytesNoInit", [](uint64_t n) {
+		mpz_t mpz_res;
+		mpz_init(mpz_res);
+		for (uint64_t i = 0; i < n; i++) {
+			mpz_fromBytesNoInit(rawHash, ARGON2_HASH_LEN, mpz_res);
+			s_sink += mpz_size(mpz_res);
+		}
+		mpz_clear(mpz_res);
+	} });
+	list.push_back({ "mpz_cmp_target", [](uint64_t n) {
+		mpz_t mpz_res;
+		mpz_init(mpz_res);
+		mpz_fromBytesNoInit(rawHash, ARGON2_HASH_LEN, mpz_res);
+		for (uint64_t i = 0; i < n; i++) {
+			s_sink += mpz_cmp(mpz_res, s_work.mpz_target) < 0;
+		}
+		mpz_clear(mpz_res);
+	} });
+	list.push_back({ "updateAquaSeed", [](uint64_t n) {
+		uint64_t nonce = NONCE;
+		for (uint64_t i = 0; i < n; i++) {
+			updateAquaSeed(nonce++, seed);
+			s_sink += seed[32];
+		}
+	} });
+	// currentWorkParams() as called by miner threads on each hash, on a pool holding the parsed work
+	publishPoolWork(0, s_work);
+	list.push_back({ "work_snapshot", [](uint64_t n) {
+		for (uint64_t i = 0; i < n; i++) {
+			WorkParams p = currentWorkParams(0);
+			s_sink += p.hash.size();
+		}
+	} });
+	// new work path: parse, target & difficulty
+	list.push_back({ "getwork_json_parse", [](uint64_t n) {
+		for (uint64_t i = 0; i < n; i++) {
+			WorkParams p;
+			if (parseGetWork(GETWORK_RESPONSE, p)) {
+				mpz_clear(p.mpz_target);
+			}
+			s_sink += p.version;
+		}
+	} });
+	return list;
+}
+
+static std::string toJson(const std::vector<BenchStats>& results) {
+	std::string model, microcode;
+	cpuModelInfo(model, microcode);
+	char buf[512];
+	std::string s = "{\"kernel\":\"" + std::string(KERNEL) + "\",\"cpu\":\"" + jsonEscape(model) + "\",\"results\":[\n";
+	for (size_t i = 0; i < results.size(); i++) {
+		const auto& r = results[i];
+		snprintf(buf, sizeof(buf), "  {\"name\":\"%s\",\"nsPerOp\":%.3f,\"minNs\":%.3f,\"madNs\":%.3f,\"samples\":%d,\"iterations\":%llu}%s\n",
+			r.name.c_str(), r.medianNs, r.minNs, r.madNs, r.samples, (unsigned long long)r.iterations,
+			(i + 1 < results.size()) ? "," : "");
+		s += buf;
+	}
+	s += "]}\n";
+	return s;
+}
+
+static bool readFile(const std::string& path, std::string& content) {
+	FILE* f = fopen(path.c_str(), "rb");
+	if (!f) {
+		return false;
+	}
+	char buf[4096];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+		content.append(buf, n);
+	}
+	fclose(f);
+	return true;
+}
+
+// false if at least one primitive regressed past the threshold
+static bool compareToBaseline(const std::string& path, const std::vector<BenchStats>& results, double thresholdPct) {
+	std::string content;
+	rapidjson::Document doc;
+	if (!readFile(path, content) || doc.Parse(content.c_str()).HasParseError() ||
+		!doc.IsObject() || !doc.HasMember("results") || !doc["results"].IsArray()) {
+		printf("Error: cannot read baseline %s\n", path.c_str());
+		return false;
+	}
+	if (doc.HasMember("kernel") && doc["kernel"].IsString() && strcmp(doc["kernel"].GetString(), KERNEL) != 0) {
+		printf("Warning: baseline kernel %s, this build %s\n", doc["kernel"].GetString(), KERNEL);
+	}
+
+	bool ok = true;
+	printf("\n%-24s %12s %12s %8s\n", "primitive", "baseline ns", "current ns", "change");
+	for (const auto& r : results) {
+		const rapidjson::Value* base = nullptr;
+		for (const auto& b : doc["results"].GetArray()) {
+			if (b.HasMember("name") && b["name"].IsString() && r.name == b["name"].GetString()) {
+				base = &b;
+			}
+		}
+		if (!base || !(*base).HasMember("nsPerOp") || !(*base)["nsPerOp"].IsNumber()) {
+			printf("%-24s %12s %12.1f\n", r.name.c_str(), "-", r.medianNs);
+			continue;
+		}
+		double baseNs = (*base)["nsPerOp"].GetDouble();
+		double baseMad = ((*base).HasMember("madNs") && (*base)["madNs"].IsNumber()) ? (*base)["madNs"].GetDouble() : 0;
+		double changePct = 100.0 * (r.medianNs - baseNs) / baseNs;
+		bool regressed = changePct > thresholdPct && (r.medianNs - baseNs) > NOISE_FACTOR * (r.madNs + baseMad);
+		ok = ok && !regressed;
+		printf("%-24s %12.1f %12.1f %+7.1f%%%s\n", r.name.c_str(), baseNs, r.medianNs, changePct, regressed ? "  REGRESSION" : "");
+	}
+	return ok;
+}
+
+static void printUsage() {
+	printf("usage: aquacppminer_bench [-f filter] [-n samples] [--save baseline.json] [--compare baseline.json] [--threshold pct]\n");
+}
+
+int main(int argc, char** argv) {
+	std::string filter, savePath, comparePath;
+	int nSamples = DEFAULT_SAMPLES;
+	double thresholdPct = DEFAULT_THRESHOLD_PCT;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "-f" && hasValue) {
+			filter = argv[++i];
+		}
+		else if (arg == "-n" && hasValue) {
+			nSamples = std::max(3, atoi(argv[++i]));
+		}
+		else if (arg == "--save" && hasValue) {
+			savePath = argv[++i];
+		}
+		else if (arg == "--compare" && hasValue) {
+			comparePath = argv[++i];
+		}
+		else if (arg == "--threshold" && hasValue) {
+			thresholdPct = atof(argv[++i]);
+		}
+		else {
+			printUsage();
+			return 2;
+		}
+	}
+
+	std::vector<BenchStats> results;
+	printf("%-24s %12s %10s %10s %12s\n", "primitive", "median ns", "min ns", "mad ns", "iterations");
+	for (const auto& p : primitives()) {
+		if (filter.size() && p.name.find(filter) == std::string::npos) {
+			continue;
+		}
+		BenchStats st = measure(p.name, nSamples, p.fn);
+		printf("%-24s %12.1f %10.1f %10.1f %12llu\n",
+			st.name.c_str(), st.medianNs, st.minNs, st.madNs, (unsigned long long)st.iterations);
+		fflush(stdout);
+		results.push_back(st);
+	}
+	mpz_clear(s_work.mpz_target);
+
+	if (savePath.size()) {
+		FILE* f = fopen(savePath.c_str(), "w");
+		if (!f) {
+			printf("Error: cannot write %s\n", savePath.c_str());
+			return 2;
+		}
+		fputs(toJson(results).c_str(), f);
+		fclose(f);
+		printf("baseline saved to %s\n", savePath.c_str());
+	}
+
+	if (comparePath.size() && !compareToBaseline(comparePath, results, thresholdPct)) {
+		return 1;
+	}
+	return 0;
+}
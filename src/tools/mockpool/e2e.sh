@@ -0,0 +1,101 @@
+#!/bin/bash
+# end to end run of the miner against the local mock pool (aquacppminer_mockpool)
+# reports stale rate, submit latency percentiles & lost shares, fails if the miner sent invalid / duplicate shares
+# or if the miner & pool share counts disagree
+# usage: src/tools/mockpool/e2e.sh [seconds] [extra miner args]
+# env:   BIN=bin MINER=aquacppminer THREADS=2 PORT=18543
+#        POOL_ARGS="-v 4 -d 1 -b 5 --latency 20 --jitter 30 --drop 0.01 --stale 0.02 --reject 0.01"
+
+DURATION=${1:-30}
+shift
+BIN=${BIN:-bin}
+MINER=${MINER:-aquacppminer}
+THREADS=${THREADS:-2}
+PORT=${PORT:-18543}
+METRICS_PORT=$((PORT + 1))
+CONTROL_PORT=$((PORT + 2))
+POOL_ARGS=${POOL_ARGS:-"-v 4 -d 1 -b 5 --latency 20 --jitter 30 --drop 0.01 --stale 0.02 --reject 0.01"}
+LOG_DIR=${LOG_DIR:-.}
+
+$BIN/aquacppminer_mockpool -p $PORT $POOL_ARGS > $LOG_DIR/e2e_mockpool.log 2>&1 &
+POOL_PID=$!
+sleep 1
+if ! kill -0 $POOL_PID 2> /dev/null; then
+	echo "mock pool did not start, see $LOG_DIR/e2e_mockpool.log"
+	exit 1
+fi
+
+# -n: the pool is also the node, exercises aqua_getBlockByNumber
+$BIN/$MINER -F http://127.0.0.1:$PORT/0x0000000000000000000000000000000000000000 -n http://127.0.0.1:$PORT/ -t $THREADS \
+	--metrics-port $METRICS_PORT --control-port $CONTROL_PORT "$@" > $LOG_DIR/e2e_miner.log 2>&1 &
+MINER_PID=$!
+sleep $DURATION
+
+# stop hashing & let in-flight submits land so that both sides count the same shares
+curl -s -H 'Content-Type: application/json' -d '{"jsonrpc":"2.0","id":1,"method":"pause"}' http://127.0.0.1:$CONTROL_PORT/ > /dev/null
+sleep 3
+METRICS=$(curl -s http://127.0.0.1:$METRICS_PORT/metrics)
+STATS=$(curl -s http://127.0.0.1:$PORT/stats)
+kill -INT $MINER_PID
+wait $MINER_PID
+kill -INT $POOL_PID
+wait $POOL_PID
+
+if [ -z "$METRICS" ] || [ -z "$STATS" ]; then
+	echo "no metrics / stats, see $LOG_DIR/e2e_miner.log & $LOG_DIR/e2e_mockpool.log"
+	exit 1
+fi
+
+pool() {
+	echo "$STATS" | sed -n "s/.*\"$1\":\([0-9]*\).*/\1/p"
+}
+miner() {
+	echo "$METRICS" | awk -v m="$1" '$1 == m { printf "%d", $2 }'
+}
+# upper bound of the bucket holding the percentile, in ms
+submitLatencyMs() {
+	echo "$METRICS" | awk -v p="$1" '
+		/^aquacppminer_submit_latency_seconds_bucket\{pool="0"/ {
+			match($1, /le="[^"]*"/)
+			le = substr($1, RSTART + 4, RLENGTH - 5)
+			n++; les[n] = le; counts[n] = $2
+		}
+		END {
+			if (n == 0 || counts[n] == 0) { print "-"; exit }
+			for (i = 1; i <= n; i++) {
+				if (counts[i] >= p * counts[n]) {
+					if (les[i] == "+Inf") { print "inf" } else { printf "%g", les[i] * 1000 }
+					exit
+				}
+			}
+		}'
+}
+
+SENT_ACCEPTED=$(miner 'aquacppminer_shares_total{pool="0",outcome="accepted"}')
+SENT_REJECTED=$(miner 'aquacppminer_shares_total{pool="0",outcome="rejected"}')
+SENT_LOST=$(miner 'aquacppminer_shares_total{pool="0",outcome="lost"}')
+SENT=$((SENT_ACCEPTED + SENT_REJECTED + SENT_LOST))
+HASHES=$(miner 'aquacppminer_hashes_total')
+
+SUBMITS=$(pool submits)
+DROPPED=$(pool dropped)
+STALE=$(($(pool stale) + $(pool staleInjected)))
+INVALID=$(pool invalid)
+DUPLICATE=$(pool duplicate)
+UNACCOUNTED=$((SENT - SUBMITS - DROPPED))
+
+echo "---- e2e: ${DURATION}s, $THREADS threads, pool: $POOL_ARGS"
+echo "hashes         : $HASHES"
+echo "shares sent    : $SENT ($(awk -v n=$SENT -v d=$DURATION 'BEGIN { printf "%.1f", n / d }')/s)"
+echo "accepted       : $SENT_ACCEPTED (pool: $(pool accepted))"
+echo "rejected       : $SENT_REJECTED (pool: stale $STALE, injected rejects $(pool rejectedInjected), invalid $INVALID, duplicate $DUPLICATE)"
+echo "stale rate     : $(awk -v s=$STALE -v n=$SUBMITS 'BEGIN { printf "%.2f%%", n ? 100 * s / n : 0 }')"
+echo "lost shares    : $SENT_LOST (pool dropped $DROPPED, unaccounted $UNACCOUNTED)"
+echo "submit latency : p50 $(submitLatencyMs 0.5) ms, p90 $(submitLatencyMs 0.9) ms, p99 $(submitLatencyMs 0.99) ms"
+echo "blocks         : height $(pool height), found $(pool blocksFound)"
+
+if [ "$INVALID" != "0" ] || [ "$DUPLICATE" != "0" ] || [ "$UNACCOUNTED" != "0" ] || [ "$SENT" == "0" ]; then
+	echo "FAILED"
+	exit 1
+fi
+echo "OK"
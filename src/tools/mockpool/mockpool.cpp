@@ -0,0 +1,452 @@
+// aquacppminer_mockpool: local Aquachain JSON-RPC pool / node for end to end tests, no network needed
+// usage: aquacppminer_mockpool [-p port] [-v version] [-d shareDifficulty] [-D blockDifficulty] [-b blockSeconds]
+//        [--latency ms] [--jitter ms] [--drop p] [--stale p] [--reject p] [--duration s] [-s seed]
+// serves aqua_getWork, aqua_submitWork & aqua_getBlockByNumber, submitted nonces are verified with the reference
+// argon2id (src/argon2ref.h), faults are injected per request: latency, dropped connections, stale & rejected answers
+// -v 5 is served too, the miner itself only parses hash versions 2 to 4 so far
+// GET /stats returns the counters as JSON, see src/tools/mockpool/e2e.sh
+
+#include "httpServer.h"
+#include "argon2ref.h"
+#include "hex_encode_utils.h"
+#include "log.h"
+
+#include <rapidjson/document.h>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+using namespace rapidjson;
+
+const char* MOCK_LOG_PREFIX = "MOCK";
+const uint16_t DEFAULT_PORT = 18543;
+// older works still known, shares on them are stale instead of invalid
+const size_t RECENT_WORKS = 8;
+const uint32_t REPORT_INTERVAL_MS = 5000;
+const size_t HASH_LEN = 32;
+
+struct MockConfig {
+	uint16_t port = DEFAULT_PORT;
+	int version = 4;
+	uint64_t shareDifficulty = 1;     // 1: every hash is a share
+	uint64_t blockDifficulty = 1000000;
+	double blockSeconds = 10;
+	uint32_t latencyMs = 0;
+	uint32_t jitterMs = 0;
+	double dropRate = 0;    // connection closed without answer, the miner loses the share
+	double staleRate = 0;   // valid share answered as stale
+	double rejectRate = 0;  // valid share answered as rejected
+	uint32_t durationS = 0; // 0 = until ctrl+c
+	uint64_t seed = 0;
+};
+
+struct Work {
+	std::string hash; // 0x + 64 hex
+	uint64_t height;
+};
+
+struct MockStats {
+	uint64_t getWork = 0;
+	uint64_t getBlock = 0;
+	uint64_t submits = 0;         // answered submits
+	uint64_t accepted = 0;
+	uint64_t stale = 0;           // share on a previous work
+	uint64_t staleInjected = 0;
+	uint64_t rejectedInjected = 0;
+	uint64_t invalid = 0;         // hash above target or unknown work
+	uint64_t duplicate = 0;
+	uint64_t dropped = 0;         // submits dropped by fault injection
+	uint64_t blocksFound = 0;
+	uint64_t badRequests = 0;
+};
+
+static MockConfig s_cfg;
+static std::mutex s_mutex; // everything below
+static std::mt19937_64 s_rng;
+static std::deque<Work> s_works; // front: current work
+static std::set<std::string> s_submitted; // work hash + nonce of known works
+static std::chrono::steady_clock::time_point s_workStart;
+static MockStats s_stats;
+static mpz_t s_shareTarget;
+static mpz_t s_blockTarget;
+static std::atomic<bool> s_run(true);
+
+static uint32_t memCost(int version) {
+	switch (version) {
+		case 2: return 1;
+		case 3: return 16;
+		case 4: return 32;
+		case 5: return 64;
+	}
+	return 0;
+}
+
+// target = 2^256 / difficulty, like the node
+static void difficultyToTarget(uint64_t difficulty, mpz_t target) {
+	mpz_init(target);
+	mpz_ui_pow_ui(target, 2, 256);
+	mpz_t d;
+	mpz_init(d);
+	mpz_import(d, 1, 1, sizeof(difficulty), 0, 0, &difficulty);
+	mpz_fdiv_q(target, target, d);
+	mpz_clear(d);
+}
+
+static std::string hex0x(mpz_t n, int digits) {
+	char buf[128];
+	gmp_snprintf(buf, sizeof(buf), "0x%0*Zx", digits, n);
+	return buf;
+}
+
+static std::string hex0x(uint64_t v) {
+	char buf[32];
+	snprintf(buf, sizeof(buf), "0x%" PRIx64, v);
+	return buf;
+}
+
+// s_mutex held
+static void newWork() {
+	char hash[2 + 64 + 1] = "0x";
+	for (int i = 0; i < 4; i++) {
+		snprintf(hash + 2 + i * 16, 17, "%016" PRIx64, (uint64_t)s_rng());
+	}
+	uint64_t height = s_works.empty() ? 1 : s_works.front().height + 1;
+	s_works.push_front({ hash, height });
+	if (s_works.size() > RECENT_WORKS) {
+		// nonces of forgotten works can go
+		const std::string& old = s_works.back().hash;
+		s_submitted.erase(s_submitted.lower_bound(old), s_submitted.lower_bound(old + "~"));
+		s_works.pop_back();
+	}
+	s_workStart = std::chrono::steady_clock::now();
+}
+
+// s_mutex held
+static void updateWork() {
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - s_workStart;
+	if (s_cfg.blockSeconds > 0 && elapsed.count() >= s_cfg.blockSeconds) {
+		newWork();
+	}
+}
+
+// s_mutex held
+static bool chance(double p) {
+	return p > 0 && std::uniform_real_distribution<double>(0, 1)(s_rng) < p;
+}
+
+static std::string rpcResult(int id, const std::string& result) {
+	return "{\"jsonrpc\":\"2.0\",\"id\":" + std::to_string(id) + ",\"result\":" + result + "}";
+}
+
+static std::string rpcError(int id, const char* msg) {
+	return "{\"jsonrpc\":\"2.0\",\"id\":" + std::to_string(id) + ",\"error\":{\"code\":-32602,\"message\":\"" + msg + "\"}}";
+}
+
+static std::string getWork(int id) {
+	std::lock_guard<std::mutex> lock(s_mutex);
+	updateWork();
+	s_stats.getWork++;
+	// [work hash, hash version (last hex digit), share target]
+	char version[2 + 64 + 1];
+	snprintf(version, sizeof(version), "0x%064x", s_cfg.version);
+	return rpcResult(id, "[\"" + s_works.front().hash + "\",\"" + version + "\",\"" + hex0x(s_shareTarget, 64) + "\"]");
+}
+
+static std::string getBlockByNumber(int id) {
+	std::lock_guard<std::mutex> lock(s_mutex);
+	updateWork();
+	s_stats.getBlock++;
+	mpz_t difficulty;
+	mpz_init(difficulty);
+	mpz_import(difficulty, 1, 1, sizeof(s_cfg.blockDifficulty), 0, 0, &s_cfg.blockDifficulty);
+	std::string block = "{\"number\":\"" + hex0x(s_works.front().height) + "\""
+		",\"hash\":\"" + s_works.front().hash + "\""
+		",\"difficulty\":\"" + hex0x(difficulty, 1) + "\""
+		",\"miner\":\"0x0000000000000000000000000000000000000000\""
+		",\"nonce\":\"0x0000000000000000\""
+		",\"version\":" + std::to_string(s_cfg.version) + "}";
+	mpz_clear(difficulty);
+	return rpcResult(id, block);
+}
+
+// params: [nonce, work hash, mix digest]
+static std::string submitWork(int id, const Value* params, HttpResponse& resp) {
+	if (!params || !params->IsArray() || params->Size() < 2 || !(*params)[0u].IsString() || !(*params)[1u].IsString()) {
+		std::lock_guard<std::mutex> lock(s_mutex);
+		s_stats.badRequests++;
+		return rpcError(id, "expected [nonce, hash, mix]");
+	}
+	std::string nonceStr = (*params)[0u].GetString();
+	std::string workHash = (*params)[1u].GetString();
+	uint64_t nonce = strtoull(nonceStr.c_str(), nullptr, 16);
+
+	bool known = false;
+	bool current = false;
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		if (chance(s_cfg.dropRate)) {
+			s_stats.dropped++;
+			resp.drop = true;
+			return "";
+		}
+		s_stats.submits++;
+		for (size_t i = 0; i < s_works.size(); i++) {
+			if (s_works[i].hash == workHash) {
+				known = true;
+				current = i == 0;
+			}
+		}
+		if (!known) {
+			s_stats.invalid++;
+			return rpcResult(id, "false");
+		}
+		if (!s_submitted.insert(workHash + nonceStr).second) {
+			s_stats.duplicate++;
+			return rpcResult(id, "false");
+		}
+	}
+
+	// verify outside of the lock, seed = work hash + little endian nonce
+	auto hashBytes = hexToBytes(workHash);
+	if (!hashBytes.first || hashBytes.second.size() != HASH_LEN) {
+		std::lock_guard<std::mutex> lock(s_mutex);
+		s_stats.invalid++;
+		return rpcResult(id, "false");
+	}
+	Bytes seed = hashBytes.second;
+	for (int i = 0; i < 8; i++) {
+		seed.push_back((uint8_t)(nonce >> (8 * i)));
+	}
+	uint8_t hash[HASH_LEN];
+	argon2idReference(seed.data(), seed.size(), 1, memCost(s_cfg.version), hash, HASH_LEN);
+	mpz_t result;
+	mpz_init(result);
+	mpz_import(result, HASH_LEN, 1, 1, 1, 0, hash);
+	bool share = mpz_cmp(result, s_shareTarget) < 0;
+	bool block = mpz_cmp(result, s_blockTarget) < 0;
+	mpz_clear(result);
+
+	std::lock_guard<std::mutex> lock(s_mutex);
+	if (!share) {
+		s_stats.invalid++;
+		return rpcResult(id, "false");
+	}
+	if (!current) {
+		s_stats.stale++;
+		return rpcResult(id, "false");
+	}
+	if (chance(s_cfg.staleRate)) {
+		s_stats.staleInjected++;
+		return rpcResult(id, "false");
+	}
+	if (chance(s_cfg.rejectRate)) {
+		s_stats.rejectedInjected++;
+		return rpcResult(id, "false");
+	}
+	s_stats.accepted++;
+	if (block) {
+		s_stats.blocksFound++;
+		newWork();
+	}
+	return rpcResult(id, "true");
+}
+
+static std::string statsJson() {
+	std::lock_guard<std::mutex> lock(s_mutex);
+	const MockStats& st = s_stats;
+	char buf[1024];
+	snprintf(buf, sizeof(buf),
+		"{\"height\":%" PRIu64 ",\"getWork\":%" PRIu64 ",\"getBlock\":%" PRIu64 ",\"submits\":%" PRIu64
+		",\"accepted\":%" PRIu64 ",\"stale\":%" PRIu64 ",\"staleInjected\":%" PRIu64 ",\"rejectedInjected\":%" PRIu64
+		",\"invalid\":%" PRIu64 ",\"duplicate\":%" PRIu64 ",\"dropped\":%" PRIu64 ",\"blocksFound\":%" PRIu64
+		",\"badRequests\":%" PRIu64 "}\n",
+		s_works.front().height, st.getWork, st.getBlock, st.submits,
+		st.accepted, st.stale, st.staleInjected, st.rejectedInjected,
+		st.invalid, st.duplicate, st.dropped, st.blocksFound,
+		st.badRequests);
+	return buf;
+}
+
+static void injectLatency() {
+	uint32_t ms = s_cfg.latencyMs;
+	if (s_cfg.jitterMs > 0) {
+		std::lock_guard<std::mutex> lock(s_mutex);
+		ms += (uint32_t)(s_rng() % (s_cfg.jitterMs + 1));
+	}
+	if (ms > 0) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+	}
+}
+
+static void handleRequest(const HttpRequest& req, HttpResponse& resp) {
+	resp.contentType = "application/json";
+	if (req.method == "GET" && req.path == "/stats") {
+		resp.body = statsJson();
+		return;
+	}
+	if (req.method != "POST") {
+		resp.status = 405;
+		resp.body = "{}";
+		return;
+	}
+
+	Document doc;
+	doc.Parse(req.body.c_str());
+	if (!doc.IsObject() || !doc.HasMember("method") || !doc["method"].IsString()) {
+		std::lock_guard<std::mutex> lock(s_mutex);
+		s_stats.badRequests++;
+		resp.status = 400;
+		resp.body = rpcError(0, "invalid request");
+		return;
+	}
+	int id = doc.HasMember("id") && doc["id"].IsInt() ? doc["id"].GetInt() : 0;
+	std::string method = doc["method"].GetString();
+	const Value* params = doc.HasMember("params") ? &doc["params"] : nullptr;
+
+	injectLatency();
+	if (method == "aqua_getWork") {
+		resp.body = getWork(id);
+	}
+	else if (method == "aqua_submitWork") {
+		resp.body = submitWork(id, params, resp);
+	}
+	else if (method == "aqua_getBlockByNumber") {
+		resp.body = getBlockByNumber(id);
+	}
+	else {
+		resp.body = "{\"jsonrpc\":\"2.0\",\"id\":" + std::to_string(id) + ",\"error\":{\"code\":-32601,\"message\":\"method not found\"}}";
+	}
+}
+
+static void sigintHandler(int) {
+	s_run = false;
+}
+
+static void printUsage() {
+	printf("usage: aquacppminer_mockpool [-p port] [-v version] [-d shareDifficulty] [-D blockDifficulty] [-b blockSeconds]\n"
+		"       [--latency ms] [--jitter ms] [--drop p] [--stale p] [--reject p] [--duration s] [-s seed]\n");
+}
+
+static bool parseArgs(int argc, char** argv, MockConfig& cfg) {
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (i + 1 >= argc) {
+			return false;
+		}
+		const char* value = argv[++i];
+		if (arg == "-p") {
+			cfg.port = (uint16_t)atoi(value);
+		}
+		else if (arg == "-v") {
+			cfg.version = atoi(value);
+		}
+		else if (arg == "-d") {
+			cfg.shareDifficulty = strtoull(value, nullptr, 10);
+		}
+		else if (arg == "-D") {
+			cfg.blockDifficulty = strtoull(value, nullptr, 10);
+		}
+		else if (arg == "-b") {
+			cfg.blockSeconds = atof(value);
+		}
+		else if (arg == "--latency") {
+			cfg.latencyMs = (uint32_t)atoi(value);
+		}
+		else if (arg == "--jitter") {
+			cfg.jitterMs = (uint32_t)atoi(value);
+		}
+		else if (arg == "--drop") {
+			cfg.dropRate = atof(value);
+		}
+		else if (arg == "--stale") {
+			cfg.staleRate = atof(value);
+		}
+		else if (arg == "--reject") {
+			cfg.rejectRate = atof(value);
+		}
+		else if (arg == "--duration") {
+			cfg.durationS = (uint32_t)atoi(value);
+		}
+		else if (arg == "-s") {
+			cfg.seed = strtoull(value, nullptr, 10);
+		}
+		else {
+			return false;
+		}
+	}
+	return memCost(cfg.version) != 0 && cfg.shareDifficulty > 0 && cfg.blockDifficulty > 0;
+}
+
+int main(int argc, char** argv) {
+	if (!parseArgs(argc, argv, s_cfg)) {
+		printUsage();
+		return 2;
+	}
+	if (s_cfg.seed == 0) {
+		s_cfg.seed = (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+	}
+	s_rng.seed(s_cfg.seed);
+	difficultyToTarget(s_cfg.shareDifficulty, s_shareTarget);
+	difficultyToTarget(s_cfg.blockDifficulty, s_blockTarget);
+	s_mutex.lock();
+	newWork();
+	s_mutex.unlock();
+
+	signal(SIGINT, sigintHandler);
+	signal(SIGTERM, sigintHandler);
+
+	// one thread per connection: injected latency must not serialize the miner requests
+	http_server_handle_t server = startHttpServer(MOCK_LOG_PREFIX, s_cfg.port, true, handleRequest, true);
+	if (!server) {
+		return 1;
+	}
+	logLine(MOCK_LOG_PREFIX, "version %d, share difficulty %" PRIu64 ", block difficulty %" PRIu64 ", block every %.1fs, seed %" PRIu64,
+		s_cfg.version, s_cfg.shareDifficulty, s_cfg.blockDifficulty, s_cfg.blockSeconds, s_cfg.seed);
+	logLine(MOCK_LOG_PREFIX, "faults: latency %u+%u ms, drop %.3f, stale %.3f, reject %.3f",
+		s_cfg.latencyMs, s_cfg.jitterMs, s_cfg.dropRate, s_cfg.staleRate, s_cfg.rejectRate);
+
+	auto tStart = std::chrono::steady_clock::now();
+	auto tReport = tStart;
+	uint64_t lastSubmits = 0;
+	while (s_run) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		auto tNow = std::chrono::steady_clock::now();
+		{
+			std::lock_guard<std::mutex> lock(s_mutex);
+			updateWork();
+		}
+		std::chrono::duration<double> sinceReport = tNow - tReport;
+		if (sinceReport.count() * 1000 >= REPORT_INTERVAL_MS) {
+			MockStats st;
+			uint64_t height;
+			{
+				std::lock_guard<std::mutex> lock(s_mutex);
+				st = s_stats;
+				height = s_works.front().height;
+			}
+			logLine(MOCK_LOG_PREFIX, "height %" PRIu64 ", %.0f submits/s, accepted %" PRIu64 ", stale %" PRIu64 ", invalid %" PRIu64 ", dropped %" PRIu64,
+				height, (st.submits + st.dropped - lastSubmits) / sinceReport.count(), st.accepted, st.stale + st.staleInjected, st.invalid, st.dropped);
+			lastSubmits = st.submits + st.dropped;
+			tReport = tNow;
+		}
+		std::chrono::duration<double> sinceStart = tNow - tStart;
+		if (s_cfg.durationS > 0 && sinceStart.count() >= s_cfg.durationS) {
+			break;
+		}
+	}
+
+	stopHttpServer(server);
+	printf("%s", statsJson().c_str());
+	return 0;
+}
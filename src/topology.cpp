@@ -0,0 +1,600 @@
+#include "topology.h"
+#include "log.h"
+
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#include <thread>
+#include <fstream>
+#include <map>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// from linux/mempolicy.h, not always installed
+const int MPOL_PREFERRED_MODE = 1;
+
+// cpu ids past this cannot be pinned (cpu_set_t size), a typo like 0-100000000 is rejected early
+#ifdef __linux__
+const long MAX_CPU_ID = CPU_SETSIZE - 1;
+#else
+const long MAX_CPU_ID = 1023;
+#endif
+
+static std::vector<int> s_placement;
+static AffinityPolicy s_policy = AFFINITY_NONE;
+
+bool parseCpuList(const std::string& s, std::vector<int>& cpus) {
+	cpus.clear();
+	const char* p = s.c_str();
+	while (*p) {
+		char* end;
+		long first = strtol(p, &end, 10);
+		if (end == p || first < 0) {
+			return false;
+		}
+		long last = first;
+		p = end;
+		if (*p == '-') {
+			p++;
+			last = strtol(p, &end, 10);
+			if (end == p || last < first) {
+				return false;
+			}
+			p = end;
+		}
+		if (last > MAX_CPU_ID) {
+			return false;
+		}
+		for (long c = first; c <= last; c++) {
+			cpus.push_back((int)c);
+		}
+		if (*p == ',') {
+			p++;
+		}
+		else if (*p && *p != '\n') {
+			return false;
+		}
+		else {
+			break;
+		}
+	}
+	return cpus.size() > 0;
+}
+
+bool parseAffinity(const std::string& s, AffinityConfig& cfg) {
+	cfg.cpuList.clear();
+	if (s == "none") {
+		cfg.policy = AFFINITY_NONE;
+	}
+	else if (s == "cores") {
+		cfg.policy = AFFINITY_CORES;
+	}
+	else if (s == "all") {
+		cfg.policy = AFFINITY_ALL;
+	}
+	else if (parseCpuList(s, cfg.cpuList)) {
+		cfg.policy = AFFINITY_LIST;
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+#ifdef __linux__
+static bool readSysFile(const std::string& path, std::string& out) {
+	FILE* f = fopen(path.c_str(), "r");
+	if (!f) {
+		return false;
+	}
+	out.clear();
+	char buf[4096];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+		out.append(buf, n);
+	}
+	fclose(f);
+	while (out.size() && (out.back() == '\n' || out.back() == ' ')) {
+		out.pop_back();
+	}
+	return true;
+}
+
+static int readSysInt(const std::string& path, int defaultValue) {
+	std::string s;
+	if (!readSysFile(path, s) || s.empty()) {
+		return defaultValue;
+	}
+	return atoi(s.c_str());
+}
+
+// "1024K" / "32M"
+static uint32_t parseCacheSize(const std::string& s) {
+	char* end;
+	uint32_t v = (uint32_t)strtoul(s.c_str(), &end, 10);
+	if (*end == 'K') {
+		v *= 1024;
+	}
+	else if (*end == 'M') {
+		v *= 1024 * 1024;
+	}
+	return v;
+}
+
+static std::vector<std::string> splitString(const std::string& s, char sep) {
+	std::vector<std::string> parts;
+	size_t start = 0;
+	while (true) {
+		size_t end = s.find(sep, start);
+		parts.push_back(s.substr(start, end == std::string::npos ? std::string::npos : end - start));
+		if (end == std::string::npos) {
+			return parts;
+		}
+		start = end + 1;
+	}
+}
+
+static bool hasItem(const std::vector<std::string>& items, const std::string& item) {
+	return std::find(items.begin(), items.end(), item) != items.end();
+}
+
+// where the cgroup of this process is mounted for a v1 controller ("" = cgroup v2)
+struct CgroupDir {
+	std::string mount; // hierarchy mount point, top of the walk to ancestors
+	std::string dir;   // cgroup of this process, below mount
+};
+
+static bool findCgroupDir(const std::string& controller, CgroupDir& out) {
+	// "id:controllers:path" lines, v2 is "0::path"
+	std::string s, path;
+	bool found = false;
+	if (!readSysFile("/proc/self/cgroup", s)) {
+		return false;
+	}
+	for (const auto& line : splitString(s, '\n')) {
+		size_t c1 = line.find(':');
+		size_t c2 = line.find(':', c1 + 1);
+		if (c1 == std::string::npos || c2 == std::string::npos) {
+			continue;
+		}
+		std::string controllers = line.substr(c1 + 1, c2 - c1 - 1);
+		if (controller.empty() ? controllers.empty() : hasItem(splitString(controllers, ','), controller)) {
+			path = line.substr(c2 + 1);
+			found = true;
+			break;
+		}
+	}
+	if (!found || !readSysFile("/proc/self/mountinfo", s)) {
+		return false;
+	}
+
+	// "id parent dev root mountpoint opts [optional...] - fstype source superopts"
+	for (const auto& line : splitString(s, '\n')) {
+		auto fields = splitString(line, ' ');
+		auto sep = std::find(fields.begin(), fields.end(), std::string("-"));
+		if (fields.size() < 5 || sep == fields.end() || fields.end() - sep < 4) {
+			continue;
+		}
+		const std::string& fsType = *(sep + 1);
+		bool match = controller.empty() ?
+			fsType == "cgroup2" :
+			fsType == "cgroup" && hasItem(splitString(*(sep + 3), ','), controller);
+		if (!match) {
+			continue;
+		}
+		// mount root is "/" unless the hierarchy is only partially visible (containers)
+		const std::string& root = fields[3];
+		std::string rel = path;
+		if (root != "/" && rel.compare(0, root.size(), root) == 0) {
+			rel = rel.substr(root.size());
+		}
+		out.mount = fields[4];
+		out.dir = out.mount + (rel == "/" ? "" : rel);
+		return true;
+	}
+	return false;
+}
+
+static std::string parentDir(const std::string& dir) {
+	size_t slash = dir.find_last_of('/');
+	return (slash == std::string::npos || slash == 0) ? "/" : dir.substr(0, slash);
+}
+
+// smallest quota of the cgroup & its ancestors, 0 if unlimited
+static double readCgroupQuota() {
+	double quota = 0;
+	CgroupDir cg;
+	if (findCgroupDir("", cg)) {
+		// v2: "max 100000" or "400000 100000"
+		for (std::string dir = cg.dir; dir.size() >= cg.mount.size(); dir = parentDir(dir)) {
+			std::string s;
+			if (readSysFile(dir + "/cpu.max", s)) {
+				double q, period;
+				if (sscanf(s.c_str(), "%lf %lf", &q, &period) == 2 && period > 0) {
+					quota = (quota == 0) ? q / period : std::min(quota, q / period);
+				}
+			}
+			if (dir == cg.mount) {
+				break;
+			}
+		}
+		if (quota > 0) {
+			return quota;
+		}
+	}
+	if (findCgroupDir("cpu", cg)) {
+		// v1: quota -1 = unlimited
+		for (std::string dir = cg.dir; dir.size() >= cg.mount.size(); dir = parentDir(dir)) {
+			int q = readSysInt(dir + "/cpu.cfs_quota_us", -1);
+			int period = readSysInt(dir + "/cpu.cfs_period_us", 0);
+			if (q > 0 && period > 0) {
+				quota = (quota == 0) ? (double)q / period : std::min(quota, (double)q / period);
+			}
+			if (dir == cg.mount) {
+				break;
+			}
+		}
+	}
+	return quota;
+}
+
+static int readCgroupCpusetCount() {
+	CgroupDir cg;
+	std::string s;
+	std::vector<int> cpus;
+	if (findCgroupDir("", cg) && readSysFile(cg.dir + "/cpuset.cpus.effective", s) && parseCpuList(s, cpus)) {
+		return (int)cpus.size();
+	}
+	if (findCgroupDir("cpuset", cg) &&
+		(readSysFile(cg.dir + "/cpuset.effective_cpus", s) || readSysFile(cg.dir + "/cpuset.cpus", s)) &&
+		parseCpuList(s, cpus)) {
+		return (int)cpus.size();
+	}
+	return 0;
+}
+
+static bool probeLinux(CpuTopology& topo) {
+	const std::string CPU_DIR = "/sys/devices/system/cpu/";
+	std::string s;
+	std::vector<int> online;
+	if (!readSysFile(CPU_DIR + "online", s) || !parseCpuList(s, online)) {
+		return false;
+	}
+
+	// containers & taskset restrict the CPUs we may use
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	bool hasAllowed = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+	// cpu -> numa node
+	std::map<int, int> cpuNode;
+	std::vector<int> nodes;
+	if (readSysFile("/sys/devices/system/node/online", s) && parseCpuList(s, nodes)) {
+		for (int node : nodes) {
+			std::vector<int> nodeCpus;
+			if (readSysFile("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist", s) && parseCpuList(s, nodeCpus)) {
+				for (int c : nodeCpus) {
+					cpuNode[c] = node;
+				}
+			}
+		}
+	}
+
+	std::map<std::pair<int, int>, int> coreIndex; // (package, core_id) -> core index
+	std::map<int, int> coreSiblings;              // core index -> siblings seen so far
+	std::map<int, int> packages, usedNodes;
+	for (int cpu : online) {
+		if (hasAllowed && (cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed))) {
+			continue;
+		}
+		std::string topoDir = CPU_DIR + "cpu" + std::to_string(cpu) + "/topology/";
+		CpuInfo info;
+		info.cpu = cpu;
+		info.package = readSysInt(topoDir + "physical_package_id", 0);
+		int coreId = readSysInt(topoDir + "core_id", cpu);
+		auto key = std::make_pair(info.package, coreId);
+		if (coreIndex.find(key) == coreIndex.end()) {
+			int idx = (int)coreIndex.size();
+			coreIndex[key] = idx;
+		}
+		info.core = coreIndex[key];
+		info.sibling = coreSiblings[info.core]++;
+		info.node = cpuNode.count(cpu) ? cpuNode[cpu] : 0;
+		packages[info.package]++;
+		usedNodes[info.node]++;
+		topo.cpus.push_back(info);
+	}
+	if (topo.cpus.empty()) {
+		return false;
+	}
+	topo.nCores = (int)coreIndex.size();
+	topo.nPackages = (int)packages.size();
+	topo.nNodes = (int)usedNodes.size();
+
+	// unified / data caches of the first CPU, assumed symmetric
+	std::string cacheDir = CPU_DIR + "cpu" + std::to_string(topo.cpus[0].cpu) + "/cache/";
+	for (int i = 0; i < 8; i++) {
+		std::string indexDir = cacheDir + "index" + std::to_string(i) + "/";
+		std::string type, size, shared;
+		if (!readSysFile(indexDir + "type", type)) {
+			break;
+		}
+		if (type == "Instruction") {
+			continue;
+		}
+		int level = readSysInt(indexDir + "level", 0);
+		std::vector<int> sharedCpus;
+		readSysFile(indexDir + "size", size);
+		if (readSysFile(indexDir + "shared_cpu_list", shared)) {
+			parseCpuList(shared, sharedCpus);
+		}
+		if (level == 2) {
+			topo.l2Bytes = parseCacheSize(size);
+			topo.l2SharedBy = (int)sharedCpus.size();
+		}
+		else if (level == 3) {
+			topo.l3Bytes = parseCacheSize(size);
+			topo.l3SharedBy = (int)sharedCpus.size();
+		}
+	}
+	return true;
+}
+#endif
+
+static CpuTopology probeTopology() {
+	CpuTopology topo;
+	topo.probed = false;
+	topo.nCores = topo.nPackages = topo.nNodes = 0;
+	topo.l2Bytes = topo.l3Bytes = 0;
+	topo.l2SharedBy = topo.l3SharedBy = 0;
+#ifdef __linux__
+	topo.probed = probeLinux(topo);
+#endif
+	if (!topo.probed) {
+		topo.cpus.clear();
+		int n = std::max(1, (int)std::thread::hardware_concurrency());
+		for (int i = 0; i < n; i++) {
+			CpuInfo info = { i, i, 0, 0, 0 };
+			topo.cpus.push_back(info);
+		}
+		topo.nCores = n;
+		topo.nPackages = topo.nNodes = 1;
+	}
+	return topo;
+}
+
+const CpuTopology& cpuTopology() {
+	static CpuTopology s_topology = probeTopology();
+	return s_topology;
+}
+
+void logTopology(const char* logPrefix) {
+	const CpuTopology& topo = cpuTopology();
+	if (!topo.probed) {
+		logLine(logPrefix, "CPU topology: %d logical CPUs (no topology info)", (int)topo.cpus.size());
+		return;
+	}
+	logLine(logPrefix, "CPU topology: %d logical CPUs, %d cores, %d package(s), %d NUMA node(s)",
+		(int)topo.cpus.size(), topo.nCores, topo.nPackages, topo.nNodes);
+	if (topo.l2Bytes || topo.l3Bytes) {
+		logLine(logPrefix, "Caches: L2 %u KB per %d CPU(s), L3 %u KB per %d CPU(s)",
+			topo.l2Bytes / 1024, topo.l2SharedBy, topo.l3Bytes / 1024, topo.l3SharedBy);
+	}
+}
+
+void cpuModelInfo(std::string& model, std::string& microcode) {
+	model = "unknown";
+	microcode = "unknown";
+#ifdef __linux__
+	std::ifstream f("/proc/cpuinfo");
+	std::string line;
+	while (std::getline(f, line)) {
+		size_t colon = line.find(':');
+		if (colon == std::string::npos || colon + 2 > line.size()) {
+			continue;
+		}
+		std::string name = line.substr(0, line.find_last_not_of(" \t", colon - 1) + 1);
+		std::string value = line.substr(colon + 2);
+		if (name == "model name" && model == "unknown") {
+			model = value;
+		}
+		else if (name == "microcode" && microcode == "unknown") {
+			microcode = value;
+		}
+	}
+	if (model != "unknown") {
+		return;
+	}
+#endif
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+	unsigned int regs[12] = { 0 };
+	for (unsigned int i = 0; i < 3; i++) {
+#if defined(_MSC_VER)
+		__cpuid((int*)&regs[i * 4], 0x80000002 + i);
+#else
+		__get_cpuid(0x80000002 + i, &regs[i * 4], &regs[i * 4 + 1], &regs[i * 4 + 2], &regs[i * 4 + 3]);
+#endif
+	}
+	char brand[49] = { 0 };
+	memcpy(brand, regs, 48);
+	std::string s = brand;
+	size_t first = s.find_first_not_of(' ');
+	if (first != std::string::npos) {
+		model = s.substr(first);
+	}
+#endif
+}
+
+// physical cores first, spread over NUMA nodes, SMT siblings after all cores
+static std::vector<int> corePlacement(const CpuTopology& topo) {
+	struct Slot {
+		int sibling, posInNode, node, cpu;
+	};
+	std::vector<Slot> slots;
+	std::map<std::pair<int, int>, int> seen; // (node, sibling) -> count
+	for (const auto& c : topo.cpus) {
+		Slot slot = { c.sibling, seen[std::make_pair(c.node, c.sibling)]++, c.node, c.cpu };
+		slots.push_back(slot);
+	}
+	std::stable_sort(slots.begin(), slots.end(), [](const Slot& a, const Slot& b) {
+		if (a.sibling != b.sibling) return a.sibling < b.sibling;
+		if (a.posInNode != b.posInNode) return a.posInNode < b.posInNode;
+		return a.node < b.node;
+	});
+	std::vector<int> cpus;
+	for (const auto& slot : slots) {
+		cpus.push_back(slot.cpu);
+	}
+	return cpus;
+}
+
+const char* affinityPolicyName(AffinityPolicy policy) {
+	switch (policy) {
+		case AFFINITY_NONE: return "none";
+		case AFFINITY_CORES: return "cores";
+		case AFFINITY_ALL: return "all";
+		case AFFINITY_LIST: return "list";
+	}
+	return "?";
+}
+
+std::vector<int> affinityPlacement(const AffinityConfig& cfg) {
+	switch (cfg.policy) {
+		case AFFINITY_CORES:
+		case AFFINITY_ALL:
+			return corePlacement(cpuTopology());
+		case AFFINITY_LIST:
+			return cfg.cpuList;
+		default:
+			return std::vector<int>();
+	}
+}
+
+void initAffinity(const AffinityConfig& cfg) {
+	s_policy = cfg.policy;
+	s_placement = affinityPlacement(cfg);
+}
+
+int affinityThreadCount() {
+	switch (s_policy) {
+		case AFFINITY_CORES: return cpuTopology().nCores;
+		case AFFINITY_ALL: return (int)cpuTopology().cpus.size();
+		case AFFINITY_LIST: return (int)s_placement.size();
+		default: return 0;
+	}
+}
+
+int minerThreadCpu(int minerID) {
+	if (s_placement.empty() || minerID < 0) {
+		return -1;
+	}
+	return s_placement[minerID % s_placement.size()];
+}
+
+int cpuNumaNode(int cpu) {
+	for (const auto& c : cpuTopology().cpus) {
+		if (c.cpu == cpu) {
+			return c.node;
+		}
+	}
+	return 0;
+}
+
+CpuLimits readCpuLimits() {
+	CpuLimits limits;
+	limits.allowedCpus = std::max(1, (int)std::thread::hardware_concurrency());
+	limits.cpusetCpus = 0;
+	limits.quotaCpus = 0;
+#ifdef __linux__
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+		limits.allowedCpus = std::max(1, (int)CPU_COUNT(&allowed));
+	}
+	limits.cpusetCpus = readCgroupCpusetCount();
+	limits.quotaCpus = readCgroupQuota();
+#endif
+	return limits;
+}
+
+int cpuLimitsThreadCount(const CpuLimits& limits) {
+	int n = limits.allowedCpus;
+	if (limits.cpusetCpus > 0) {
+		n = std::min(n, limits.cpusetCpus);
+	}
+	// more threads than the quota only adds CFS throttling
+	if (limits.quotaCpus > 0) {
+		n = std::min(n, std::max(1, (int)(limits.quotaCpus + 0.5)));
+	}
+	return n;
+}
+
+bool pinCurrentThread(int cpu) {
+	if (cpu < 0) {
+		return false;
+	}
+#if defined(__linux__)
+	if (cpu >= CPU_SETSIZE) {
+		return false;
+	}
+	cpu_set_t cpuset;
+	CPU_ZERO(&cpuset);
+	CPU_SET(cpu, &cpuset);
+	return sched_setaffinity(0, sizeof(cpuset), &cpuset) == 0;
+#elif defined(_WIN32)
+	if (cpu >= (int)(sizeof(DWORD_PTR) * 8)) {
+		return false;
+	}
+	return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0;
+#else
+	return false;
+#endif
+}
+
+uint8_t* allocNodeLocalMemory(size_t bytes, int node) {
+#ifdef __linux__
+	void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) {
+		return nullptr;
+	}
+	// best effort: on failure first touch below still places pages on the node of the calling thread
+	if (cpuTopology().nNodes > 1 && node >= 0 && node < 64) {
+		unsigned long nodeMask = 1UL << node;
+		syscall(SYS_mbind, p, bytes, MPOL_PREFERRED_MODE, &nodeMask, sizeof(nodeMask) * 8, 0);
+	}
+#else
+	(void)node;
+	void* p = malloc(bytes);
+	if (!p) {
+		return nullptr;
+	}
+#endif
+	memset(p, 0, bytes);
+	return (uint8_t*)p;
+}
+
+void freeNodeLocalMemory(uint8_t* memory, size_t bytes) {
+	if (!memory) {
+		return;
+	}
+#ifdef __linux__
+	munmap(memory, bytes);
+#else
+	(void)bytes;
+	free(memory);
+#endif
+}
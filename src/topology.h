@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// CPU topology (Linux: /sys/devices/system/cpu) & miner thread placement (--affinity)
+// other systems get a flat topology (one core per logical CPU, one node)
+
+struct CpuInfo {
+	int cpu;     // logical CPU id
+	int core;    // physical core index, 0..nCores-1
+	int package;
+	int node;    // NUMA node
+	int sibling; // rank among the SMT siblings of the core, 0 for the first one
+};
+
+struct CpuTopology {
+	bool probed;              // false if only the flat fallback is available
+	std::vector<CpuInfo> cpus; // online CPUs this process may run on, sorted by id
+	int nCores;
+	int nPackages;
+	int nNodes;
+	uint32_t l2Bytes;         // per L2 instance, 0 if unknown
+	uint32_t l3Bytes;
+	int l2SharedBy;           // logical CPUs per L2 instance
+	int l3SharedBy;
+};
+
+enum AffinityPolicy {
+	AFFINITY_NONE,  // let the OS scheduler place threads (default)
+	AFFINITY_CORES, // one thread per physical core, SMT siblings only when threads > cores
+	AFFINITY_ALL,   // every logical CPU, physical cores first
+	AFFINITY_LIST   // explicit CPU list, ex: 0-7,16-23
+};
+
+struct AffinityConfig {
+	AffinityPolicy policy = AFFINITY_NONE;
+	std::vector<int> cpuList; // AFFINITY_LIST only
+};
+
+// "none", "cores", "all" or a CPU list
+bool parseAffinity(const std::string& s, AffinityConfig& cfg);
+// "0-3,8,10-11" -> 0 1 2 3 8 10 11
+bool parseCpuList(const std::string& s, std::vector<int>& cpus);
+
+const CpuTopology& cpuTopology();
+void logTopology(const char* logPrefix);
+// "model name" & "microcode" from /proc/cpuinfo, cpuid brand string elsewhere, "unknown" if not found
+void cpuModelInfo(std::string& model, std::string& microcode);
+
+const char* affinityPolicyName(AffinityPolicy policy);
+// CPU of thread i is placement[i % size], empty for AFFINITY_NONE
+std::vector<int> affinityPlacement(const AffinityConfig& cfg);
+
+// computes the CPU of each miner thread id, must be called before starting miner threads
+void initAffinity(const AffinityConfig& cfg);
+// thread count matching the policy (cores / cpu list size), 0 to keep the default
+int affinityThreadCount();
+// CPU assigned to a miner thread (threads above the placement size wrap around), -1 if not pinned
+int minerThreadCpu(int minerID);
+int cpuNumaNode(int cpu);
+
+// CPU limits of containers, read again on each call (quotas can change while mining)
+struct CpuLimits {
+	int allowedCpus;   // sched_getaffinity
+	int cpusetCpus;    // cgroup cpuset.cpus.effective, 0 if unknown
+	double quotaCpus;  // cgroup v2 cpu.max / v1 cfs quota, smallest of all ancestors, 0 if unlimited
+};
+CpuLimits readCpuLimits();
+// default thread count: allowed CPUs, capped by cpuset & quota (rounded, at least 1)
+int cpuLimitsThreadCount(const CpuLimits& limits);
+
+// pins the calling thread on one CPU
+bool pinCurrentThread(int cpu);
+
+// memory placed on a NUMA node (Linux: mbind, other systems: plain allocation), page aligned
+// touched by the caller before returning, so pages are committed on the right node
+uint8_t* allocNodeLocalMemory(size_t bytes, int node);
+void freeNodeLocalMemory(uint8_t* memory, size_t bytes);
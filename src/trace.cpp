@@ -0,0 +1,161 @@
+#include "trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <assert.h>
+
+// chrome trace thread ids: miner threads use their id, pools & submits get their own rows
+const int TRACE_TID_POOL = 10000;
+const int TRACE_TID_SUBMIT = 20000;
+
+struct TraceSample {
+	int64_t startUs;
+	int64_t durUs; // -1 for instant events
+	uint32_t arg;
+	int16_t event;
+	int16_t poolId;
+	int32_t minerID;
+};
+
+struct TraceRecord {
+	// 0 while being written, ring position + 1 once complete
+	std::atomic<uint64_t> seq;
+	TraceSample sample;
+};
+
+static TraceRecord s_traceRing[TRACE_RING_SIZE];
+static std::atomic<uint64_t> s_traceNext(0);
+static LatencyHistogram s_traceLatency[TRACE_N_EVENTS];
+
+int64_t traceNowUs() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char* traceEventName(TraceEvent ev) {
+	switch (ev) {
+		case TRACE_GETWORK: return "getwork";
+		case TRACE_WORK_PUBLISH: return "work_publish";
+		case TRACE_FIRST_HASH: return "first_hash";
+		case TRACE_SHARE_FOUND: return "share_found";
+		case TRACE_SUBMIT_QUEUE: return "submit_queue";
+		case TRACE_SUBMIT: return "submit";
+		default: break;
+	}
+	return "unknown";
+}
+
+const LatencyHistogram& traceLatency(TraceEvent ev) {
+	assert(ev >= 0 && ev < TRACE_N_EVENTS);
+	return s_traceLatency[ev];
+}
+
+static void traceRecord(TraceEvent ev, int minerID, int poolId, int64_t startUs, int64_t durUs, uint32_t arg) {
+	uint64_t pos = s_traceNext.fetch_add(1, std::memory_order_relaxed);
+	TraceRecord& r = s_traceRing[pos % TRACE_RING_SIZE];
+	r.seq.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	r.sample.startUs = startUs;
+	r.sample.durUs = durUs;
+	r.sample.arg = arg;
+	r.sample.event = (int16_t)ev;
+	r.sample.poolId = (int16_t)poolId;
+	r.sample.minerID = minerID;
+	r.seq.store(pos + 1, std::memory_order_release);
+}
+
+void traceSpan(TraceEvent ev, int minerID, int poolId, int64_t startUs, int64_t endUs, uint32_t arg) {
+	int64_t durUs = std::max<int64_t>(endUs - startUs, 0);
+	s_traceLatency[ev].add(durUs / 1000.0);
+	traceRecord(ev, minerID, poolId, startUs, durUs, arg);
+}
+
+void traceInstant(TraceEvent ev, int minerID, int poolId, uint32_t arg) {
+	traceRecord(ev, minerID, poolId, traceNowUs(), -1, arg);
+}
+
+static int traceTid(const TraceSample& r) {
+	switch (r.event) {
+		case TRACE_GETWORK:
+		case TRACE_WORK_PUBLISH:
+			return TRACE_TID_POOL + r.poolId;
+		case TRACE_SUBMIT_QUEUE:
+		case TRACE_SUBMIT:
+			return TRACE_TID_SUBMIT + r.minerID;
+		default:
+			return r.minerID;
+	}
+}
+
+bool dumpTrace(const std::string& path, std::string& log) {
+	// copy complete records, skipping slots being overwritten
+	uint64_t end = s_traceNext.load(std::memory_order_acquire);
+	uint64_t begin = end > TRACE_RING_SIZE ? end - TRACE_RING_SIZE : 0;
+	std::vector<TraceSample> records;
+	records.reserve((size_t)(end - begin));
+	for (uint64_t pos = begin; pos < end; pos++) {
+		const TraceRecord& r = s_traceRing[pos % TRACE_RING_SIZE];
+		if (r.seq.load(std::memory_order_acquire) != pos + 1) {
+			continue;
+		}
+		TraceSample sample = r.sample;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (r.seq.load(std::memory_order_relaxed) != pos + 1) {
+			continue;
+		}
+		records.push_back(sample);
+	}
+	size_t n = records.size();
+
+	FILE* f = fopen(path.c_str(), "w");
+	if (!f) {
+		log = "cannot open " + path;
+		return false;
+	}
+
+	// thread names, so rows read MNxx / pool x / submit MNxx
+	std::vector<int> tids;
+	for (auto &r : records) {
+		tids.push_back(traceTid(r));
+	}
+	std::sort(tids.begin(), tids.end());
+	tids.erase(std::unique(tids.begin(), tids.end()), tids.end());
+
+	fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool first = true;
+	for (int tid : tids) {
+		char name[32];
+		if (tid >= TRACE_TID_SUBMIT) {
+			snprintf(name, sizeof(name), "submit MN%02d", tid - TRACE_TID_SUBMIT);
+		}
+		else if (tid >= TRACE_TID_POOL) {
+			snprintf(name, sizeof(name), "pool %d", tid - TRACE_TID_POOL);
+		}
+		else {
+			snprintf(name, sizeof(name), "MN%02d", tid);
+		}
+		fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+			first ? "" : ",\n", tid, name);
+		first = false;
+	}
+	for (auto &r : records) {
+		const char* name = traceEventName((TraceEvent)r.event);
+		if (r.durUs >= 0) {
+			fprintf(f, "%s{\"name\":\"%s\",\"cat\":\"miner\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lld,\"args\":{\"pool\":%d,\"arg\":%u}}",
+				first ? "" : ",\n", name, traceTid(r), (long long)r.startUs, (long long)r.durUs, r.poolId, r.arg);
+		}
+		else {
+			fprintf(f, "%s{\"name\":\"%s\",\"cat\":\"miner\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"args\":{\"pool\":%d,\"arg\":%u}}",
+				first ? "" : ",\n", name, traceTid(r), (long long)r.startUs, r.poolId, r.arg);
+		}
+		first = false;
+	}
+	fprintf(f, "\n]}\n");
+	fclose(f);
+
+	log = std::to_string(n) + " events written to " + path;
+	return true;
+}
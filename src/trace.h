@@ -0,0 +1,44 @@
+#pragma once
+
+#include "histogram.h"
+
+#include <string>
+#include <stdint.h>
+
+// share & work lifecycle tracing: timestamped spans kept in a ring buffer (last TRACE_RING_SIZE events),
+// summarized as latency histograms and dumpable as chrome://tracing / perfetto JSON
+enum TraceEvent {
+	TRACE_GETWORK,       // span: getWork request -> response (pool)
+	TRACE_WORK_PUBLISH,  // instant: new work handed to miner threads (pool)
+	TRACE_FIRST_HASH,    // span: work publish -> first hash done on it (miner thread)
+	TRACE_SHARE_FOUND,   // instant: hash below target (miner thread)
+	TRACE_SUBMIT_QUEUE,  // span: share found -> submit request sent (submit)
+	TRACE_SUBMIT,        // span: submit request sent -> server response (submit)
+	TRACE_N_EVENTS
+};
+
+// outcome stored in the arg of TRACE_SUBMIT
+enum TraceSubmitResult {
+	TRACE_SUBMIT_ACCEPTED = 1,
+	TRACE_SUBMIT_REJECTED = 2,
+	TRACE_SUBMIT_FAILED = 3
+};
+
+const uint32_t TRACE_RING_SIZE = 1 << 16;
+
+// steady clock in us
+int64_t traceNowUs();
+
+// lock free, callable from any thread: one atomic increment + one ring slot write
+// spans also feed the latency histogram of their event
+void traceSpan(TraceEvent ev, int minerID, int poolId, int64_t startUs, int64_t endUs, uint32_t arg = 0);
+void traceInstant(TraceEvent ev, int minerID, int poolId, uint32_t arg = 0);
+
+const char* traceEventName(TraceEvent ev);
+const LatencyHistogram& traceLatency(TraceEvent ev);
+
+// default dump file, in the config directory
+const char* const TRACE_FILE_NAME = "trace.json";
+
+// writes the ring content as chrome trace_event JSON
+bool dumpTrace(const std::string& path, std::string& log);
@@ -6,9 +6,12 @@
 #include <sstream>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <deque>
 #include <chrono>
 #include <assert.h>
 #include <stdlib.h>
+#include <algorithm>
 
 #include "miningConfig.h"
 #include "miner.h"
@@ -16,6 +19,8 @@
 #include "http.h"
 #include "log.h"
 #include "hex_encode_utils.h"
+#include "histogram.h"
+#include "trace.h"
 
 #include <atomic>
 #include <map>
@@ -33,16 +38,180 @@ const std::vector<std::string> HTTP_HEADER = {
 	"Content-Type: application/json" 
 };
 
-static bool s_bUpdateThreadRun = true;
-std::mutex s_workParams_mutex;
-static WorkParams s_workParams;
+// update pipeline of one pool: own thread, work, triggers & http connections
+struct PoolState {
+	PoolState() :
+		pThread(nullptr),
+		run(false),
+		getWorkCount(0),
+		active(false),
+		up(false),
+		consecutiveFailures(0),
+		workEpoch(0),
+		workVersion(-1),
+		lastNewWorkMs(0)
+	{
+		logPrefix[0] = 0;
+	}
+
+	std::thread* pThread;
+	bool run; // protected by trigger_mutex
+	char logPrefix[8];
+
+	// current work of the pool, read by miner threads
+	std::mutex workParams_mutex;
+	WorkParams workParams;
+
+	// number of succesfull getWork done so far
+	std::atomic<uint32_t> getWorkCount;
+
+	// status readable without locks (metrics, stats)
+	std::atomic<bool> active;
+	std::atomic<bool> up;
+	std::atomic<uint32_t> consecutiveFailures;
+	std::atomic<uint32_t> workEpoch; // incremented on each new work
+	std::atomic<int> workVersion;
+	std::atomic<int64_t> lastNewWorkMs;
+	LatencyHistogram getWorkLatency;
+
+	// triggers pushed by miner/submit threads to wake the update thread before its refresh timer expires
+	std::mutex trigger_mutex;
+	std::condition_variable trigger_cv;
+	std::deque<UpdateTrigger> triggers;
+
+	// signaled each time a getWork request succeeds
+	std::mutex getWork_mutex;
+	std::condition_variable getWork_cv;
+
+	// only used by the pool update thread
+	std::map<std::string, http_connection_handle_t> httpHandles;
+};
+
+static PoolState s_pools[MAX_POOLS];
+
+// adaptive refresh: poll faster right after a block change, back off while the work stays the same
+const uint32_t MIN_REFRESH_MS = 250;
+const uint32_t FAST_REFRESH_DIVIDER = 4;
+// exponential back off when the pool does not answer
+const uint32_t POOL_ERROR_MIN_WAIT_MS = 1000;
+const uint32_t POOL_ERROR_MAX_WAIT_MS = 30 * 1000;
 std::atomic<uint32_t> s_nodeReqId = { 0 };
-std::atomic<uint32_t> s_poolGetWorkCount = { 0 }; // number of succesfull getWork done so far
 std::atomic<int> s_version = { 0 };
-static std::map<std::string, http_connection_handle_t> s_httpHandles;
 
-uint32_t getPoolGetWorkCount() {
-	return s_poolGetWorkCount;
+uint32_t getPoolGetWorkCount(int poolId) {
+	assert(poolId >= 0 && poolId < MAX_POOLS);
+	return s_pools[poolId].getWorkCount;
+}
+
+PoolStatus getPoolStatus(int poolId) {
+	assert(poolId >= 0 && poolId < MAX_POOLS);
+	const PoolState& pool = s_pools[poolId];
+	PoolStatus res;
+	res.active = pool.active;
+	res.up = pool.up;
+	res.consecutiveFailures = pool.consecutiveFailures;
+	res.getWorkCount = pool.getWorkCount;
+	res.workEpoch = pool.workEpoch;
+	res.workVersion = pool.workVersion;
+	res.lastNewWorkMs = pool.lastNewWorkMs;
+	return res;
+}
+
+const LatencyHistogram& getPoolGetWorkLatency(int poolId) {
+	assert(poolId >= 0 && poolId < MAX_POOLS);
+	return s_pools[poolId].getWorkLatency;
+}
+
+int64_t steadyNowMs() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char* updateTriggerName(UpdateTrigger reason) {
+	switch (reason) {
+		case UPDATE_TRIGGER_BLOCK_FOUND:
+			return "block found";
+		case UPDATE_TRIGGER_SHARE_REJECTED:
+			return "share rejected";
+		case UPDATE_TRIGGER_HINT:
+			return "new work hint";
+		case UPDATE_TRIGGER_CONFIG_CHANGED:
+			return "config changed";
+	}
+	return "unknown";
+}
+
+void triggerWorkUpdate(int poolId, UpdateTrigger reason) {
+	assert(poolId >= 0 && poolId < MAX_POOLS);
+	PoolState& pool = s_pools[poolId];
+	pool.trigger_mutex.lock();
+	{
+		pool.triggers.push_back(reason);
+	}
+	pool.trigger_mutex.unlock();
+	pool.trigger_cv.notify_one();
+}
+
+void triggerWorkUpdateAllPools(UpdateTrigger reason) {
+	for (int i = 0; i < MAX_POOLS; i++) {
+		triggerWorkUpdate(i, reason);
+	}
+}
+
+// sleeps until timeout or until a trigger is pushed, returns false on timeout
+static bool waitForTrigger(PoolState& pool, uint32_t timeoutMs, UpdateTrigger &reason) {
+	std::unique_lock<std::mutex> lock(pool.trigger_mutex);
+	bool triggered = pool.trigger_cv.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&pool] {
+		return !pool.triggers.empty() || !pool.run;
+	});
+	if (!triggered || pool.triggers.empty()) {
+		return false;
+	}
+	// several triggers received while polling are served by a single request
+	reason = pool.triggers.front();
+	pool.triggers.clear();
+	return true;
+}
+
+static bool poolRunning(PoolState& pool) {
+	std::lock_guard<std::mutex> lock(pool.trigger_mutex);
+	return pool.run;
+}
+
+bool waitForNewWork(int poolId, const std::string& workHash, uint32_t timeoutMs) {
+	assert(poolId >= 0 && poolId < MAX_POOLS);
+	PoolState& pool = s_pools[poolId];
+	auto tEnd = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+	auto tNextPoll = std::chrono::steady_clock::now();
+	while (true) {
+		// epoch read first, work published after the hash check still wakes us (also in solo mode)
+		uint32_t workEpoch = pool.workEpoch;
+		if (currentWorkParams(poolId).hash != workHash) {
+			return true;
+		}
+		auto tNow = std::chrono::steady_clock::now();
+		if (tNow >= tEnd) {
+			return false;
+		}
+		// no new work yet, poll again but not faster than the adaptive refresh floor
+		if (tNow >= tNextPoll) {
+			triggerWorkUpdate(poolId, UPDATE_TRIGGER_SHARE_REJECTED);
+			tNextPoll = tNow + std::chrono::milliseconds(MIN_REFRESH_MS);
+		}
+		std::unique_lock<std::mutex> lock(pool.getWork_mutex);
+		pool.getWork_cv.wait_until(lock, std::min(tEnd, tNextPoll), [&pool, workEpoch] {
+			return pool.workEpoch != workEpoch;
+		});
+	}
+}
+
+bool waitForWork(int poolId, uint32_t timeoutMs) {
+	assert(poolId >= 0 && poolId < MAX_POOLS);
+	PoolState& pool = s_pools[poolId];
+	std::unique_lock<std::mutex> lock(pool.getWork_mutex);
+	return pool.getWork_cv.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&pool] {
+		return pool.workEpoch != 0;
+	});
 }
 
 // target = 2 ^ 256 / difficulty
@@ -51,6 +220,7 @@ void computeTarget(mpz_t mpz_difficulty, mpz_t &mpz_target) {
 	mpz_maxBest(mpz_numerator);
 	mpz_init_set_str(mpz_target, "0", 10);
 	mpz_div(mpz_target, mpz_numerator, mpz_difficulty);
+	mpz_clear(mpz_numerator);
 }
 
 // difficulty = 2 ^ 256 / target
@@ -59,19 +229,20 @@ void computeDifficulty(mpz_t mpz_target, mpz_t &mpz_difficulty) {
 	mpz_maxBest(mpz_numerator);
 	mpz_init_set_str(mpz_difficulty, "0", 10);
 	mpz_div(mpz_difficulty, mpz_numerator, mpz_target);
+	mpz_clear(mpz_numerator);
 }
 
-http_connection_handle_t getHandle(const std::string &url) {
-	if (s_httpHandles.find(url) == s_httpHandles.end()) {
-		s_httpHandles.insert(std::make_pair(url, newHttpConnectionHandle()));
+static http_connection_handle_t getHandle(PoolState& pool, const std::string &url) {
+	if (pool.httpHandles.find(url) == pool.httpHandles.end()) {
+		pool.httpHandles.insert(std::make_pair(url, newHttpConnectionHandle()));
 #ifdef _DEBUG
 		printf("\n===> new http handle for %s\n\n", url.c_str());
 #endif
 	}
-	return s_httpHandles[url];
+	return pool.httpHandles[url];
 }
 
-static bool performGetWorkRequest(const std::string &nodeUrl, std::string &response) 
+static bool performGetWorkRequest(PoolState& pool, const std::string &nodeUrl, std::string &response) 
 {
 	char getWorkParams[512];
 	snprintf(
@@ -79,7 +250,7 @@ static bool performGetWorkRequest(const std::string &nodeUrl, std::string &respo
 		sizeof(getWorkParams), 
 		"{\"jsonrpc\":\"2.0\", \"id\" : %d, \"method\" : \"aqua_getWork\", \"params\" : null}",
 		1);	
-	return httpPost(getHandle(nodeUrl), nodeUrl, getWorkParams, response, &HTTP_HEADER);
+	return httpPost(getHandle(pool, nodeUrl), nodeUrl, getWorkParams, response, &HTTP_HEADER);
 }
 
 typedef struct {
@@ -129,7 +300,7 @@ std::string formatBlockInfo(const t_blockInfo &b) {
 	return buf;
 }
 
-static bool getBlocksInfo(const std::string &nodeUrl, t_blocksInfo &result)
+static bool getBlocksInfo(PoolState& pool, const std::string &nodeUrl, t_blocksInfo &result)
 {
 	
 	if (false) {
@@ -146,7 +317,7 @@ static bool getBlocksInfo(const std::string &nodeUrl, t_blocksInfo &result)
 	//printf("getting new block info\n");
 	//printf("node url: %s\n", nodeUrl.c_str());
 	
-	auto getBlockJson = [&nodeUrl](std::string blockNum, t_blockInfo &res) -> bool {
+	auto getBlockJson = [&pool, &nodeUrl](std::string blockNum, t_blockInfo &res) -> bool {
 		char getPendingBlockParams[512];
 		snprintf(
 			getPendingBlockParams,
@@ -156,7 +327,7 @@ static bool getBlocksInfo(const std::string &nodeUrl, t_blocksInfo &result)
 			blockNum.c_str());
 		
 		std::string resp;
-		if (!httpPost(getHandle(nodeUrl), nodeUrl, getPendingBlockParams, resp, &HTTP_HEADER))
+		if (!httpPost(getHandle(pool, nodeUrl), nodeUrl, getPendingBlockParams, resp, &HTTP_HEADER))
 			return false;
 
 		std::vector<std::string> params;
@@ -275,6 +446,8 @@ static bool setCurrentWork(const Document &work, WorkParams &workParams) {
 	computeDifficulty(workParams.mpz_target, mpz_difficulty);
 	gmp_snprintf(buf, sizeof(buf), "%Zd", mpz_difficulty);
 	workParams.difficulty.assign(buf);
+	workParams.difficultyValue = mpz_get_d(mpz_difficulty);
+	mpz_clear(mpz_difficulty);
 
 	// store work hash
 	workParams.hash = resultArray[0];
@@ -282,106 +455,183 @@ static bool setCurrentWork(const Document &work, WorkParams &workParams) {
 	return workParams.version > 1;
 }
 
-bool requestPoolParams(const MiningConfig& config, WorkParams &workParams, bool verbose)
+bool parseGetWork(const std::string& response, WorkParams &workParams)
+{
+	Document work;
+	work.Parse(response.c_str());
+	// result: [work hash, hash version, target]
+	if (!work.IsObject() || !work.HasMember(RESULT) || !work[RESULT].IsArray() || work[RESULT].Size() < 3) {
+		return false;
+	}
+	return setCurrentWork(work, workParams);
+}
+
+bool requestPoolParams(int poolId, const std::string& url, WorkParams &workParams, bool verbose)
 {	
 	// get work
 	std::string getWorkResponse;
-	bool postRequestOk = performGetWorkRequest(config.getWorkUrl, getWorkResponse);
+	assert(poolId >= 0 && poolId < MAX_POOLS);
+	PoolState& pool = s_pools[poolId];
+	auto tRequest = high_resolution_clock::now();
+	int64_t requestUs = traceNowUs();
+	bool postRequestOk = performGetWorkRequest(pool, url, getWorkResponse);
+	if (postRequestOk) {
+		std::chrono::duration<double, std::milli> requestDuration = high_resolution_clock::now() - tRequest;
+		pool.getWorkLatency.add(requestDuration.count());
+		traceSpan(TRACE_GETWORK, -1, poolId, requestUs, traceNowUs());
+	}
 	if (!postRequestOk) {
 		if (verbose)
-			logLine(UPDATE_THREAD_LOG_PREFIX, "Pool not responding (%s)", config.getWorkUrl.c_str());
-		return false;
-	}
-
-	// parse work json
-	Document work;
-	work.Parse(getWorkResponse.c_str());
-	if (!work.IsObject()) {
-		if (verbose) {
-			logLine(UPDATE_THREAD_LOG_PREFIX, "Cannot get work params from pool (%s)", config.getWorkUrl.c_str());
-		}
+			logLine(pool.logPrefix, "Pool not responding (%s)", url.c_str());
 		return false;
 	}
 
 	// update current work params with the new work
-	if (!setCurrentWork(work, workParams)) {
+	workParams.poolId = poolId;
+	workParams.poolUrl = url;
+	if (!parseGetWork(getWorkResponse, workParams)) {
 		if (verbose)
-			logLine(UPDATE_THREAD_LOG_PREFIX, "Error parsing pool work params (%s)\n%s\n", config.getWorkUrl.c_str(), getWorkResponse.c_str());
+			logLine(pool.logPrefix, "Error parsing pool work params (%s)\n%s\n", url.c_str(), getWorkResponse.c_str());
 		return false;
 	}
 
 	return true;
 }
 
-WorkParams currentWorkParams() {
+void publishPoolWork(int poolId, WorkParams& work) {
+	assert(poolId >= 0 && poolId < MAX_POOLS);
+	PoolState& pool = s_pools[poolId];
+	work.publishUs = traceNowUs();
+	traceInstant(TRACE_WORK_PUBLISH, -1, poolId, (uint32_t)work.version);
+	pool.workParams_mutex.lock();
+	{
+		pool.workParams = work;
+	}
+	pool.workParams_mutex.unlock();
+	pool.workVersion = work.version;
+	pool.lastNewWorkMs = steadyNowMs();
+	pool.workEpoch++;
+	// wakes miner threads parked before the first work
+	pool.getWork_mutex.lock();
+	pool.getWork_mutex.unlock();
+	pool.getWork_cv.notify_all();
+}
+
+WorkParams currentWorkParams(int poolId) {
+	assert(poolId >= 0 && poolId < MAX_POOLS);
+	PoolState& pool = s_pools[poolId];
 	WorkParams ret;
-	s_workParams_mutex.lock();
+	pool.workParams_mutex.lock();
 	{
-		ret = s_workParams;
+		ret = pool.workParams;
 	}
-	s_workParams_mutex.unlock();
+	pool.workParams_mutex.unlock();
 	return ret;
 }
 
 // regularly polls the pool to get new WorkParams when block changes
-void updateThreadFn() {
+void updateThreadFn(int poolId) {
+	PoolState& pool = s_pools[poolId];
 	auto tStart = high_resolution_clock::now();
-	bool solo = miningConfig().soloMine;
+	uint32_t refreshMs = miningConfig().refreshRateMs;
+	uint32_t errorWaitMs = 0;
+
+	// config hot reload tracking
+	uint32_t cfgGeneration = miningConfigGeneration();
+	auto tConfigSwap = tStart;
+	bool configSwapPending = false;
 
-	while (s_bUpdateThreadRun) {
+	UpdateTrigger reason;
+	while (poolRunning(pool)) {
 		WorkParams newWork;
-		newWork.hash = s_workParams.hash;
+		newWork.hash = pool.workParams.hash;
 
 		auto tNow = high_resolution_clock::now();
 		std::chrono::duration<float> durationSinceLast = tNow - tStart;
 		bool recomputeHashRate = false;
 
+		// pick the latest config snapshot, urls may have been reloaded
+		MiningConfig cfg = miningConfig();
+		if (poolId >= (int)cfg.pools.size()) {
+			// pool removed, syncUpdateThreads() will join us
+			waitForTrigger(pool, POOL_ERROR_MIN_WAIT_MS, reason);
+			continue;
+		}
+		const std::string& url = cfg.pools[poolId].url;
+		bool solo = cfg.soloMine;
+		if (miningConfigGeneration() != cfgGeneration) {
+			cfgGeneration = miningConfigGeneration();
+			tConfigSwap = tNow;
+			configSwapPending = true;
+		}
+
 		// call aqua_getWork on node / pool
 		// printf("\n\ngetWork\n\n");
-		bool ok = requestPoolParams(miningConfig(), newWork, true);
+		bool ok = requestPoolParams(poolId, url, newWork, true);
+		uint32_t waitMs = 0;
+		pool.up = ok;
+		pool.consecutiveFailures = ok ? 0 : pool.consecutiveFailures + 1;
 		if (!ok) {
-			const auto POOL_ERROR_WAIT_N_SECONDS = 30;
-			logLine(UPDATE_THREAD_LOG_PREFIX, "problem getting new work, retrying in %ds",
-				POOL_ERROR_WAIT_N_SECONDS);
-
-			std::this_thread::sleep_for(std::chrono::seconds(POOL_ERROR_WAIT_N_SECONDS));
+			errorWaitMs = (errorWaitMs == 0) ?
+				POOL_ERROR_MIN_WAIT_MS :
+				std::min(2 * errorWaitMs, POOL_ERROR_MAX_WAIT_MS);
+			waitMs = errorWaitMs;
+			logLine(pool.logPrefix, "problem getting new work, retrying in %2.1fs",
+				waitMs / 1000.0f);
 		}
 		else {
+			errorWaitMs = 0;
+
+			if (configSwapPending) {
+				configSwapPending = false;
+				std::chrono::duration<float> swapDuration = high_resolution_clock::now() - tConfigSwap;
+				logLine(pool.logPrefix, "Reloaded config active, first work from %s after %.1fms",
+					url.c_str(), swapDuration.count() * 1000.f);
+			}
+
 			// we have one more successfull getWork request
 			if (!solo) {
-				s_poolGetWorkCount++;
+				pool.getWork_mutex.lock();
+				{
+					pool.getWorkCount++;
+				}
+				pool.getWork_mutex.unlock();
+				pool.getWork_cv.notify_all();
 			}
+
+			// back off a bit more each time the work did not change, up to the configured refresh rate
+			uint32_t cfgRefreshMs = cfg.refreshRateMs;
+			refreshMs = std::min(refreshMs + refreshMs / 2, cfgRefreshMs);
+
 			// we have new work (a new block)
-			if (s_workParams.hash != newWork.hash) {
+			if (pool.workParams.hash != newWork.hash) {
+				// next block is far away, but pool may still update the work shortly
+				refreshMs = std::max(cfgRefreshMs / FAST_REFRESH_DIVIDER, MIN_REFRESH_MS);
+
 				// update miner params, must be done first, as quick as possible
-				s_workParams_mutex.lock();
-				{
-					s_workParams = newWork;
-				}
-				s_workParams_mutex.unlock();
+				publishPoolWork(poolId, newWork);
 
-				// refresh latest/pending blocks info
-				auto cfg = miningConfig();
-				bool hasFullNode = cfg.fullNodeUrl.size() > 0;
+				// refresh latest/pending blocks info (full node stats are for the main pool only)
+				bool hasFullNode = (poolId == 0) && cfg.fullNodeUrl.size() > 0;
 				std::string queryUrl = hasFullNode ?
 					cfg.fullNodeUrl :
-					cfg.getWorkUrl;
+					url;
 
 				// building log message
 				char header[2048] = { 0 };
 				snprintf(header, sizeof(header), "\n\n- New work info -\n%-16s : %s\n%-16s : %s\n%-16s : %s\n%-16s : %d\n",
 					"hash", 
 					newWork.hash.c_str(),
-					miningConfig().soloMine ? "block difficulty" : "share difficulty",
+					solo ? "block difficulty" : "share difficulty",
 					newWork.difficulty.c_str(),
-					miningConfig().soloMine ? "block target" : "share target",
+					solo ? "block target" : "share target",
 					newWork.target.c_str(),
 					"hash version",
 					newWork.version);
 
 				char body[2048] = { 0 };
 				t_blocksInfo blocksInfo;
-				if (!getBlocksInfo(queryUrl, blocksInfo)) {
+				if (!getBlocksInfo(pool, queryUrl, blocksInfo)) {
 					snprintf(body, sizeof(body), 
 						"Cannot show new block information (do not panic, mining might still be ok)");
 				}
@@ -401,35 +651,92 @@ void updateThreadFn() {
 				}
 				
 				// log new work / block info
-				logLine(UPDATE_THREAD_LOG_PREFIX, "%s\n%s", header, body);
+				logLine(pool.logPrefix, "%s\n%s", header, body);
 			}
+			waitMs = std::min(refreshMs, cfgRefreshMs);
 		}
 
-		std::this_thread::sleep_for(std::chrono::milliseconds(miningConfig().refreshRateMs));
+		// the timer is only a fallback, found blocks & rejected shares wake us up right away
+		if (waitForTrigger(pool, waitMs, reason)) {
+#ifdef _DEBUG
+			printf("\n===> getWork triggered by %s\n\n", updateTriggerName(reason));
+#endif
+		}
 	}
 
-	for (auto &it : s_httpHandles) {
+	for (auto &it : pool.httpHandles) {
 		destroyHttpConnectionHandle(it.second);
 	}
+	pool.httpHandles.clear();
+}
+
+static void startPoolUpdateThread(int poolId) {
+	PoolState& pool = s_pools[poolId];
+	assert(!pool.pThread);
+	if (poolId == 0) {
+		snprintf(pool.logPrefix, sizeof(pool.logPrefix), "%s", UPDATE_THREAD_LOG_PREFIX);
+	}
+	else {
+		snprintf(pool.logPrefix, sizeof(pool.logPrefix), "UP%02d", poolId);
+	}
+	pool.run = true;
+	pool.active = true;
+	pool.pThread = new std::thread(updateThreadFn, poolId);
+}
+
+static void stopPoolUpdateThread(int poolId) {
+	PoolState& pool = s_pools[poolId];
+	assert(pool.pThread);
+	pool.trigger_mutex.lock();
+	{
+		pool.run = false;
+	}
+	pool.trigger_mutex.unlock();
+	pool.trigger_cv.notify_one();
+	pool.pThread->join();
+	delete pool.pThread;
+	pool.pThread = nullptr;
+	pool.active = false;
+	pool.up = false;
+
+	// miners must not keep hashing work of a removed pool
+	pool.workParams_mutex.lock();
+	{
+		pool.workParams = WorkParams();
+	}
+	pool.workParams_mutex.unlock();
+}
+
+// starts / stops pool update threads to match the pools of the current config
+void syncUpdateThreads() {
+	int nPools = (int)miningConfig().pools.size();
+	for (int i = 0; i < MAX_POOLS; i++) {
+		bool needed = i < nPools;
+		if (needed && !s_pools[i].pThread) {
+			startPoolUpdateThread(i);
+		}
+		else if (!needed && s_pools[i].pThread) {
+			stopPoolUpdateThread(i);
+		}
+	}
 }
 
-std::thread* s_pThread = nullptr;
 void startUpdateThread() {
-	if (s_pThread) {
+	if (s_pools[0].pThread) {
 		assert(0);
 		return;
 	}
-	s_pThread = new std::thread(updateThreadFn);
+	syncUpdateThreads();
 }
 
 void stopUpdateThread() {
-	if (s_pThread) {
-		assert(s_bUpdateThreadRun);
-		s_bUpdateThreadRun = false;
-		s_pThread->join();
-		delete s_pThread;
-	}
-	else {
+	if (!s_pools[0].pThread) {
 		assert(0);
+		return;
+	}
+	for (int i = 0; i < MAX_POOLS; i++) {
+		if (s_pools[i].pThread) {
+			stopPoolUpdateThread(i);
+		}
 	}
 }
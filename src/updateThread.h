@@ -2,10 +2,52 @@
 
 #include "miner.h"
 #include "miningConfig.h"
+#include "histogram.h"
 
+// reasons for the update thread to poll the pool before its refresh timer expires
+enum UpdateTrigger {
+	UPDATE_TRIGGER_BLOCK_FOUND,
+	UPDATE_TRIGGER_SHARE_REJECTED,
+	UPDATE_TRIGGER_HINT,
+	UPDATE_TRIGGER_CONFIG_CHANGED
+};
+
+// one update thread per pool of the mining config
 void startUpdateThread();
 void stopUpdateThread();
+// starts / stops pool update threads after the pools of the config changed
+void syncUpdateThreads();
+
+WorkParams currentWorkParams(int poolId);
+// hands new work to the miner threads of a pool (publish time set in work), also used by offline tools
+void publishPoolWork(int poolId, WorkParams& work);
+bool requestPoolParams(int poolId, const std::string& url, WorkParams &workParams, bool verbose);
+// aqua_getWork JSON-RPC response -> hash, version, target & difficulty of workParams
+bool parseGetWork(const std::string& response, WorkParams &workParams);
+uint32_t getPoolGetWorkCount(int poolId);
+
+// pool state snapshot, read without taking any lock
+struct PoolStatus {
+	bool active;                  // pool has an update thread
+	bool up;                      // last getWork succeeded
+	uint32_t consecutiveFailures; // getWork failures since last success
+	uint32_t getWorkCount;
+	uint32_t workEpoch;           // number of new works received
+	int workVersion;
+	int64_t lastNewWorkMs;        // steadyNowMs() of last new work, 0 if none yet
+};
+PoolStatus getPoolStatus(int poolId);
+const LatencyHistogram& getPoolGetWorkLatency(int poolId);
+
+// steady clock in ms, for timestamps compared across threads
+int64_t steadyNowMs();
+
+// wakes the update thread of a pool so it polls immediately
+void triggerWorkUpdate(int poolId, UpdateTrigger reason);
+void triggerWorkUpdateAllPools(UpdateTrigger reason);
+const char* updateTriggerName(UpdateTrigger reason);
 
-WorkParams currentWorkParams();
-bool requestPoolParams(const MiningConfig& config, WorkParams &workParams, bool verbose);
-uint32_t getPoolGetWorkCount();
+// waits until the pool publishes work other than workHash, polling it meanwhile, returns false on timeout
+bool waitForNewWork(int poolId, const std::string& workHash, uint32_t timeoutMs);
+// waits until the pool has published a first work, returns false on timeout
+bool waitForWork(int poolId, uint32_t timeoutMs);
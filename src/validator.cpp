@@ -0,0 +1,179 @@
+#include "validator.h"
+#include "argon2ref.h"
+#include "miner.h"
+#include "log.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <stdlib.h>
+#include <string.h>
+
+const char* VALIDATOR_LOG_PREFIX = "VALD";
+const size_t SEED_LEN = 40;
+const size_t HASH_LEN = 32;
+// pending spot checks, newer samples are dropped beyond that
+const int SAMPLE_QUEUE_LEN = 64;
+
+struct Sample {
+	int version;
+	uint8_t seed[SEED_LEN];
+	uint8_t hash[HASH_LEN];
+};
+
+static Sample s_queue[SAMPLE_QUEUE_LEN];
+static int s_queueHead = 0;
+static int s_queueCount = 0;
+static std::mutex s_queue_mutex;
+static std::condition_variable s_queue_cv;
+static std::thread s_validatorThread;
+static bool s_validatorRun = false;
+
+// hashes between two spot checks, 0 = disabled
+static std::atomic<uint32_t> s_sampleInterval(0);
+// hashes left before the next spot check of each miner thread
+thread_local uint32_t t_sampleCountdown = 0;
+
+static std::atomic<bool> s_fallback(false);
+static std::atomic<uint64_t> s_sharesChecked(0);
+static std::atomic<uint64_t> s_sharesInvalid(0);
+static std::atomic<uint64_t> s_samplesChecked(0);
+static std::atomic<uint64_t> s_samplesDropped(0);
+static std::atomic<uint64_t> s_mismatches(0);
+
+static bool checkHash(int version, const uint8_t* seed, const uint8_t* hash, const char* what) {
+	uint8_t ref[HASH_LEN];
+	if (!argon2idReference(seed, SEED_LEN, 1, version2memcost(version), ref, HASH_LEN)) {
+		logLine(VALIDATOR_LOG_PREFIX, "Error: reference argon2 failed, version %d", version);
+		return true;
+	}
+	if (memcmp(ref, hash, HASH_LEN) == 0) {
+		return true;
+	}
+
+	s_mismatches++;
+	logLine(VALIDATOR_LOG_PREFIX,
+		"\n\n!!! argon2 kernel mismatch on a %s, version %d !!!\nseed      %s\nkernel    %s\nreference %s\n",
+		what, version, bytesToHex(seed, SEED_LEN).c_str(), bytesToHex(hash, HASH_LEN).c_str(), bytesToHex(ref, HASH_LEN).c_str());
+	bool expected = false;
+	if (s_fallback.compare_exchange_strong(expected, true)) {
+		logLine(VALIDATOR_LOG_PREFIX,
+			"Faulty kernel or unstable cpu: miner threads now use the portable reference kernel (slower), check clocks / voltages");
+	}
+	return false;
+}
+
+static void validatorThreadFn() {
+	std::unique_lock<std::mutex> lock(s_queue_mutex);
+	for (;;) {
+		s_queue_cv.wait(lock, [] { return !s_validatorRun || s_queueCount > 0; });
+		if (!s_validatorRun) {
+			return;
+		}
+		Sample sample = s_queue[s_queueHead];
+		s_queueHead = (s_queueHead + 1) % SAMPLE_QUEUE_LEN;
+		s_queueCount--;
+
+		lock.unlock();
+		checkHash(sample.version, sample.seed, sample.hash, "sampled hash");
+		s_samplesChecked++;
+		lock.lock();
+	}
+}
+
+void startValidator(double rate) {
+	uint32_t interval = 0;
+	if (rate > 0) {
+		interval = rate >= 1 ? 1 : (uint32_t)(1.0 / rate + 0.5);
+	}
+	s_sampleInterval = interval;
+	if (interval == 0 || s_validatorThread.joinable()) {
+		return;
+	}
+	s_validatorRun = true;
+	s_validatorThread = std::thread(validatorThreadFn);
+}
+
+void stopValidator() {
+	s_sampleInterval = 0;
+	if (!s_validatorThread.joinable()) {
+		return;
+	}
+	s_queue_mutex.lock();
+	s_validatorRun = false;
+	s_queue_mutex.unlock();
+	s_queue_cv.notify_all();
+	s_validatorThread.join();
+}
+
+bool validateShare(int version, uint64_t nonce, const std::string& workHashHex, const uint8_t* hash) {
+	Bytes seed;
+	if (!generateAquaSeed(nonce, workHashHex, seed)) {
+		return true;
+	}
+	s_sharesChecked++;
+	if (!checkHash(version, seed.data(), hash, "found share")) {
+		s_sharesInvalid++;
+		return false;
+	}
+	return true;
+}
+
+void validateSample(int version, const Bytes& seed, const uint8_t* hash) {
+	if (t_sampleCountdown > 0) {
+		t_sampleCountdown--;
+		return;
+	}
+	// checking the reference kernel against itself is pointless
+	uint32_t interval = s_sampleInterval.load(std::memory_order_relaxed);
+	if (interval == 0 || s_fallback.load(std::memory_order_relaxed) || seed.size() != SEED_LEN) {
+		return;
+	}
+	t_sampleCountdown = interval - 1;
+
+	s_queue_mutex.lock();
+	if (s_queueCount == SAMPLE_QUEUE_LEN) {
+		s_queue_mutex.unlock();
+		s_samplesDropped++;
+		return;
+	}
+	Sample& sample = s_queue[(s_queueHead + s_queueCount) % SAMPLE_QUEUE_LEN];
+	sample.version = version;
+	memcpy(sample.seed, seed.data(), SEED_LEN);
+	memcpy(sample.hash, hash, HASH_LEN);
+	s_queueCount++;
+	s_queue_mutex.unlock();
+	s_queue_cv.notify_one();
+}
+
+bool validatorFallback() {
+	return s_fallback.load(std::memory_order_relaxed);
+}
+
+ValidatorStats getValidatorStats() {
+	ValidatorStats st;
+	st.sharesChecked = s_sharesChecked;
+	st.sharesInvalid = s_sharesInvalid;
+	st.samplesChecked = s_samplesChecked;
+	st.samplesDropped = s_samplesDropped;
+	st.mismatches = s_mismatches;
+	return st;
+}
+
+bool parseValidateRate(const std::string& s, double& rate) {
+	char* end;
+	double v = strtod(s.c_str(), &end);
+	if (end == s.c_str() || v < 0) {
+		return false;
+	}
+	if (*end == '%') {
+		v /= 100.0;
+		end++;
+	}
+	if (*end != 0 || v > 1) {
+		return false;
+	}
+	rate = v;
+	return true;
+}
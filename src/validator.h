@@ -0,0 +1,43 @@
+#pragma once
+
+#include "hex_encode_utils.h"
+
+#include <string>
+#include <stdint.h>
+
+// self validation of the optimized argon2 kernel against the portable reference (argon2ref.h):
+// - every found share is recomputed before it is submitted, a wrong one is dropped instead of being rejected
+// - a sample of ordinary hashes (--validate) is recomputed by a background thread
+// on the first mismatch an alert is logged & counted, and miner threads switch to the reference kernel
+// share checks are compiled out with ARGON_VALIDITY_CHECK=0
+#ifndef ARGON_VALIDITY_CHECK
+#define ARGON_VALIDITY_CHECK (1)
+#endif
+
+// share of ordinary hashes spot checked by default: one in 1000
+const double DEFAULT_VALIDATE_RATE = 0.001;
+
+// rate: share of ordinary hashes spot checked, 0 = found shares only
+void startValidator(double rate);
+void stopValidator();
+
+// submit thread, before sending: true if the reference kernel gives the same hash
+bool validateShare(int version, uint64_t nonce, const std::string& workHashHex, const uint8_t* hash);
+
+// miner thread, after each hash: one hash every 1/rate is queued for the validator thread, never blocks
+void validateSample(int version, const Bytes& seed, const uint8_t* hash);
+
+// set by the first mismatch, miner threads hash with the reference kernel from then on
+bool validatorFallback();
+
+struct ValidatorStats {
+	uint64_t sharesChecked;
+	uint64_t sharesInvalid;  // found shares not submitted, hash differs from the reference kernel
+	uint64_t samplesChecked;
+	uint64_t samplesDropped; // validator thread too slow, queue full
+	uint64_t mismatches;
+};
+ValidatorStats getValidatorStats();
+
+// "0.1%" or "0.001"
+bool parseValidateRate(const std::string& s, double& rate);
@@ -0,0 +1,241 @@
+#include "watchdog.h"
+#include "miner.h"
+#include "miningConfig.h"
+#include "log.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <assert.h>
+
+#ifdef __linux__
+#include <sched.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+const char* WATCHDOG_LOG_PREFIX = "WDOG";
+// hash duration buckets: [2^k, 2^(k+1)) us
+const int HASH_US_BUCKETS = 24;
+// rolling rate smoothing & slow thread detection
+const double EWMA_ALPHA = 0.3;
+const double SLOW_THRESHOLD = 0.75; // below 75% of the median
+const uint32_t SLOW_REPORTS = 3;
+const uint32_t STALL_REPORTS = 2;
+
+// written by the owning miner thread only
+struct alignas(64) WatchdogThreadCounters {
+	std::atomic<uint64_t> hashUs[HASH_US_BUCKETS];
+	std::atomic<int> cpu;
+};
+static WatchdogThreadCounters s_counters[MAX_MINER_THREADS];
+
+// watchdog state, main thread only (states are read by metrics)
+struct WatchdogThread {
+	uint64_t lastHashes = 0;
+	uint64_t lastBuckets[HASH_US_BUCKETS] = { 0 };
+	double rate = -1; // EWMA, -1 until first report
+	uint32_t nSlow = 0;
+	uint32_t nStalled = 0;
+};
+static WatchdogThread s_threads[MAX_MINER_THREADS];
+static std::atomic<int> s_states[MAX_MINER_THREADS];
+static std::atomic<uint32_t> s_alerts[WATCHDOG_N_STATES];
+
+static int currentCpu() {
+#ifdef __linux__
+	return sched_getcpu();
+#elif defined(_WIN32)
+	return (int)GetCurrentProcessorNumber();
+#else
+	return -1;
+#endif
+}
+
+void watchdogRecordHash(int minerID, uint32_t hashUs) {
+	int bucket = 0;
+	while (bucket < HASH_US_BUCKETS - 1 && (hashUs >> (bucket + 1)) != 0) {
+		bucket++;
+	}
+	WatchdogThreadCounters& c = s_counters[minerID];
+	c.hashUs[bucket].store(c.hashUs[bucket].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	c.cpu.store(currentCpu(), std::memory_order_relaxed);
+}
+
+WatchdogState watchdogThreadState(int minerID) {
+	assert(minerID >= 0 && minerID < MAX_MINER_THREADS);
+	return (WatchdogState)s_states[minerID].load();
+}
+
+const char* watchdogStateName(WatchdogState state) {
+	switch (state) {
+		case WATCHDOG_OK: return "ok";
+		case WATCHDOG_SLOW: return "slow";
+		case WATCHDOG_STALLED: return "stalled";
+		default: break;
+	}
+	return "?";
+}
+
+int watchdogThreadCpu(int minerID) {
+	assert(minerID >= 0 && minerID < MAX_MINER_THREADS);
+	return s_counters[minerID].cpu.load(std::memory_order_relaxed);
+}
+
+uint32_t watchdogAlertCount(WatchdogState state) {
+	return s_alerts[state];
+}
+
+bool parseWatchdogAction(const std::string& s, WatchdogAction& action) {
+	if (s == "none") {
+		action = WATCHDOG_ACTION_NONE;
+	}
+	else if (s == "restart") {
+		action = WATCHDOG_ACTION_RESTART;
+	}
+	else if (s == "repin") {
+		action = WATCHDOG_ACTION_REPIN;
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+// upper bound in ms of the bucket holding percentile p of the hashes done since last report
+static double hashPercentileMs(const uint64_t* delta, uint64_t total, double p) {
+	uint64_t rank = (uint64_t)(p * total);
+	uint64_t n = 0;
+	for (int b = 0; b < HASH_US_BUCKETS; b++) {
+		n += delta[b];
+		if (n > rank) {
+			return (double)(2ULL << b) / 1000.0;
+		}
+	}
+	return (double)(2ULL << (HASH_US_BUCKETS - 1)) / 1000.0;
+}
+
+// a cpu none of the other miner threads ran on lately, -1 if none
+static int findFreeCpu(int minerID, int nThreads) {
+	int nCpus = (int)std::thread::hardware_concurrency();
+	std::vector<bool> used(nCpus > 0 ? nCpus : 0, false);
+	for (int i = 0; i < nThreads; i++) {
+		int cpu = watchdogThreadCpu(i);
+		if (i != minerID && cpu >= 0 && cpu < nCpus) {
+			used[cpu] = true;
+		}
+	}
+	for (int cpu = 0; cpu < nCpus; cpu++) {
+		if (!used[cpu]) {
+			return cpu;
+		}
+	}
+	return -1;
+}
+
+static void applyAction(int minerID, WatchdogState state, int nThreads) {
+	switch (miningConfig().watchdogAction) {
+		case WATCHDOG_ACTION_NONE:
+			break;
+		case WATCHDOG_ACTION_RESTART:
+			if (state == WATCHDOG_STALLED) {
+				// joining would block until the thread gets unstuck
+				logLine(WATCHDOG_LOG_PREFIX, "MN%02d is stalled, not restarting it", minerID);
+			}
+			else if (restartMinerThread(minerID)) {
+				logLine(WATCHDOG_LOG_PREFIX, "MN%02d restarted", minerID);
+			}
+			break;
+		case WATCHDOG_ACTION_REPIN: {
+			int cpu = findFreeCpu(minerID, nThreads);
+			if (cpu < 0) {
+				logLine(WATCHDOG_LOG_PREFIX, "MN%02d: no free cpu to move to", minerID);
+			}
+			else if (pinMinerThread(minerID, cpu)) {
+				logLine(WATCHDOG_LOG_PREFIX, "MN%02d moved to cpu %d", minerID, cpu);
+			}
+			else {
+				logLine(WATCHDOG_LOG_PREFIX, "MN%02d: cannot pin to cpu %d", minerID, cpu);
+			}
+			break;
+		}
+	}
+}
+
+void watchdogTick(double durationS) {
+	if (durationS <= 0 || minerThreadsPaused()) {
+		return;
+	}
+	// threads parked by --background are not slow
+	int nThreads = activeMinerThreads();
+
+	std::vector<double> rates(nThreads);
+	std::vector<uint64_t> hashes(nThreads);
+	for (int i = 0; i < nThreads; i++) {
+		WatchdogThread& t = s_threads[i];
+		uint64_t n = getThreadHashes(i);
+		hashes[i] = n - t.lastHashes;
+		t.lastHashes = n;
+		double rate = hashes[i] / durationS;
+		t.rate = (t.rate < 0) ? rate : EWMA_ALPHA * rate + (1 - EWMA_ALPHA) * t.rate;
+		rates[i] = t.rate;
+	}
+	if (nThreads < 2) {
+		return;
+	}
+
+	std::vector<double> sorted = rates;
+	std::sort(sorted.begin(), sorted.end());
+	double median = sorted[nThreads / 2];
+	if (median <= 0) {
+		// nobody hashes: no work / pool down, not a thread problem
+		return;
+	}
+
+	for (int i = 0; i < nThreads; i++) {
+		WatchdogThread& t = s_threads[i];
+		uint64_t delta[HASH_US_BUCKETS];
+		uint64_t total = 0;
+		for (int b = 0; b < HASH_US_BUCKETS; b++) {
+			uint64_t v = s_counters[i].hashUs[b].load(std::memory_order_relaxed);
+			delta[b] = v - t.lastBuckets[b];
+			t.lastBuckets[b] = v;
+			total += delta[b];
+		}
+
+		t.nStalled = (hashes[i] == 0) ? t.nStalled + 1 : 0;
+		t.nSlow = (rates[i] < SLOW_THRESHOLD * median) ? t.nSlow + 1 : 0;
+
+		WatchdogState state = WATCHDOG_OK;
+		if (t.nStalled >= STALL_REPORTS) {
+			state = WATCHDOG_STALLED;
+		}
+		else if (t.nSlow >= SLOW_REPORTS) {
+			state = WATCHDOG_SLOW;
+		}
+
+		WatchdogState previous = (WatchdogState)s_states[i].exchange(state);
+		if (state == previous) {
+			continue;
+		}
+		if (state == WATCHDOG_OK) {
+			logLine(WATCHDOG_LOG_PREFIX, "MN%02d back to normal, %.3f kH/s", i, rates[i] / 1000.0);
+			continue;
+		}
+
+		s_alerts[state]++;
+		if (total > 0) {
+			logLine(WATCHDOG_LOG_PREFIX, "MN%02d %s: %.3f kH/s vs median %.3f kH/s (%+.0f%%), hash p50 < %.2fms p99 < %.2fms, cpu %d",
+				i, watchdogStateName(state), rates[i] / 1000.0, median / 1000.0,
+				100.0 * (rates[i] - median) / median,
+				hashPercentileMs(delta, total, 0.5), hashPercentileMs(delta, total, 0.99),
+				watchdogThreadCpu(i));
+		}
+		else {
+			logLine(WATCHDOG_LOG_PREFIX, "MN%02d %s: no hash for %.0fs (median %.3f kH/s), last cpu %d",
+				i, watchdogStateName(state), t.nStalled * durationS, median / 1000.0, watchdogThreadCpu(i));
+		}
+		applyAction(i, state, nThreads);
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+// per miner thread hash rate watchdog: flags threads much slower than the median or not progressing
+enum WatchdogState {
+	WATCHDOG_OK,
+	WATCHDOG_SLOW,    // rolling rate below the median for several reports
+	WATCHDOG_STALLED, // no hash while the other threads progress
+	WATCHDOG_N_STATES
+};
+
+// what to do with a flagged thread (--watchdog none|restart|repin)
+enum WatchdogAction {
+	WATCHDOG_ACTION_NONE,
+	WATCHDOG_ACTION_RESTART, // slow threads only, a stalled thread cannot be joined
+	WATCHDOG_ACTION_REPIN    // move the thread to a cpu no other miner thread runs on (Linux)
+};
+
+// miner thread, after each hash: duration distribution & cpu the thread runs on
+void watchdogRecordHash(int minerID, uint32_t hashUs);
+
+// periodic report, durationS since previous call
+void watchdogTick(double durationS);
+
+WatchdogState watchdogThreadState(int minerID);
+const char* watchdogStateName(WatchdogState state);
+int watchdogThreadCpu(int minerID);
+uint32_t watchdogAlertCount(WatchdogState state);
+
+bool parseWatchdogAction(const std::string& s, WatchdogAction& action);